@@ -32,6 +32,8 @@ bl_gpio_t pin3 = { .port = 1, .pin = 5 };
 
 //=========================== defines =========================================
 
+#define TXRX_CHANNEL (BLINK_N_BLE_REGULAR_CHANNELS) // first advertising channel, 37
+
 typedef struct {
     uint64_t asn;
 } txrx_vars_t;
@@ -40,7 +42,7 @@ typedef struct {
 
 txrx_vars_t txrx_vars = { 0 };
 
-extern schedule_t schedule_only_beacons, schedule_huge;
+extern const schedule_t schedule_only_beacons, schedule_huge;
 
 //=========================== prototypes ======================================
 
@@ -58,9 +60,9 @@ int main(void) {
     bl_gpio_init(&pin1, BL_GPIO_OUT);
 
     bl_radio_init(&isr_radio_start_frame, &isr_radio_end_frame, BL_RADIO_BLE_2MBit);
-    bl_radio_set_channel(BLINK_FIXED_SCAN_CHANNEL);
+    bl_radio_set_channel(TXRX_CHANNEL);
 
-    printf("BLINK_FIXED_SCAN_CHANNEL = %d\n", BLINK_FIXED_SCAN_CHANNEL);
+    printf("TXRX_CHANNEL = %d\n", TXRX_CHANNEL);
 
     bl_timer_hf_set_periodic_us(BLINK_TIMER_DEV, 0, 5000, send_beacon_prepare); // 5 ms
 
@@ -74,7 +76,7 @@ int main(void) {
 static void send_beacon_prepare(void) {
     printf("Sending beacon from %llx\n", bl_device_id());
     uint8_t packet[BLINK_PACKET_MAX_SIZE] = { 0 };
-    size_t len = bl_build_packet_beacon(packet, txrx_vars.asn++, 10, schedule_huge.id);
+    size_t len = bl_build_packet_beacon(packet, txrx_vars.asn++, 10, schedule_huge.id, &schedule_huge.descriptor, schedule_huge.id, 0, BLINK_NETWORK_MAX_PACKET_LEN, 0, 0, 0);
     bl_radio_disable();
     bl_radio_tx_prepare(packet, len);
     DEBUG_GPIO_SET(&pin0);
@@ -0,0 +1,933 @@
+/**
+ * @file
+ * @ingroup     app
+ *
+ * @brief       Microbenchmarks of the blink functions that run in the radio and timer ISRs
+ *
+ * Each function is timed over several calls, for each of the built-in schedules,
+ * and reported as min/median/max. On nRF, durations are CPU cycles read from the
+ * DWT cycle counter; on Linux (BLINK_SIM, see sim/Makefile), they are read from
+ * the time-stamp counter, or in nanoseconds where there is none.
+ *
+ * Generated schedules are also checked: the slots a node walks after reading the
+ * descriptor in a beacon must be the cells the gateway generates, the gateway must
+ * hand out every uplink cell it can hold (see BLINK_N_UPLINK_CELLS_MAX), and the
+ * hash of the cells must be the same on every platform. So must the slot durations
+ * a node computes from the maximum frame length in a beacon, and those of the
+ * gateway, for each cell type, and the join backoff of a node must end before it gives
+ * up joining. The program returns 1 on Linux if any of this fails.
+ * Last, the transmit queue must return the packets it is given, in order, and the
+ * gateway must serve the nodes of its downlink in turn, even when one of them has
+ * many more packets than the others. The queue is compared with the fixed entries of
+ * the largest frame it replaced, kept here as a reference (bench_fixed_queue_t).
+ *
+ * The last part of the output is a CSV summary, meant to be diffed across releases.
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <nrf.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "bl_device.h"
+#include "blink.h"
+#include "models.h"
+#include "packet.h"
+#include "mac.h"
+#include "scheduler.h"
+#include "generator.h"
+#include "association.h"
+#include "bloom.h"
+#include "queue.h"
+#include "scan.h"
+
+#if defined(BLINK_SIM)
+#include <time.h>
+#include "sim.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+//=========================== defines ==========================================
+
+#define BENCH_SAMPLES_MAX       (256)
+#define BENCH_RESULTS_MAX       (64)
+#define BENCH_REPETITIONS       (64)
+#define BENCH_ASN_BASE          ((1ULL << 40) + 12345) // a large asn, so that the 64-bit arithmetic is exercised
+#define BENCH_SCAN_GATEWAYS     (8) // more than BLINK_MAX_SCAN_LIST_SIZE, so that old entries get replaced
+#define BENCH_GENERATOR_CELLS   (4000) // much larger than BLINK_N_CELLS_MAX, generated schedules are not stored
+#define BENCH_GENERATOR_LARGEST (3) // index of the BENCH_GENERATOR_CELLS cells descriptor
+#define BENCH_QUEUE_PACKETS     (2000) // pushed through the queue by its check, many times its capacity
+#define BENCH_QUEUE_PACKET_LEN  (30) // typical data packet, with its header
+#define BENCH_FIXED_QUEUE_SIZE  (32) // entries of the fixed queue, as in the library before the ring of bytes, must be a power of 2
+#define BENCH_DOWNLINK_NODES    (100) // destinations of the gateway, node 0 always has packets for it
+#define BENCH_DOWNLINK_SLOTS    (2000) // downlink slots simulated by the check
+#define BENCH_DOWNLINK_PERIOD   (200) // in slots, of the packets for each of the other nodes
+
+#if defined(BLINK_SIM) && (defined(__x86_64__) || defined(__i386__))
+#define BENCH_UNIT "tsc"
+#elif defined(BLINK_SIM)
+#define BENCH_UNIT "ns"
+#else
+#define BENCH_UNIT "cycles"
+#endif
+
+typedef struct {
+    uint32_t    samples[BENCH_SAMPLES_MAX];
+    size_t      len;
+} bench_samples_t;
+
+typedef struct {
+    const char  *schedule;
+    const char  *function;
+    size_t      len;
+    uint32_t    min;
+    uint32_t    median;
+    uint32_t    max;
+} bench_result_t;
+
+typedef struct {
+    uint32_t        overhead;       ///< Cost of an empty measurement, subtracted from every sample
+    bench_samples_t samples;
+    bench_result_t  results[BENCH_RESULTS_MAX];
+    size_t          results_len;
+} bench_vars_t;
+
+/// Multi-producer queue of fixed entries of the largest frame, the transmit queue before the ring of bytes
+typedef struct {
+    uint8_t         current;                            ///< Next packet to send, only written by the MAC, once it is done with it
+    uint8_t         last;                               ///< Next position to fill, claimed by the producers
+    bool            ready[BENCH_FIXED_QUEUE_SIZE];      ///< Set once a claimed entry is written, cleared when it is popped
+    bl_radio_pdu_t  packets[BENCH_FIXED_QUEUE_SIZE];
+} bench_fixed_queue_t;
+
+/// Times a single evaluation of @p expr, with interrupts disabled
+#define BENCH_MEASURE(expr) do {                                \
+        __disable_irq();                                        \
+        uint32_t _start = _cycles_now();                        \
+        expr;                                                   \
+        uint32_t _end = _cycles_now();                          \
+        __enable_irq();                                         \
+        _add_sample(_end - _start);                             \
+    } while (0)
+
+//=========================== variables ========================================
+
+extern const schedule_t schedule_minuscule, schedule_tiny, schedule_huge;
+
+static bench_vars_t _bench_vars = { 0 };
+
+static const bl_schedule_descriptor_t _generator_descriptors[] = {
+    { .n_beacons = 3, .n_shared_uplink = 11, .n_downlink = 22, .n_uplink = 101 }, // as large as schedule_huge
+    { .n_beacons = 3, .n_shared_uplink = 2, .n_downlink = 2, .n_uplink = 9 },
+    { .n_beacons = 1, .n_shared_uplink = 1, .n_downlink = 3, .n_uplink = 40 },
+    { .n_beacons = 3, .n_shared_uplink = 100, .n_downlink = 200, .n_uplink = 3697 },
+};
+
+static cell_t _generator_cells[BENCH_GENERATOR_CELLS];
+
+static bench_fixed_queue_t _fixed_queue = { 0 };
+
+volatile uint32_t bench_sink; ///< Keeps the compiler from optimizing away the benchmarked calls
+
+//=========================== prototypes =======================================
+
+static void _platform_init(void);
+static inline uint32_t _cycles_now(void);
+static void _add_sample(uint32_t cycles);
+static void _report(const char *schedule, const char *function);
+static void _print_summary(void);
+static void _bench_gateway(const char *name, const schedule_t *schedule);
+static void _bench_node(const char *name, const schedule_t *schedule);
+static bool _check_generator(void);
+static bool _check_slot_timing(void);
+static bool _check_join_timeout(void);
+static bool _check_queue(void);
+static bool _check_downlink(void);
+static void _bench_generator(void);
+static void _bench_queue(void);
+static void _bench_downlink(void);
+static bool _fixed_queue_add(const uint8_t *packet, uint8_t length);
+static bool _fixed_queue_pop(void);
+static uint32_t _fnv1a(const void *data, size_t len);
+static void _event_callback(bl_event_t event, bl_event_data_t event_data);
+static uint64_t _node_id(size_t i);
+
+//=========================== main =============================================
+
+int main(void) {
+    _platform_init();
+    printf("Blink benchmarks, device %016llX, unit: %s\n\n", (unsigned long long)bl_device_id(), BENCH_UNIT);
+
+    // measure the cost of measuring
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        BENCH_MEASURE((void)0);
+    }
+    _bench_vars.overhead = UINT32_MAX;
+    for (size_t i = 0; i < _bench_vars.samples.len; i++) {
+        if (_bench_vars.samples.samples[i] < _bench_vars.overhead) {
+            _bench_vars.overhead = _bench_vars.samples.samples[i];
+        }
+    }
+
+    bl_assoc_init(_event_callback);
+    bl_bloom_gateway_init();
+    bl_mac_set_max_packet_len(BLINK_NETWORK_MAX_PACKET_LEN); // set by bl_mac_init otherwise, queued packets would not fit
+
+    printf("%-10s %-38s %8s %8s %8s\n", "schedule", "function", "min", "median", "max");
+    struct {
+        const char  *name;
+        const schedule_t *schedule;
+    } schedules[] = {
+        { "minuscule", &schedule_minuscule },
+        { "tiny", &schedule_tiny },
+        { "huge", &schedule_huge },
+    };
+    for (size_t i = 0; i < sizeof(schedules) / sizeof(schedules[0]); i++) {
+        _bench_gateway(schedules[i].name, schedules[i].schedule);
+        _bench_node(schedules[i].name, schedules[i].schedule);
+    }
+
+    bool generator_ok = _check_generator();
+    _bench_generator();
+    bool timing_ok = _check_slot_timing();
+    bool join_ok = _check_join_timeout();
+    bool queue_ok = _check_queue();
+    _bench_queue();
+    bool downlink_ok = _check_downlink();
+    _bench_downlink();
+
+    _print_summary();
+
+#if !defined(BLINK_SIM)
+    while (1) {
+        __SEV();
+        __WFE();
+        __WFE();
+    }
+#endif
+    return generator_ok && timing_ok && join_ok && queue_ok && downlink_ok ? 0 : 1;
+}
+
+//=========================== private ==========================================
+
+static void _bench_gateway(const char *name, const schedule_t *schedule) {
+    uint8_t packet[BLINK_PACKET_MAX_SIZE] = { 0 };
+    uint8_t bloom[BLINK_BLOOM_M_BYTES_MAX] = { 0 };
+
+    blink_set_node_type(BLINK_GATEWAY);
+    bl_scheduler_init(BLINK_GATEWAY, NULL);
+    bl_scheduler_set_schedule(schedule->id);
+
+    // worst case: every uplink cell is assigned
+    size_t n_nodes = 0;
+    while (bl_scheduler_gateway_assign_next_available_uplink_cell(_node_id(n_nodes), BENCH_ASN_BASE) >= 0) {
+        n_nodes++;
+    }
+    uint64_t last_node = _node_id(n_nodes - 1); // found at the end of the linear searches
+    uint64_t unknown_node = _node_id(n_nodes + 1);
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < schedule->n_cells && i < BENCH_SAMPLES_MAX; i++) {
+        BENCH_MEASURE(bench_sink = bl_scheduler_tick(BENCH_ASN_BASE + i).channel);
+    }
+    _report(name, "bl_scheduler_tick (gateway)");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        BENCH_MEASURE(bl_bloom_gateway_compute());
+    }
+    _report(name, "bl_bloom_gateway_compute");
+
+    bl_bloom_gateway_copy(bloom);
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        // alternate between members and non-members, which may stop at the first hash
+        uint64_t node_id = (i % 2) ? _node_id(i % n_nodes) : _node_id(n_nodes + i);
+        BENCH_MEASURE(bench_sink = bl_bloom_node_contains(node_id, bloom));
+    }
+    _report(name, "bl_bloom_node_contains");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        BENCH_MEASURE(bench_sink = bl_queue_next_pdu(SLOT_TYPE_BEACON)->length);
+    }
+    _report(name, "bl_queue_next_pdu (beacon)");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        uint8_t payload[] = { 0xFA, 0xFA, 0xFA, 0xFA, 0xFA };
+        uint8_t len = bl_build_packet_data(packet, last_node, payload, sizeof(payload));
+        bl_queue_add(packet, len);
+        BENCH_MEASURE(bench_sink = bl_queue_next_pdu(SLOT_TYPE_DOWNLINK)->length);
+        bl_queue_tx_done();
+    }
+    _report(name, "bl_queue_next_pdu (downlink)");
+
+    uint8_t keepalive_len = bl_build_packet_keepalive(packet, bl_device_id());
+    ((bl_packet_header_t *)packet)->src = last_node;
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        BENCH_MEASURE(bl_handle_packet(packet, keepalive_len));
+    }
+    _report(name, "bl_handle_packet (keepalive)");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        BENCH_MEASURE(bench_sink = bl_assoc_gateway_node_is_joined(last_node));
+    }
+    _report(name, "bl_assoc_gateway_node_is_joined");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        BENCH_MEASURE(bench_sink = bl_assoc_gateway_node_is_joined(unknown_node));
+    }
+    _report(name, "bl_assoc_gateway_node_is_joined (miss)");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        BENCH_MEASURE(bl_assoc_gateway_keep_node_alive(last_node, BENCH_ASN_BASE + i));
+    }
+    _report(name, "bl_assoc_gateway_keep_node_alive");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        // every node is recent enough, so the whole schedule is scanned and nothing is removed
+        BENCH_MEASURE(bl_assoc_gateway_clear_old_nodes(BENCH_ASN_BASE));
+    }
+    _report(name, "bl_assoc_gateway_clear_old_nodes");
+
+    // leave the schedule empty for the next benchmarks
+    bl_assoc_gateway_clear_old_nodes(UINT64_MAX);
+}
+
+static void _bench_node(const char *name, const schedule_t *schedule) {
+    uint8_t packet[BLINK_PACKET_MAX_SIZE] = { 0 };
+
+    blink_set_node_type(BLINK_NODE);
+    bl_scheduler_init(BLINK_NODE, NULL);
+    bl_scheduler_set_schedule(schedule->id);
+
+    // joined, in the last uplink cell
+    for (size_t i = 0; i < schedule->n_cells; i++) {
+        if (schedule->cells[schedule->n_cells - 1 - i].type == SLOT_TYPE_UPLINK) {
+            bl_scheduler_node_assign_myself_to_cell(schedule->n_cells - 1 - i);
+            break;
+        }
+    }
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < schedule->n_cells && i < BENCH_SAMPLES_MAX; i++) {
+        BENCH_MEASURE(bench_sink = bl_scheduler_tick(BENCH_ASN_BASE + i).channel);
+    }
+    _report(name, "bl_scheduler_tick (node)");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        // nothing queued, a keepalive is built
+        BENCH_MEASURE(bench_sink = bl_queue_next_pdu(SLOT_TYPE_UPLINK)->length);
+    }
+    _report(name, "bl_queue_next_pdu (uplink)");
+
+    _bench_vars.samples.len = 0;
+    bl_beacon_packet_header_t beacon = {
+        .version = BLINK_PROTOCOL_VERSION,
+        .type = BLINK_PACKET_BEACON,
+        .asn = BENCH_ASN_BASE,
+        .remaining_capacity = 1,
+        .active_schedule_id = schedule->id,
+        .next_schedule_id = schedule->id,
+    };
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        beacon.src = _node_id(1000 + i % BENCH_SCAN_GATEWAYS);
+        uint8_t channel = BLINK_N_BLE_REGULAR_CHANNELS + i % BLINK_N_BLE_ADVERTISING_CHANNELS;
+        BENCH_MEASURE(bl_scan_add(beacon, NULL, -60 - (int8_t)(i % 20), channel, 1000 * (i + 1), 0));
+    }
+    _report(name, "bl_scan_add");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        bl_channel_info_t best;
+        BENCH_MEASURE(bench_sink = bl_scan_select(&best, 0, 1000 * BENCH_REPETITIONS));
+    }
+    _report(name, "bl_scan_select");
+
+    beacon.src = _node_id(1000);
+    memcpy(packet, &beacon, sizeof(beacon));
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        BENCH_MEASURE(bl_handle_packet(packet, sizeof(beacon) + BLINK_BLOOM_M_BYTES));
+    }
+    _report(name, "bl_handle_packet (beacon)");
+
+    bl_scheduler_node_deassign_myself_from_schedule();
+}
+
+static bool _check_generator(void) {
+    uint8_t packet[BLINK_PACKET_MAX_SIZE] = { 0 };
+    bool ok = true;
+
+    printf("\n%-10s %-18s %6s %10s\n", "generator", "descriptor", "cells", "fnv1a");
+    for (size_t i = 0; i < sizeof(_generator_descriptors) / sizeof(_generator_descriptors[0]); i++) {
+        const bl_schedule_descriptor_t *descriptor = &_generator_descriptors[i];
+        size_t n_cells = bl_generator_build_cells(descriptor, _generator_cells, BENCH_GENERATOR_CELLS);
+
+        // the gateway advertises its generated schedule, and can hand out all its uplink cells
+        blink_set_node_type(BLINK_GATEWAY);
+        bl_scheduler_init(BLINK_GATEWAY, NULL);
+        bool match = n_cells > 0 && bl_scheduler_set_generated_schedule(descriptor);
+        size_t n_nodes = 0;
+        int16_t cell_index;
+        while ((cell_index = bl_scheduler_gateway_assign_next_available_uplink_cell(_node_id(n_nodes), BENCH_ASN_BASE)) >= 0) {
+            match = match && _generator_cells[cell_index].type == SLOT_TYPE_UPLINK;
+            n_nodes++;
+        }
+        size_t n_uplink_max = descriptor->n_uplink < BLINK_N_UPLINK_CELLS_MAX ? descriptor->n_uplink : BLINK_N_UPLINK_CELLS_MAX;
+        match = match && n_nodes == n_uplink_max;
+        bl_assoc_gateway_clear_old_nodes(UINT64_MAX);
+        const schedule_t *gateway_schedule = bl_scheduler_get_active_schedule_ptr();
+        // every other descriptor, with a few data channels blacklisted, and a change of them announced
+        uint64_t blacklist = i % 2 ? 0x0F00FF00F1ULL : 0;
+        uint64_t next_blacklist = i % 2 ? blacklist | (1ULL << (BLINK_N_BLE_REGULAR_CHANNELS - 1)) : 0;
+        uint64_t channel_switch_asn = i % 2 ? BENCH_ASN_BASE + n_cells : 0;
+        size_t beacon_len = bl_build_packet_beacon(packet, BENCH_ASN_BASE, gateway_schedule->max_nodes, gateway_schedule->id, &gateway_schedule->descriptor, gateway_schedule->id, 0, BLINK_NETWORK_MAX_PACKET_LEN, blacklist, next_blacklist, channel_switch_asn);
+
+        // a node generates it again from the beacon, and walks the same cells
+        bl_beacon_packet_header_t beacon;
+        memcpy(&beacon, packet, sizeof(beacon));
+        uint64_t node_blacklist, node_next_blacklist, node_channel_switch_asn;
+        bl_packet_beacon_get_channel_blacklist(&beacon, (const bl_beacon_channel_switch_t *)(packet + sizeof(beacon)), &node_blacklist, &node_next_blacklist, &node_channel_switch_asn);
+        match = match && beacon_len == bl_packet_beacon_header_len(packet) && beacon_len == (i % 2 ? BLINK_BEACON_MAX_HEADER_LEN : sizeof(beacon));
+        match = match && node_blacklist == blacklist && node_next_blacklist == next_blacklist && node_channel_switch_asn == channel_switch_asn;
+        blink_set_node_type(BLINK_NODE);
+        bl_scheduler_init(BLINK_NODE, NULL);
+        match = match && beacon.active_schedule_id == BLINK_SCHEDULE_ID_GENERATED && bl_scheduler_set_generated_schedule(&beacon.schedule);
+        match = match && bl_scheduler_get_active_schedule_slot_count() == n_cells;
+        bl_scheduler_node_set_channel_blacklist(node_blacklist, node_next_blacklist, node_channel_switch_asn);
+        for (size_t asn = 0; match && asn < n_cells; asn += BENCH_SAMPLES_MAX) {
+            bl_slot_info_t slots[BENCH_SAMPLES_MAX];
+            size_t n_slots = n_cells - asn < BENCH_SAMPLES_MAX ? n_cells - asn : BENCH_SAMPLES_MAX;
+            bl_scheduler_peek_slots(asn, slots, n_slots);
+            for (size_t j = 0; j < n_slots; j++) {
+                const cell_t *cell = &_generator_cells[asn + j];
+                match = match && slots[j].type == cell->type && slots[j].channel == bl_scheduler_get_channel(cell->type, asn + j, cell->channel_offset);
+                match = match && !(node_blacklist & (1ULL << slots[j].channel));
+            }
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "%u,%u,%u,%u", descriptor->n_uplink, descriptor->n_downlink, descriptor->n_shared_uplink, descriptor->n_beacons);
+        printf("%-10s %-18s %6u 0x%08X %s\n", "gen", name, (unsigned)n_cells,
+               (unsigned)_fnv1a(_generator_cells, n_cells * sizeof(cell_t)), match ? "ok" : "MISMATCH");
+        ok = ok && match;
+    }
+    printf("\n");
+    return ok;
+}
+
+static bool _check_slot_timing(void) {
+    // 0 must be raised to the length of the control frames, beacon slots must not depend on it, the default must give the historical durations
+    static const uint8_t max_packet_lens[] = { 0, 32, 64, 128, 200, BLINK_NETWORK_MAX_PACKET_LEN, UINT8_MAX };
+    static const slot_type_t slot_types[] = { SLOT_TYPE_BEACON, SLOT_TYPE_SHARED_UPLINK, SLOT_TYPE_DOWNLINK, SLOT_TYPE_UPLINK };
+    uint8_t packet[BLINK_BLE_PAYLOAD_MAX_LENGTH];
+    bool ok = true;
+
+    printf("%-10s %-18s %6s %6s %6s %6s %8s\n", "timing", "max_packet_len", "B", "S", "D", "U", "check");
+    for (size_t i = 0; i < sizeof(max_packet_lens) / sizeof(max_packet_lens[0]); i++) {
+        // the gateway sizes its slots, and advertises the length in its beacons
+        uint8_t gateway_len = bl_mac_gateway_max_packet_len(max_packet_lens[i]);
+        const schedule_t *schedule = &schedule_huge;
+        bl_build_packet_beacon(packet, BENCH_ASN_BASE, schedule->max_nodes, schedule->id, &schedule->descriptor, schedule->id, 0, gateway_len, 0, 0, 0);
+
+        // a node sizes its own from the beacon
+        bl_beacon_packet_header_t beacon;
+        memcpy(&beacon, packet, sizeof(beacon));
+
+        bool match = gateway_len >= BLINK_CONTROL_PACKET_MAX_LEN && (max_packet_lens[i] < BLINK_CONTROL_PACKET_MAX_LEN || gateway_len == max_packet_lens[i]);
+        match = match && bl_mac_slot_max_packet_len(SLOT_TYPE_BEACON, gateway_len) == BLINK_BEACON_MAX_HEADER_LEN + BLINK_BLOOM_M_BYTES;
+        uint32_t whole_slots[sizeof(slot_types) / sizeof(slot_types[0])];
+        for (size_t j = 0; j < sizeof(slot_types) / sizeof(slot_types[0]); j++) {
+            uint8_t len = bl_mac_slot_max_packet_len(slot_types[j], gateway_len);
+            bl_slot_durations_t gateway, node;
+            bl_mac_compute_slot_durations(&gateway, len);
+            bl_mac_compute_slot_durations(&node, bl_mac_slot_max_packet_len(slot_types[j], beacon.max_packet_len));
+            whole_slots[j] = gateway.whole_slot;
+
+            match = match && memcmp(&gateway, &node, sizeof(bl_slot_durations_t)) == 0;
+            // a frame of the maximum length fits in the transmission, the reception window and the slot
+            match = match && 78u + BLINK_PACKET_TOA(len) < node.tx_max; // from TASKS_START, see BLINK_PACKET_TOA_PADDING
+            match = match && node.rx_offset + node.rx_max >= gateway.tx_offset + gateway.tx_max && node.rx_offset + node.rx_max < node.whole_slot;
+            match = match && gateway.tx_offset + gateway.tx_max + gateway.end_guard <= gateway.whole_slot;
+        }
+        match = match && (gateway_len != BLINK_NETWORK_MAX_PACKET_LEN || whole_slots[2] == 1520); // 300 + 1070 + 150 us, before the slots were sized
+
+        char name[32];
+        snprintf(name, sizeof(name), "%u -> %u", max_packet_lens[i], gateway_len);
+        printf("%-10s %-18s %6u %6u %6u %6u %8s\n", "timing", name,
+               (unsigned)whole_slots[0], (unsigned)whole_slots[1], (unsigned)whole_slots[2], (unsigned)whole_slots[3], match ? "ok" : "MISMATCH");
+        ok = ok && match;
+    }
+    printf("\n");
+
+    // slotframes of the built-in schedules, with the default maximum frame length
+    const schedule_t *schedules[] = { &schedule_minuscule, &schedule_tiny, &schedule_huge };
+    printf("%-10s %-18s %10s %10s\n", "slotframe", "schedule id", "uniform", "sized");
+    for (size_t i = 0; i < sizeof(schedules) / sizeof(schedules[0]); i++) {
+        uint32_t uniform = 0, sized = 0;
+        for (size_t j = 0; j < schedules[i]->n_cells; j++) {
+            bl_slot_durations_t durations;
+            bl_mac_compute_slot_durations(&durations, bl_mac_slot_max_packet_len(schedules[i]->cells[j].type, BLINK_NETWORK_MAX_PACKET_LEN));
+            uniform += BLINK_WHOLE_SLOT_DURATION;
+            sized += durations.whole_slot;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "%u", schedules[i]->id);
+        printf("%-10s %-18s %10u %10u\n", "slotframe", name, (unsigned)uniform, (unsigned)sized);
+    }
+    printf("\n");
+    return ok;
+}
+
+static bool _check_join_timeout(void) {
+    const schedule_t *schedules[] = { &schedule_minuscule, &schedule_tiny, &schedule_huge };
+    bool ok = true;
+
+    printf("%-10s %-18s %10s %10s %10s %8s\n", "join", "schedule id", "backoff", "longest", "timeout", "check");
+    for (size_t i = 0; i < sizeof(schedules) / sizeof(schedules[0]); i++) {
+        const schedule_t *schedule = schedules[i];
+        blink_set_node_type(BLINK_NODE);
+        bl_scheduler_init(BLINK_NODE, NULL);
+        bl_scheduler_set_schedule(schedule->id);
+
+        // a backoff drawn at any time after synchronizing, from right after any shared uplink slot, must end with
+        // the join request before the node gives up
+        bool match = true;
+        uint32_t longest_at_sync = 0;
+        for (uint32_t since_synced = 0; since_synced < BLINK_JOIN_TIMEOUT_SINCE_SYNCED; since_synced += BLINK_JOIN_TIMEOUT_SINCE_SYNCED / 10) {
+            uint16_t backoff = bl_assoc_node_max_backoff(since_synced);
+            if (backoff == 0) {
+                // the node tries at the next shared uplink slot
+                continue;
+            }
+            for (size_t start = 0; start < schedule->n_cells; start++) {
+                if (schedule->cells[start].type != SLOT_TYPE_SHARED_UPLINK) {
+                    continue;
+                }
+                uint32_t duration = 0;
+                for (size_t n_shared = 0, j = start + 1; n_shared <= backoff; j++) {
+                    slot_type_t type = schedule->cells[j % schedule->n_cells].type;
+                    duration += bl_mac_get_slot_durations(type)->whole_slot;
+                    n_shared += type == SLOT_TYPE_SHARED_UPLINK;
+                }
+                match = match && since_synced + duration <= BLINK_JOIN_TIMEOUT_SINCE_SYNCED;
+                if (since_synced == 0 && duration > longest_at_sync) {
+                    longest_at_sync = duration;
+                }
+            }
+        }
+        // and the limit does not cut the backoffs short when the node has just synchronized
+        match = match && bl_assoc_node_max_backoff(0) >= (1UL << BLINK_BACKOFF_N_MIN) - 1;
+
+        char name[32];
+        snprintf(name, sizeof(name), "%u", schedule->id);
+        printf("%-10s %-18s %10u %10u %10u %8s\n", "join", name, (unsigned)bl_assoc_node_max_backoff(0),
+               (unsigned)(longest_at_sync / 1000), (unsigned)(BLINK_JOIN_TIMEOUT_SINCE_SYNCED / 1000), match ? "ok" : "MISMATCH");
+        ok = ok && match;
+    }
+    printf("\n");
+    return ok;
+}
+
+static bool _check_queue(void) {
+    // packets of varied lengths, up to the largest, so that they wrap around the end of the ring at different places
+    static const uint8_t lengths[] = { 23, 40, 31, 255, 27, 180, 33 };
+    uint8_t packet[BLINK_PACKET_MAX_SIZE];
+    uint8_t read[BLINK_PACKET_MAX_SIZE];
+    size_t pushed = 0, popped = 0, capacity = 0;
+    bool ok = true;
+
+    while (bl_queue_pop()) {}
+
+    // how many typical packets fit
+    memset(packet, 0xAB, BENCH_QUEUE_PACKET_LEN);
+    while (bl_queue_add(packet, BENCH_QUEUE_PACKET_LEN)) {
+        capacity++;
+    }
+    while (bl_queue_pop()) {}
+
+    // push two packets and pop one, draining the queue whenever it is full, and compare what comes out
+    while (popped < BENCH_QUEUE_PACKETS) {
+        for (size_t i = 0; i < 2 && pushed < BENCH_QUEUE_PACKETS; i++) {
+            uint8_t len = lengths[pushed % sizeof(lengths)];
+            for (size_t j = 0; j < len; j++) {
+                packet[j] = (uint8_t)(pushed + j);
+            }
+            if (bl_queue_add_mp(packet, len)) {
+                pushed++;
+            } else {
+                break;
+            }
+        }
+        size_t n_pops = bl_queue_length() > 0 && pushed < BENCH_QUEUE_PACKETS ? 1 : bl_queue_length();
+        for (size_t i = 0; i < n_pops; i++) {
+            uint8_t len = bl_queue_peek(read);
+            bool match = len == lengths[popped % sizeof(lengths)];
+            for (size_t j = 0; match && j < len; j++) {
+                match = read[j] == (uint8_t)(popped + j);
+            }
+            ok = ok && match && bl_queue_pop();
+            popped++;
+        }
+    }
+    ok = ok && bl_queue_length() == 0 && !bl_queue_pop();
+
+    // control packets go first, even when queued after bulk ones
+    packet[0] = 1;
+    bl_queue_add(packet, 1);
+    packet[0] = 2;
+    ok = ok && bl_queue_add_priority(packet, 1, BLINK_PRIORITY_CONTROL, 0) == 1;
+    ok = ok && bl_queue_peek(read) == 1 && read[0] == 2 && bl_queue_pop();
+    ok = ok && bl_queue_peek(read) == 1 && read[0] == 1 && bl_queue_pop();
+
+    // the fixed entries hold as many packets, whatever their length
+    size_t fixed_capacity = 0;
+    while (_fixed_queue_add(packet, BENCH_QUEUE_PACKET_LEN)) {
+        fixed_capacity++;
+    }
+    while (_fixed_queue_pop()) {}
+
+    printf("%-10s %-18s %10s %10s %8s\n", "queue", "storage", "bytes", "packets", "check");
+    printf("%-10s %-18s %10u %10u %8s\n", "queue", "bulk ring", (unsigned)BLINK_PACKET_QUEUE_BYTES, (unsigned)capacity, ok ? "ok" : "MISMATCH");
+    printf("%-10s %-18s %10u %10u %8s\n\n", "queue", "fixed entries", (unsigned)sizeof(_fixed_queue), (unsigned)fixed_capacity, "-");
+    return ok;
+}
+
+static void _bench_queue(void) {
+    uint8_t packet[BENCH_QUEUE_PACKET_LEN];
+    memset(packet, 0xAB, sizeof(packet));
+
+    // a burst of packets, then the MAC sending them
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        BENCH_MEASURE(bench_sink = bl_queue_add_mp(packet, sizeof(packet)));
+        if (!bench_sink) {
+            // the queue is full, start over
+            _bench_vars.samples.len--;
+            while (bl_queue_pop()) {}
+        }
+    }
+    _report("queue", "bl_queue_add_mp (30 B)");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        if (bl_queue_length() == 0) {
+            for (size_t j = 0; j < 8; j++) {
+                bl_queue_add_mp(packet, sizeof(packet));
+            }
+        }
+        BENCH_MEASURE(bench_sink = bl_queue_pop());
+    }
+    _report("queue", "bl_queue_pop (30 B)");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        BENCH_MEASURE(bench_sink = _fixed_queue_add(packet, sizeof(packet)));
+        if (!bench_sink) {
+            _bench_vars.samples.len--;
+            while (_fixed_queue_pop()) {}
+        }
+    }
+    _report("queue", "fixed entries add (30 B)");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        if (_fixed_queue.current == _fixed_queue.last) {
+            for (size_t j = 0; j < 8; j++) {
+                _fixed_queue_add(packet, sizeof(packet));
+            }
+        }
+        BENCH_MEASURE(bench_sink = _fixed_queue_pop());
+    }
+    _report("queue", "fixed entries pop (30 B)");
+    while (_fixed_queue_pop()) {}
+
+    while (bl_queue_pop()) {}
+}
+
+static bool _check_downlink(void) {
+    static uint32_t served[BENCH_DOWNLINK_NODES];
+    uint8_t packet[BLINK_PACKET_MAX_SIZE];
+    size_t offered = 0, refused = 0, delivered = 0;
+    uint32_t worst_wait = 0;
+
+    blink_set_node_type(BLINK_GATEWAY);
+    bl_scheduler_init(BLINK_GATEWAY, NULL);
+    bl_scheduler_set_schedule(schedule_huge.id);
+    for (size_t i = 0; i < BENCH_DOWNLINK_NODES; i++) {
+        bl_scheduler_gateway_assign_next_available_uplink_cell(_node_id(i), BENCH_ASN_BASE);
+    }
+    while (bl_queue_pop()) {}
+
+    // node 0 gets as many packets as the queue takes, the others one per period, each at its own slot,
+    // and the gateway sends one packet per downlink slot
+    memset(served, 0, sizeof(served));
+    for (uint16_t slot = 0; slot < BENCH_DOWNLINK_SLOTS; slot++) {
+        uint8_t payload[BENCH_QUEUE_PACKET_LEN - sizeof(bl_packet_header_t)] = { 0 };
+        memcpy(payload, &slot, sizeof(slot));
+        uint8_t len = bl_build_packet_data(packet, _node_id(0), payload, sizeof(payload));
+        while (bl_queue_add(packet, len)) {}
+        for (size_t i = 1; i < BENCH_DOWNLINK_NODES; i++) {
+            if (slot % BENCH_DOWNLINK_PERIOD == i * BENCH_DOWNLINK_PERIOD / BENCH_DOWNLINK_NODES) {
+                len = bl_build_packet_data(packet, _node_id(i), payload, sizeof(payload));
+                offered++;
+                refused += !bl_queue_add(packet, len);
+            }
+        }
+
+        const bl_radio_pdu_t *pdu = bl_queue_next_pdu(SLOT_TYPE_DOWNLINK);
+        if (pdu == NULL) {
+            continue;
+        }
+        const bl_packet_header_t *header = (const bl_packet_header_t *)pdu->payload;
+        for (size_t i = 0; i < BENCH_DOWNLINK_NODES; i++) {
+            if (header->dst == _node_id(i)) {
+                served[i]++;
+                break;
+            }
+        }
+        if (header->dst != _node_id(0)) {
+            uint16_t queued_slot;
+            memcpy(&queued_slot, pdu->payload + sizeof(bl_packet_header_t), sizeof(queued_slot));
+            if ((uint16_t)(slot - queued_slot) > worst_wait) {
+                worst_wait = (uint16_t)(slot - queued_slot);
+            }
+            delivered++;
+        }
+        bl_queue_tx_done();
+    }
+    while (bl_queue_pop()) {}
+
+    // the packets of a node that leaves are dropped, not sent to the next one at its position
+    uint8_t payload[BENCH_QUEUE_PACKET_LEN - sizeof(bl_packet_header_t)] = { 0 };
+    uint8_t len = bl_build_packet_data(packet, _node_id(1), payload, sizeof(payload));
+    while (bl_queue_add(packet, len)) {}
+    bl_queue_gateway_node_left(bl_scheduler_gateway_find_uplink_position(_node_id(1)));
+    bool left_ok = bl_queue_gateway_node_length(_node_id(1)) == 0 && bl_queue_length() == 0;
+
+    // every packet of the other nodes is sent, each within a round of the nodes that have some
+    bool ok = refused == 0 && delivered + BENCH_DOWNLINK_NODES >= offered && worst_wait <= BENCH_DOWNLINK_NODES && left_ok;
+    printf("%-10s %-18s %10s %10s %10s %10s %8s\n", "downlink", "nodes", "offered", "sent", "node 0", "worst", "check");
+    printf("%-10s %-18u %10u %10u %10u %10u %8s\n\n", "downlink", (unsigned)BENCH_DOWNLINK_NODES, (unsigned)offered, (unsigned)delivered,
+           (unsigned)served[0], (unsigned)worst_wait, ok ? "ok" : "MISMATCH");
+
+    bl_assoc_gateway_clear_old_nodes(UINT64_MAX);
+    return ok;
+}
+
+static void _bench_downlink(void) {
+    uint8_t packet[BLINK_PACKET_MAX_SIZE];
+    uint8_t payload[BENCH_QUEUE_PACKET_LEN - sizeof(bl_packet_header_t)] = { 0 };
+
+    blink_set_node_type(BLINK_GATEWAY);
+    bl_scheduler_init(BLINK_GATEWAY, NULL);
+    bl_scheduler_set_schedule(schedule_huge.id);
+    for (size_t i = 0; i < BENCH_DOWNLINK_NODES; i++) {
+        bl_scheduler_gateway_assign_next_available_uplink_cell(_node_id(i), BENCH_ASN_BASE);
+    }
+
+    // the queue kept full, with packets for every node
+    size_t next_node = 0;
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        do {
+            uint8_t len = bl_build_packet_data(packet, _node_id(next_node), payload, sizeof(payload));
+            next_node = (next_node + 1) % BENCH_DOWNLINK_NODES;
+            if (!bl_queue_add(packet, len)) {
+                break;
+            }
+        } while (true);
+        BENCH_MEASURE(bench_sink = bl_queue_next_pdu(SLOT_TYPE_DOWNLINK)->length);
+        bl_queue_tx_done();
+    }
+    _report("downlink", "bl_queue_next_pdu (100 nodes)");
+
+    while (bl_queue_pop()) {}
+    bl_assoc_gateway_clear_old_nodes(UINT64_MAX);
+}
+
+static void _bench_generator(void) {
+    const bl_schedule_descriptor_t *descriptor = &_generator_descriptors[BENCH_GENERATOR_LARGEST];
+    bl_generator_cursor_t cursor;
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        BENCH_MEASURE(bench_sink = bl_generator_build_cells(descriptor, _generator_cells, BENCH_GENERATOR_CELLS));
+    }
+    _report("gen4000", "bl_generator_build_cells");
+
+    // after a (re)synchronization, anywhere in the slotframe
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        uint16_t cell_index = (uint16_t)((i * 7919) % BENCH_GENERATOR_CELLS);
+        BENCH_MEASURE(bl_generator_cursor_seek(descriptor, &cursor, cell_index));
+    }
+    bench_sink = cursor.cell_index;
+    _report("gen4000", "bl_generator_cursor_seek");
+
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        uint16_t uplink_position = (uint16_t)((i * 7919) % descriptor->n_uplink);
+        BENCH_MEASURE(bench_sink = bl_generator_uplink_cell_index(descriptor, uplink_position));
+    }
+    _report("gen4000", "bl_generator_uplink_cell_index");
+
+    blink_set_node_type(BLINK_NODE);
+    bl_scheduler_init(BLINK_NODE, NULL);
+    bl_scheduler_set_generated_schedule(descriptor);
+    bl_scheduler_node_assign_myself_to_cell(bl_generator_uplink_cell_index(descriptor, descriptor->n_uplink - 1));
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_SAMPLES_MAX; i++) {
+        BENCH_MEASURE(bench_sink = bl_scheduler_tick(BENCH_ASN_BASE + i).channel);
+    }
+    _report("gen4000", "bl_scheduler_tick (node)");
+    bl_scheduler_node_deassign_myself_from_schedule();
+
+    // the node regenerates when the descriptor changes, e.g. after a handover
+    _bench_vars.samples.len = 0;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        const bl_schedule_descriptor_t *next = &_generator_descriptors[i % 2 ? 0 : BENCH_GENERATOR_LARGEST];
+        BENCH_MEASURE(bench_sink = bl_scheduler_set_generated_schedule(next));
+    }
+    _report("gen4000", "bl_scheduler_set_generated_schedule");
+}
+
+static bool _fixed_queue_add(const uint8_t *packet, uint8_t length) {
+    bench_fixed_queue_t *queue = &_fixed_queue;
+    uint8_t last = __atomic_load_n(&queue->last, __ATOMIC_RELAXED);
+    do {
+        // an entry is free once the MAC is done reading it
+        uint8_t current = __atomic_load_n(&queue->current, __ATOMIC_ACQUIRE);
+        if ((uint8_t)(last - current) >= BENCH_FIXED_QUEUE_SIZE) {
+            return false;
+        }
+        // claim the entry, against the producers that interrupt this one or are interrupted by it
+    } while (!__atomic_compare_exchange_n(&queue->last, &last, last + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    bl_radio_pdu_t *entry = &queue->packets[last % BENCH_FIXED_QUEUE_SIZE];
+    memcpy(entry->payload, packet, length);
+    entry->length = length;
+    __atomic_store_n(&queue->ready[last % BENCH_FIXED_QUEUE_SIZE], true, __ATOMIC_RELEASE);
+    return true;
+}
+
+static bool _fixed_queue_pop(void) {
+    bench_fixed_queue_t *queue = &_fixed_queue;
+    if (!__atomic_load_n(&queue->ready[queue->current % BENCH_FIXED_QUEUE_SIZE], __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    __atomic_store_n(&queue->ready[queue->current % BENCH_FIXED_QUEUE_SIZE], false, __ATOMIC_RELAXED);
+    __atomic_store_n(&queue->current, queue->current + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static uint32_t _fnv1a(const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void _event_callback(bl_event_t event, bl_event_data_t event_data) {
+    (void)event;
+    (void)event_data;
+}
+
+static uint64_t _node_id(size_t i) {
+    return 0x66b6ce28d5f79f9dULL * (i + 1);
+}
+
+static void _add_sample(uint32_t cycles) {
+    if (_bench_vars.samples.len < BENCH_SAMPLES_MAX) {
+        _bench_vars.samples.samples[_bench_vars.samples.len++] = cycles;
+    }
+}
+
+static void _report(const char *schedule, const char *function) {
+    bench_samples_t *samples = &_bench_vars.samples;
+
+    // insertion sort, there are few samples
+    for (size_t i = 1; i < samples->len; i++) {
+        uint32_t value = samples->samples[i];
+        size_t j = i;
+        while (j > 0 && samples->samples[j - 1] > value) {
+            samples->samples[j] = samples->samples[j - 1];
+            j--;
+        }
+        samples->samples[j] = value;
+    }
+    for (size_t i = 0; i < samples->len; i++) {
+        samples->samples[i] = samples->samples[i] > _bench_vars.overhead ? samples->samples[i] - _bench_vars.overhead : 0;
+    }
+
+    bench_result_t result = {
+        .schedule = schedule,
+        .function = function,
+        .len = samples->len,
+        .min = samples->samples[0],
+        .median = samples->samples[samples->len / 2],
+        .max = samples->samples[samples->len - 1],
+    };
+    printf("%-10s %-38s %8u %8u %8u\n", result.schedule, result.function, (unsigned)result.min, (unsigned)result.median, (unsigned)result.max);
+    if (_bench_vars.results_len < BENCH_RESULTS_MAX) {
+        _bench_vars.results[_bench_vars.results_len++] = result;
+    }
+}
+
+static void _print_summary(void) {
+    printf("\nbench,schedule,function,samples,min,median,max,unit\n");
+    for (size_t i = 0; i < _bench_vars.results_len; i++) {
+        bench_result_t *result = &_bench_vars.results[i];
+        printf("bench,%s,%s,%u,%u,%u,%u,%s\n", result->schedule, result->function, (unsigned)result->len,
+               (unsigned)result->min, (unsigned)result->median, (unsigned)result->max, BENCH_UNIT);
+    }
+}
+
+#if defined(BLINK_SIM)
+
+static void _platform_init(void) {
+    // a single instance, never run by the engine, so that the simulated drivers have a context
+    bl_sim_config_t config = { .seed = 1 };
+    bl_sim_init(&config);
+    bl_sim_switch(bl_sim_node_add(BLINK_GATEWAY, 0xB1E4C4B1E4C40001ULL, 0, 0, NULL));
+}
+
+static inline uint32_t _cycles_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+    return (uint32_t)__rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return (uint32_t)(now.tv_sec * 1000000000ULL + now.tv_nsec);
+#endif
+}
+
+#else
+
+static void _platform_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t _cycles_now(void) {
+    return DWT->CYCCNT;
+}
+
+#endif
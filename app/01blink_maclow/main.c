@@ -27,27 +27,27 @@ schedule_t schedule_test_app = {
     .backoff_n_max = 9,
     .n_cells = 5,
     .cells = {
-        //{'B', 0, NULL},
-        //{'S', 1, NULL},
-        //{'D', 2, NULL},
-        //{'U', 3, NULL},
-        //{'U', 4, NULL},
-
-        {'S', 0, NULL},
-        {'B', 1, NULL},
-        {'B', 2, NULL},
-        {'B', 3, NULL},
-        {'B', 4, NULL},
-
-        //{'U', 0, NULL},
-        //{'U', 1, NULL},
-        //{'U', 2, NULL},
-        //{'U', 3, NULL},
-        //{'U', 4, NULL},
+        //{'B', 0},
+        //{'S', 1},
+        //{'D', 2},
+        //{'U', 3},
+        //{'U', 4},
+
+        {'S', 0},
+        {'B', 1},
+        {'B', 2},
+        {'B', 3},
+        {'B', 4},
+
+        //{'U', 0},
+        //{'U', 1},
+        //{'U', 2},
+        //{'U', 3},
+        //{'U', 4},
     }
 };
 
-extern schedule_t schedule_minuscule, schedule_small, schedule_huge, schedule_only_beacons, schedule_only_beacons_optimized_scan;
+extern const schedule_t schedule_minuscule, schedule_small, schedule_huge, schedule_only_beacons, schedule_only_beacons_optimized_scan;
 extern bl_slot_durations_t slot_durations;
 
 // static void radio_callback(uint8_t *packet, uint8_t length);
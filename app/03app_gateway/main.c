@@ -10,11 +10,13 @@
  */
 #include <nrf.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "bl_device.h"
 #include "bl_radio.h"
 #include "bl_timer_hf.h"
 #include "blink.h"
+#include "scheduler.h"
 #include "packet.h"
 
 //=========================== defines ==========================================
@@ -28,7 +30,7 @@ typedef struct {
 } gateway_vars_t;
 
 typedef struct {
-    uint32_t n_downlink; ///< Number of packets sent to nodes (as unicast)
+    uint32_t n_downlink; ///< Number of payloads sent to nodes (in aggregated frames)
     uint32_t n_uplink;   ///< Number of packets received from nodes
 } stats_vars_t;
 
@@ -38,13 +40,12 @@ gateway_vars_t gateway_vars = { 0 };
 
 stats_vars_t stats_vars = { 0 };
 
-uint8_t packet[BLINK_PACKET_MAX_SIZE] = { 0 };
 uint8_t payload[] = { 0xFA, 0xFA, 0xFA, 0xFA, 0xFA };
 uint8_t payload_len = 5;
 
-extern schedule_t schedule_minuscule, schedule_tiny, schedule_huge;
+extern const schedule_t schedule_minuscule, schedule_tiny, schedule_huge;
 
-schedule_t *schedule_app = &schedule_huge;
+const schedule_t *schedule_app = &schedule_huge;
 
 //=========================== prototypes =======================================
 
@@ -66,6 +67,7 @@ int main(void)
     bl_timer_hf_set_periodic_us(BLINK_APP_TIMER_DEV, 1, 1000 * 1005, &_debug_print_stats);
 
     blink_init(BLINK_GATEWAY, schedule_app, &blink_event_callback);
+    blink_gateway_set_elastic_schedule(true); // start with the huge schedule, shrink it while few nodes are joined
 
     while (1) {
         __SEV();
@@ -113,13 +115,24 @@ void blink_event_callback(bl_event_t event, bl_event_data_t event_data) {
 //=========================== private ========================================
 
 void tx_to_all_connected(void) {
-    uint64_t nodes[BLINK_MAX_NODES] = { 0 };
-    uint8_t nodes_len = blink_gateway_get_nodes(nodes);
-    for (int i = 0; i < nodes_len; i++) {
-        // printf("Enqueing TX to node %d: %016llX\n", i, nodes[i]);
+    static uint64_t joined_nodes[BLINK_N_UPLINK_CELLS_MAX] = { 0 };
+    static uint64_t nodes[BLINK_N_UPLINK_CELLS_MAX] = { 0 };
+    static uint8_t payloads[BLINK_N_UPLINK_CELLS_MAX * sizeof(payload)];
+    static size_t first = 0; // the nodes left out when the queue was full go first the next time
+    size_t nodes_len = blink_gateway_get_nodes(joined_nodes);
+    if (nodes_len == 0) {
+        return;
+    }
+    first %= nodes_len;
+    for (size_t i = 0; i < nodes_len; i++) {
+        nodes[i] = joined_nodes[(first + i) % nodes_len];
         payload[0] = i;
-        uint8_t packet_len = bl_build_packet_data(packet, nodes[i], payload, payload_len);
-        blink_tx(packet, packet_len);
+        memcpy(&payloads[i * payload_len], payload, payload_len);
+    }
+    // a few frames for all the nodes, instead of one per node
+    size_t queued = blink_gateway_tx_aggregated(nodes, payloads, payload_len, nodes_len);
+    first += queued;
+    for (size_t i = 0; i < queued; i++) {
         stats_register('D');
     }
 }
@@ -141,12 +154,15 @@ void _debug_print_stats(void) {
 }
 
 void _debug_print_schedule(void) {
-    uint8_t schedule_len = schedule_app->n_cells;
+    const schedule_t *schedule = bl_scheduler_get_active_schedule_ptr(); // not schedule_app, the elastic schedule may have switched
+    uint8_t schedule_len = schedule->n_cells;
+    const bl_uplink_cells_t *uplinks = bl_scheduler_gateway_get_uplinks();
+    size_t uplink = 0;
     printf("Schedule cells: ");
     for (int i = 0; i < schedule_len; i++) {
-        cell_t cell = schedule_app->cells[i];
+        cell_t cell = schedule->cells[i];
         if (cell.type == SLOT_TYPE_UPLINK) {
-            printf("%d-U-%016llX ", i, cell.assigned_node_id);
+            printf("%d-U-%016llX ", i, uplink < uplinks->len ? uplinks->node_id[uplink++] : 0);
         } else if (cell.type == SLOT_TYPE_DOWNLINK) {
             printf("%d-D ", i);
         } else if (cell.type == SLOT_TYPE_BEACON) {
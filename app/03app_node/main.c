@@ -26,7 +26,9 @@
 #define BLINK_APP_TIMER_DEV 1
 
 typedef struct {
-    bool dummy;
+    bool            has_rx_packet;
+    blink_packet_t  rx_packet; // held in the receive pool until printed, see blink_packet_hold
+    int8_t          rx_rssi;
 } node_vars_t;
 
 //=========================== variables ========================================
@@ -36,14 +38,15 @@ node_vars_t node_vars = { 0 };
 uint8_t payload[] = { 0xF0, 0xF0, 0xF0, 0xF0, 0xF0 };
 uint8_t payload_len = 5;
 
-extern schedule_t schedule_minuscule, schedule_tiny, schedule_huge;
+extern const schedule_t schedule_minuscule, schedule_tiny, schedule_huge;
 
-schedule_t *schedule_app = &schedule_minuscule;
+const schedule_t *schedule_app = &schedule_minuscule;
 
 //=========================== prototypes =======================================
 
 static void blink_event_callback(bl_event_t event, bl_event_data_t event_data);
 static void tx_if_connected(void);
+static void print_rx_packet(void);
 
 //=========================== main =============================================
 
@@ -65,6 +68,10 @@ int main(void)
         __WFE();
 
         blink_event_loop();
+
+        if (node_vars.has_rx_packet) {
+            print_rx_packet();
+        }
     }
 }
 
@@ -73,12 +80,12 @@ int main(void)
 static void blink_event_callback(bl_event_t event, bl_event_data_t event_data) {
     switch (event) {
         case BLINK_NEW_PACKET: {
-            blink_packet_t packet = event_data.data.new_packet;
-            printf("RX %u B: src=%016llX dst=%016llX (rssi %d) payload=", packet.len, packet.header->src, packet.header->dst, bl_radio_rssi());
-            for (int i = 0; i < packet.payload_len; i++) {
-                printf("%02X ", packet.payload[i]);
+            // print from the main loop, not from the radio interrupt
+            if (!node_vars.has_rx_packet && blink_packet_hold(&event_data.data.new_packet)) {
+                node_vars.rx_packet = event_data.data.new_packet;
+                node_vars.rx_rssi = bl_radio_rssi();
+                node_vars.has_rx_packet = true;
             }
-            printf("\n");
             blink_node_tx_payload(payload, payload_len);
             break;
         }
@@ -108,6 +115,17 @@ static void blink_event_callback(bl_event_t event, bl_event_data_t event_data) {
 
 //=========================== private =========================================
 
+static void print_rx_packet(void) {
+    blink_packet_t *packet = &node_vars.rx_packet;
+    printf("RX %u B: src=%016llX dst=%016llX (rssi %d) payload=", packet->len, packet->header->src, packet->header->dst, node_vars.rx_rssi);
+    for (int i = 0; i < packet->payload_len; i++) {
+        printf("%02X ", packet->payload[i]);
+    }
+    printf("\n");
+    blink_packet_release(packet);
+    node_vars.has_rx_packet = false;
+}
+
 static void tx_if_connected(void) {
     if (blink_node_is_connected()) {
         blink_node_tx_payload(payload, payload_len);
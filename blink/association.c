@@ -26,6 +26,7 @@
 #include "scheduler.h"
 #include "bloom.h"
 #include "queue.h"
+#include "stats.h"
 
 //=========================== debug ============================================
 
@@ -52,15 +53,10 @@ bl_gpio_t led3 = { .port = 0, .pin = 16 };
 
 //=========================== defines =========================================
 
-#define BLINK_BACKOFF_N_MIN 5
-#define BLINK_BACKOFF_N_MAX 9
-
-#define BLINK_JOIN_TIMEOUT_SINCE_SYNCED (1000 * 1000 * 5) // 5 seconds. after this time, go back to scanning. NOTE: have it be based on slotframe size?
-
 // after this amount of time, consider that a join request failed (very likely due to a collision during the shared uplink slot)
-// currently set to 2 slot durations -- enough when the schedule always have a shared-uplink followed by a downlink,
+// currently set to the shared-uplink slot plus the downlink slot -- enough when the schedule always have a shared-uplink followed by a downlink,
 // and the gateway prioritizes join responses over all other downstream packets
-#define BLINK_JOINING_STATE_TIMEOUT ((BLINK_WHOLE_SLOT_DURATION * (2-1)) + (BLINK_WHOLE_SLOT_DURATION / 2)) // apply a half-slot duration just so that the timeout happens before the slot boundary
+#define BLINK_JOINING_STATE_TIMEOUT (bl_mac_get_slot_durations(SLOT_TYPE_SHARED_UPLINK)->whole_slot + (slot_durations.whole_slot / 2)) // apply a half-slot duration just so that the timeout happens before the slot boundary
 
 typedef struct {
     bl_assoc_state_t state;
@@ -70,8 +66,9 @@ typedef struct {
     // node
     uint32_t last_received_from_gateway_asn; ///< Last received packet when in joined state
     int16_t backoff_n;
-    uint8_t backoff_random_time; ///< Number of slots to wait before re-trying to join
+    uint16_t backoff_random_time; ///< Number of shared uplink slots to wait before re-trying to join
     uint32_t join_response_timeout_ts; ///< Time when the node will give up joining
+    uint32_t synced_ts; ///< Time when the node started trying to join, usually right after synchronizing
     uint16_t synced_gateway_remaining_capacity; ///< Number of nodes that my gateway can still accept
     bl_event_tag_t is_pending_disconnect; ///< Whether the node is pending a disconnect
 } assoc_vars_t;
@@ -143,11 +140,17 @@ bool bl_assoc_is_joined(void) {
 // ------------ node functions ------------
 
 void bl_assoc_node_handle_synced(void) {
+    assoc_vars.synced_ts = bl_timer_hf_now(BLINK_TIMER_DEV);
     bl_assoc_set_state(JOIN_STATE_SYNCED);
     bl_assoc_node_reset_backoff();
     bl_queue_set_join_request(bl_mac_get_synced_gateway());
 }
 
+// the beacon used to synchronize, until the next one: with long slotframes, the first join attempts happen before it
+void bl_assoc_node_set_gateway_capacity(uint16_t remaining_capacity) {
+    assoc_vars.synced_gateway_remaining_capacity = remaining_capacity;
+}
+
 bool bl_assoc_node_ready_to_join(void) {
     return assoc_vars.state == JOIN_STATE_SYNCED && assoc_vars.backoff_random_time == 0;
 }
@@ -155,6 +158,7 @@ bool bl_assoc_node_ready_to_join(void) {
 void bl_assoc_node_start_joining(void) {
     uint32_t now_ts = bl_timer_hf_now(BLINK_TIMER_DEV);
     assoc_vars.join_response_timeout_ts = now_ts + BLINK_JOINING_STATE_TIMEOUT;
+    BL_STATS_INC(join_attempts);
     bl_assoc_set_state(JOIN_STATE_JOINING);
 }
 
@@ -168,13 +172,12 @@ void bl_assoc_node_handle_joined(uint64_t gateway_id) {
 }
 
 bool bl_assoc_node_handle_failed_join(void) {
-    if (assoc_vars.synced_gateway_remaining_capacity > 0) {
+    if (assoc_vars.synced_gateway_remaining_capacity > 0 && bl_assoc_node_register_collision_backoff()) {
         bl_assoc_set_state(JOIN_STATE_SYNCED);
-        bl_assoc_node_register_collision_backoff();
         bl_queue_set_join_request(bl_mac_get_synced_gateway()); // put a join request packet back on queue
         return true;
     } else {
-        // no more capacity, go back to scanning
+        // no more capacity, or no time to try again, go back to scanning
         bl_assoc_node_handle_give_up_joining();
         return false;
     }
@@ -205,8 +208,27 @@ bool bl_assoc_node_too_long_synced_without_joining(void) {
     }
 
     uint32_t now_ts = bl_timer_hf_now(BLINK_TIMER_DEV);
-    uint32_t synced_ts = bl_mac_get_synced_ts();
-    return now_ts - synced_ts > BLINK_JOIN_TIMEOUT_SINCE_SYNCED;
+    return now_ts - assoc_vars.synced_ts > BLINK_JOIN_TIMEOUT_SINCE_SYNCED;
+}
+
+uint16_t bl_assoc_node_max_backoff(uint32_t since_synced) {
+    uint16_t n_shared_uplink = bl_scheduler_get_active_schedule_cell_count(SLOT_TYPE_SHARED_UPLINK);
+    if (n_shared_uplink == 0 || since_synced >= BLINK_JOIN_TIMEOUT_SINCE_SYNCED) {
+        return 0;
+    }
+    static const slot_type_t types[] = { SLOT_TYPE_BEACON, SLOT_TYPE_SHARED_UPLINK, SLOT_TYPE_DOWNLINK, SLOT_TYPE_UPLINK };
+    uint32_t slotframe = 0;
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        slotframe += bl_scheduler_get_active_schedule_cell_count(types[i]) * bl_mac_get_slot_durations(types[i])->whole_slot;
+    }
+    // after waiting n slots, the node joins in the next one: n + 1 shared uplink slots, which span up to one
+    // more slotframe than their share of them
+    uint32_t n_slotframes = (BLINK_JOIN_TIMEOUT_SINCE_SYNCED - since_synced) / slotframe;
+    if (n_slotframes < 2) {
+        return 0;
+    }
+    uint32_t max = (n_slotframes - 1) * n_shared_uplink - 1;
+    return max < UINT16_MAX ? max : UINT16_MAX;
 }
 
 void bl_assoc_node_reset_backoff(void) {
@@ -220,7 +242,8 @@ void bl_assoc_node_tick_backoff(void) {
     }
 }
 
-void bl_assoc_node_register_collision_backoff(void) {
+bool bl_assoc_node_register_collision_backoff(void) {
+    BL_STATS_INC(backoff_collisions);
     if (assoc_vars.backoff_n == -1) {
         // initialize backoff
         assoc_vars.backoff_n = BLINK_BACKOFF_N_MIN;
@@ -243,6 +266,9 @@ void bl_assoc_node_register_collision_backoff(void) {
     // using modulo does not give perfect uniformity,
     // but it is much faster than an exhaustive search, and good enough for our purpose
     assoc_vars.backoff_random_time = (raw % (max + 1));
+
+    // a backoff that the join timeout would cut short is not worth waiting, scan for a gateway again instead
+    return assoc_vars.backoff_random_time <= bl_assoc_node_max_backoff(bl_timer_hf_now(BLINK_TIMER_DEV) - assoc_vars.synced_ts);
 }
 
 bool bl_assoc_node_should_leave(uint32_t asn) {
@@ -280,38 +306,27 @@ void bl_assoc_node_handle_disconnect(void) {
     assoc_vars.blink_event_callback(BLINK_DISCONNECTED, event_data);
 }
 
+// the gateway switched schedules, and the node missed the CELL_MOVE for its cell: join again, still synchronized
+void bl_assoc_node_handle_cell_lost(void) {
+    BL_STATS_INC(cells_lost);
+    bl_event_data_t event_data = {
+        .data.gateway_info.gateway_id = bl_mac_get_synced_gateway(),
+        .tag = BLINK_SCHEDULE_SWITCH
+    };
+    assoc_vars.blink_event_callback(BLINK_DISCONNECTED, event_data);
+    bl_assoc_node_handle_synced();
+}
+
 // ------------ gateway functions ---------
 
 bool bl_assoc_gateway_node_is_joined(uint64_t node_id) {
-    schedule_t *schedule = bl_scheduler_get_active_schedule_ptr();
-    for (size_t i = 0; i < schedule->n_cells; i++) {
-        if (schedule->cells[i].type != SLOT_TYPE_UPLINK) {
-            // we only care about uplink cells
-            continue;
-        }
-        if (schedule->cells[i].assigned_node_id == node_id) {
-            // this node is assigned to a cell, so it is joined
-            return true;
-        }
-    }
-    return false;
+    // a node is joined if it is assigned to a cell
+    return bl_scheduler_gateway_find_node(node_id) >= 0;
 }
 
 bool bl_assoc_gateway_keep_node_alive(uint64_t node_id, uint64_t asn) {
     // save the asn of the last packet received from a certain node_id
-    schedule_t *schedule = bl_scheduler_get_active_schedule_ptr();
-    for (size_t i = 0; i < schedule->n_cells; i++) {
-        if (schedule->cells[i].type != SLOT_TYPE_UPLINK) {
-            // we only care about uplink cells
-            continue;
-        }
-        if (schedule->cells[i].assigned_node_id == node_id) {
-            // save the asn so we know this node is alive
-            schedule->cells[i].last_received_asn = asn;
-        }
-    }
-    // should never reach here
-    return false;
+    return bl_scheduler_gateway_keep_node_alive(node_id, asn);
 }
 
 void bl_assoc_gateway_clear_old_nodes(uint64_t asn) {
@@ -319,20 +334,15 @@ void bl_assoc_gateway_clear_old_nodes(uint64_t asn) {
     // also deassign the cells from the scheduler
     uint64_t max_asn_old = bl_scheduler_get_active_schedule_slot_count() * BLINK_MAX_SLOTFRAMES_NO_RX_LEAVE;
 
-    schedule_t *schedule = bl_scheduler_get_active_schedule_ptr();
-    for (size_t i = 0; i < schedule->n_cells; i++) {
-        if (schedule->cells[i].type != SLOT_TYPE_UPLINK) {
-            // we only care about uplink cells
-            continue;
-        }
-        cell_t *cell = &schedule->cells[i];
-        if (cell->assigned_node_id != 0 && asn - cell->last_received_asn > max_asn_old) {
-            bl_event_data_t event_data = (bl_event_data_t){ .data.node_info.node_id = cell->assigned_node_id, .tag = BLINK_PEER_LOST };
-            // inform the scheduler
-            bl_scheduler_gateway_decrease_nodes_counter();
-            // clear the cell
-            cell->assigned_node_id = NULL;
-            cell->last_received_asn = 0;
+    const bl_uplink_cells_t *uplinks = bl_scheduler_gateway_get_uplinks();
+    for (size_t i = 0; i < uplinks->len; i++) {
+        uint64_t node_id = uplinks->node_id[i];
+        if (node_id != 0 && asn - uplinks->last_received_asn[i] > max_asn_old) {
+            bl_event_data_t event_data = (bl_event_data_t){ .data.node_info.node_id = node_id, .tag = BLINK_PEER_LOST };
+            // clear the cell, and inform the scheduler
+            bl_scheduler_gateway_remove_node(node_id);
+            bl_stats_gateway_node_left(i);
+            bl_queue_gateway_node_left(i);
             // inform the application
             assoc_vars.blink_event_callback(BLINK_NODE_LEFT, event_data);
         }
@@ -342,14 +352,13 @@ void bl_assoc_gateway_clear_old_nodes(uint64_t asn) {
 // ------------ packet handlers -------
 
 void bl_assoc_handle_beacon(uint8_t *packet, uint8_t length, uint8_t channel, uint32_t ts) {
-    (void)length;
-
-    if (packet[1] != BLINK_PACKET_BEACON) {
+    if (packet[1] != BLINK_PACKET_BEACON || length < sizeof(bl_beacon_packet_header_t) || length < bl_packet_beacon_header_len(packet)) {
         return;
     }
 
     // now that we know it's a beacon packet, parse and process it
     bl_beacon_packet_header_t *beacon = (bl_beacon_packet_header_t *)packet;
+    const bl_beacon_channel_switch_t *channel_switch = (const bl_beacon_channel_switch_t *)(packet + sizeof(bl_beacon_packet_header_t)); // only read if the beacon has one
 
     if (beacon->version != BLINK_PROTOCOL_VERSION) {
         // ignore packet with different protocol version
@@ -358,7 +367,7 @@ void bl_assoc_handle_beacon(uint8_t *packet, uint8_t length, uint8_t channel, ui
 
     bool from_my_gateway = beacon->src == bl_mac_get_synced_gateway();
     if (from_my_gateway && bl_assoc_is_joined()) {
-        bool still_joined = bl_bloom_node_contains(bl_device_id(), packet + sizeof(bl_beacon_packet_header_t));
+        bool still_joined = bl_bloom_node_contains(bl_device_id(), packet + bl_packet_beacon_header_len(packet));
         if (!still_joined) {
             // node no longer joined to this gateway, so need to leave
             assoc_vars.is_pending_disconnect = BLINK_PEER_LOST_BLOOM;
@@ -371,6 +380,11 @@ void bl_assoc_handle_beacon(uint8_t *packet, uint8_t length, uint8_t channel, ui
     if (from_my_gateway && assoc_vars.state >= JOIN_STATE_SYNCED) {
         // save the remaining capacity of my gateway
         assoc_vars.synced_gateway_remaining_capacity = beacon->remaining_capacity;
+        // and follow its schedule switches and data channels
+        bl_scheduler_node_set_next_schedule(beacon->next_schedule_id, beacon->switch_asn);
+        uint64_t blacklist, next_blacklist, channel_switch_asn;
+        bl_packet_beacon_get_channel_blacklist(beacon, channel_switch, &blacklist, &next_blacklist, &channel_switch_asn);
+        bl_scheduler_node_set_channel_blacklist(blacklist, next_blacklist, channel_switch_asn);
     }
 
     if (beacon->remaining_capacity == 0) { // TODO: what if I am joined to this gateway? add a check for it.
@@ -379,7 +393,7 @@ void bl_assoc_handle_beacon(uint8_t *packet, uint8_t length, uint8_t channel, ui
     }
 
     // save this scan info
-    bl_scan_add(*beacon, bl_radio_rssi(), channel, ts, 0); // asn not used anymore during scan
+    bl_scan_add(*beacon, channel_switch, bl_radio_rssi(), channel, ts, 0); // asn not used anymore during scan
 
     return;
 }
@@ -19,6 +19,16 @@
 
 //=========================== defines ==========================================
 
+#ifndef BLINK_BACKOFF_N_MIN
+#define BLINK_BACKOFF_N_MIN 5 // the join backoff draws from [0, 2^n - 1] shared uplink slots, n going from N_MIN to N_MAX
+#endif
+#ifndef BLINK_BACKOFF_N_MAX
+#define BLINK_BACKOFF_N_MAX 9
+#endif
+#ifndef BLINK_JOIN_TIMEOUT_SINCE_SYNCED
+#define BLINK_JOIN_TIMEOUT_SINCE_SYNCED (1000 * 1000 * 5) // 5 seconds. after this time, go back to scanning, the backoff ends before it
+#endif
+
 typedef enum {
     JOIN_STATE_IDLE = 1,
     JOIN_STATE_SCANNING = 2,
@@ -39,16 +49,19 @@ void bl_assoc_handle_beacon(uint8_t *packet, uint8_t length, uint8_t channel, ui
 void bl_assoc_handle_packet(uint8_t *packet, uint8_t length);
 
 void bl_assoc_node_handle_synced(void);
+void bl_assoc_node_set_gateway_capacity(uint16_t remaining_capacity);
 bool bl_assoc_node_ready_to_join(void);
 void bl_assoc_node_start_joining(void);
 void bl_assoc_node_handle_joined(uint64_t gateway_id);
 bool bl_assoc_node_handle_failed_join(void);
 bool bl_assoc_node_too_long_waiting_for_join_response(void);
 bool bl_assoc_node_too_long_synced_without_joining(void);
+uint16_t bl_assoc_node_max_backoff(uint32_t since_synced); // shared uplink slots a node may wait since_synced us after synchronizing, to still join before BLINK_JOIN_TIMEOUT_SINCE_SYNCED
 void bl_assoc_node_handle_give_up_joining(void);
 void bl_assoc_node_handle_disconnect(void);
+void bl_assoc_node_handle_cell_lost(void);
 
-void bl_assoc_node_register_collision_backoff(void);
+bool bl_assoc_node_register_collision_backoff(void); // false if the backoff would not end before BLINK_JOIN_TIMEOUT_SINCE_SYNCED
 void bl_assoc_node_reset_backoff(void);
 
 bool bl_assoc_node_should_leave(uint32_t asn);
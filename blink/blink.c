@@ -22,7 +22,10 @@
 #include "association.h"
 #include "queue.h"
 #include "bloom.h"
+#include "pool.h"
 #include "blink.h"
+#include "stats.h"
+#include "energy.h"
 
 //=========================== defines ==========================================
 
@@ -48,7 +51,7 @@ static void event_callback(bl_event_t event, bl_event_data_t event_data);
 
 // -------- common --------
 
-void blink_init(bl_node_type_t node_type, schedule_t *app_schedule, bl_event_cb_t app_event_callback) {
+void blink_init(bl_node_type_t node_type, const schedule_t *app_schedule, bl_event_cb_t app_event_callback) {
     _blink_vars.node_type = node_type;
     _blink_vars.app_event_callback = app_event_callback;
 
@@ -60,8 +63,38 @@ void blink_init(bl_node_type_t node_type, schedule_t *app_schedule, bl_event_cb_
     }
 }
 
-void blink_tx(uint8_t *packet, uint8_t length) {
-    bl_queue_add(packet, length);
+int16_t blink_tx(uint8_t *packet, uint8_t length) {
+    return bl_queue_add_priority(packet, length, BLINK_PRIORITY_BULK, 0);
+}
+
+int16_t blink_tx_priority(uint8_t *packet, uint8_t length, blink_priority_t priority, uint32_t ttl) {
+    if (priority != BLINK_PRIORITY_CONTROL && priority != BLINK_PRIORITY_BULK) {
+        // there is no queue for it
+        return BLINK_TX_QUEUE_FULL;
+    }
+    return bl_queue_add_priority(packet, length, priority, ttl);
+}
+
+void blink_get_stats(bl_stats_t *stats) {
+    *stats = bl_stats_vars.stats;
+}
+
+void blink_reset_stats(void) {
+    bl_stats_reset();
+}
+
+void blink_get_energy(bl_energy_t *energy) {
+    bl_energy_get(energy);
+}
+
+void blink_reset_energy(void) {
+    bl_energy_reset();
+}
+
+uint32_t blink_get_average_current_ua(void) {
+    bl_energy_t energy;
+    bl_energy_get(&energy);
+    return bl_energy_average_current_ua(&energy, BL_POWER_PROFILE_DEFAULT);
 }
 
 bl_node_type_t blink_get_node_type(void) {
@@ -72,6 +105,22 @@ void blink_set_node_type(bl_node_type_t node_type) {
     _blink_vars.node_type = node_type;
 }
 
+uint8_t blink_get_max_packet_len(void) {
+    return bl_mac_get_max_packet_len();
+}
+
+uint64_t blink_get_channel_blacklist(void) {
+    return bl_scheduler_get_channel_blacklist();
+}
+
+bool blink_packet_hold(const blink_packet_t *packet) {
+    return bl_pool_hold(packet->header);
+}
+
+void blink_packet_release(const blink_packet_t *packet) {
+    bl_pool_release(packet->header);
+}
+
 // -------- gateway ----------
 
 size_t blink_gateway_get_nodes(uint64_t *nodes) {
@@ -82,12 +131,72 @@ size_t blink_gateway_count_nodes(void) {
     return bl_scheduler_gateway_get_nodes_count();
 }
 
+bool blink_gateway_get_node_stats(uint64_t node_id, bl_node_stats_t *node_stats) {
+    if (!bl_stats_gateway_get_node(node_id, node_stats)) {
+        return false;
+    }
+    node_stats->downlink_queued = bl_queue_gateway_node_length(node_id);
+    return true;
+}
+
+size_t blink_gateway_get_nodes_stats(bl_node_stats_t *nodes_stats) {
+    size_t count = bl_stats_gateway_get_nodes(nodes_stats);
+    for (size_t i = 0; i < count; i++) {
+        nodes_stats[i].downlink_queued = bl_queue_gateway_node_length(nodes_stats[i].node_id);
+    }
+    return count;
+}
+
+size_t blink_gateway_tx_aggregated(const uint64_t *nodes, const uint8_t *payloads, uint8_t payload_len, size_t nodes_len) {
+    uint8_t packet[BLINK_PACKET_MAX_SIZE];
+    size_t header_len = sizeof(bl_packet_header_t) + sizeof(bl_aggregated_header_t);
+    size_t entry_len = sizeof(bl_aggregated_entry_t) + payload_len;
+    uint8_t max_len = bl_mac_get_max_packet_len();
+    if (header_len + entry_len > max_len) {
+        return 0;
+    }
+
+    size_t queued = 0, len = 0, len_nodes = 0;
+    for (size_t i = 0; i < nodes_len; i++) {
+        int16_t handle = bl_scheduler_gateway_find_uplink_position(nodes[i]);
+        if (handle < 0) {
+            // not joined, nothing is queued for it
+            continue;
+        }
+        if (len + entry_len > max_len) {
+            if (bl_queue_add_priority(packet, len, BLINK_PRIORITY_BULK, 0) < 0) {
+                return queued;
+            }
+            queued += len_nodes;
+            len = 0;
+            len_nodes = 0;
+        }
+        if (len == 0) {
+            len = bl_build_packet_aggregated(packet, bl_scheduler_get_active_schedule_id());
+        }
+        len = bl_packet_aggregated_append(packet, len, handle, nodes[i], payloads + i * payload_len, payload_len);
+        len_nodes++;
+    }
+    if (len_nodes > 0 && bl_queue_add_priority(packet, len, BLINK_PRIORITY_BULK, 0) >= 0) {
+        queued += len_nodes;
+    }
+    return queued;
+}
+
+void blink_gateway_set_elastic_schedule(bool enabled) {
+    bl_scheduler_gateway_set_elastic(enabled);
+}
+
+void blink_gateway_set_max_packet_len(uint8_t max_packet_len) {
+    bl_mac_set_max_packet_len(max_packet_len);
+}
+
 // -------- node ----------
 
-void blink_node_tx_payload(uint8_t *payload, uint8_t payload_len) {
+int16_t blink_node_tx_payload(uint8_t *payload, uint8_t payload_len) {
     uint8_t packet[BLINK_PACKET_MAX_SIZE] = { 0 };
     uint8_t len = bl_build_packet_data(packet, blink_node_gateway_id(), payload, payload_len);
-    bl_queue_add(packet, len);
+    return bl_queue_add_priority(packet, len, BLINK_PRIORITY_BULK, 0);
 }
 
 bool blink_node_is_connected(void) {
@@ -114,20 +223,23 @@ void bl_handle_packet(uint8_t *packet, uint8_t length) {
         switch (header->type) {
             case BLINK_PACKET_JOIN_REQUEST: {
                 if (from_joined_node) {
-                    // already joined, ignore
+                    // already joined, so the node missed the join response: send it again, with the same cell
+                    int16_t cell_id = bl_scheduler_gateway_assign_next_available_uplink_cell(header->src, bl_mac_get_asn());
+                    bl_queue_set_join_response(header->src, (uint16_t)cell_id);
                     return;
                 }
                 // try to assign a cell to the node
                 int16_t cell_id = bl_scheduler_gateway_assign_next_available_uplink_cell(header->src, bl_mac_get_asn()); // the asn-based keep-alive is also initialized
                 if (cell_id >= 0) {
-                    // at the packet level, max_nodes is limited to 256 (using uint8_t cell_id)
-                    bl_queue_set_join_response(header->src, (uint8_t)cell_id);
+                    bl_queue_set_join_response(header->src, (uint16_t)cell_id);
                     // having an updated bloom filter ASAP is important, because otherwise
                     // the node might receive an outdated bloom and think it's already left the gateway.
                     // hence we compute it immediately instead of just setting the dirty flag
                     bl_bloom_gateway_compute();
+                    BL_STATS_INC(nodes_joined);
                     _blink_vars.app_event_callback(BLINK_NODE_JOINED, (bl_event_data_t){ .data.node_info.node_id = header->src });
                 } else {
+                    BL_STATS_INC(gateway_full);
                     _blink_vars.app_event_callback(BLINK_ERROR, (bl_event_data_t){ .tag = BLINK_GATEWAY_FULL });
                 }
                 break;
@@ -157,6 +269,29 @@ void bl_handle_packet(uint8_t *packet, uint8_t length) {
                 }
                 bl_assoc_gateway_keep_node_alive(header->src, bl_mac_get_asn()); // keep track of when the last packet was received
                 break;
+            case BLINK_PACKET_BANDWIDTH_REQUEST: {
+                if (!from_joined_node) {
+                    // ignore packets from nodes that are not joined
+                    return;
+                }
+                if (length < sizeof(bl_packet_header_t) + sizeof(bl_bandwidth_request_t)) {
+                    // too short, ignore
+                    return;
+                }
+                BL_STATS_INC(bandwidth_requests);
+                bl_bandwidth_request_t request;
+                memcpy(&request, packet + sizeof(bl_packet_header_t), sizeof(request));
+                uint16_t cell_indexes[BLINK_N_EXTRA_UPLINK_CELLS_MAX];
+                int16_t n_cells = bl_scheduler_gateway_grant_bandwidth(header->src, request.n_cells, cell_indexes);
+                if (request.n_cells > 0 && n_cells >= 0) {
+                    // a release is not answered, the node already stopped using the cells
+                    uint8_t grant[BLINK_PACKET_MAX_SIZE];
+                    size_t grant_len = bl_build_packet_bandwidth_grant(grant, header->src, bl_scheduler_get_active_schedule_id(), cell_indexes, n_cells);
+                    bl_queue_add_priority(grant, grant_len, BLINK_PRIORITY_CONTROL, 0);
+                }
+                bl_assoc_gateway_keep_node_alive(header->src, bl_mac_get_asn());
+                break;
+            }
             default:
                 break;
         }
@@ -166,7 +301,7 @@ void bl_handle_packet(uint8_t *packet, uint8_t length) {
 
         switch (header->type) {
             case BLINK_PACKET_BEACON:
-                bl_assoc_handle_beacon(packet, length, BLINK_FIXED_SCAN_CHANNEL, bl_mac_get_asn());
+                bl_assoc_handle_beacon(packet, length, bl_mac_get_channel(), bl_mac_get_asn());
                 break;
             case BLINK_PACKET_JOIN_RESPONSE: {
                 if (bl_assoc_get_state() != JOIN_STATE_JOINING) {
@@ -177,8 +312,12 @@ void bl_handle_packet(uint8_t *packet, uint8_t length) {
                     // ignore if not for me
                     return;
                 }
-                // the first byte after the header contains the cell_id
-                uint8_t cell_id = packet[sizeof(bl_packet_header_t)];
+                // the cell_id follows the header, on 2 bytes
+                uint16_t cell_id;
+                if (length < sizeof(bl_packet_header_t) + sizeof(cell_id)) {
+                    return;
+                }
+                memcpy(&cell_id, packet + sizeof(bl_packet_header_t), sizeof(cell_id));
                 if (bl_scheduler_node_assign_myself_to_cell(cell_id)) {
                     bl_assoc_node_handle_joined(header->src);
                 } else {
@@ -204,6 +343,43 @@ void bl_handle_packet(uint8_t *packet, uint8_t length) {
                 bl_assoc_node_keep_gateway_alive(bl_mac_get_asn());
                 break;
             }
+            case BLINK_PACKET_DATA_AGGREGATED: {
+                if (!from_my_joined_gateway || length < sizeof(bl_packet_header_t) + sizeof(bl_aggregated_header_t)) {
+                    // ignore data packets from other gateways
+                    return;
+                }
+                bl_assoc_node_keep_gateway_alive(bl_mac_get_asn());
+                bl_aggregated_header_t aggregated;
+                memcpy(&aggregated, packet + sizeof(bl_packet_header_t), sizeof(aggregated));
+                int16_t handle = bl_scheduler_node_get_uplink_position();
+                if (handle < 0 || aggregated.schedule_id != bl_scheduler_get_active_schedule_id()) {
+                    // the positions may have changed since the packet was built
+                    return;
+                }
+                // send the payloads for me to the application, skip the others
+                size_t offset = sizeof(bl_packet_header_t) + sizeof(bl_aggregated_header_t);
+                while (offset + sizeof(bl_aggregated_entry_t) <= length) {
+                    bl_aggregated_entry_t entry;
+                    memcpy(&entry, packet + offset, sizeof(entry));
+                    offset += sizeof(entry);
+                    if (offset + entry.len > length) {
+                        break;
+                    }
+                    if (entry.handle == (uint16_t)handle && entry.node_id_low == (uint16_t)bl_device_id()) {
+                        bl_event_data_t event_data = {
+                            .data.new_packet = {
+                                .len = length,
+                                .header = header,
+                                .payload = packet + offset,
+                                .payload_len = entry.len
+                            }
+                        };
+                        _blink_vars.app_event_callback(BLINK_NEW_PACKET, event_data);
+                    }
+                    offset += entry.len;
+                }
+                break;
+            }
             case BLINK_PACKET_KEEPALIVE:
                 if (!from_my_joined_gateway) {
                     // ignore keep-alives from other gateways
@@ -211,6 +387,33 @@ void bl_handle_packet(uint8_t *packet, uint8_t length) {
                 }
                 bl_assoc_node_keep_gateway_alive(bl_mac_get_asn());
                 break;
+            case BLINK_PACKET_CELL_MOVE: {
+                if (!from_my_joined_gateway || length < sizeof(bl_packet_header_t) + sizeof(bl_cell_move_t)) {
+                    return;
+                }
+                bl_cell_move_t cell_move;
+                memcpy(&cell_move, packet + sizeof(bl_packet_header_t), sizeof(cell_move));
+                if (bl_scheduler_node_move_myself_to_cell(cell_move.schedule_id, cell_move.cell_index)) {
+                    BL_STATS_INC(cell_moves);
+                }
+                bl_assoc_node_keep_gateway_alive(bl_mac_get_asn());
+                break;
+            }
+            case BLINK_PACKET_BANDWIDTH_GRANT: {
+                if (!from_my_joined_gateway || length < sizeof(bl_packet_header_t) + sizeof(bl_bandwidth_grant_t)) {
+                    return;
+                }
+                bl_bandwidth_grant_t grant;
+                memcpy(&grant, packet + sizeof(bl_packet_header_t), sizeof(grant));
+                if (grant.n_cells > BLINK_N_EXTRA_UPLINK_CELLS_MAX || length < sizeof(bl_packet_header_t) + sizeof(grant) + grant.n_cells * sizeof(uint16_t)) {
+                    return;
+                }
+                uint16_t cell_indexes[BLINK_N_EXTRA_UPLINK_CELLS_MAX];
+                memcpy(cell_indexes, packet + sizeof(bl_packet_header_t) + sizeof(grant), grant.n_cells * sizeof(uint16_t));
+                bl_scheduler_node_set_extra_cells(grant.schedule_id, cell_indexes, grant.n_cells);
+                bl_assoc_node_keep_gateway_alive(bl_mac_get_asn());
+                break;
+            }
             default:
                 break;
         }
@@ -233,7 +436,20 @@ void blink_event_loop(void) {
 static void event_callback(bl_event_t event, bl_event_data_t event_data) {
     // handle some events internally
     switch(event) {
+        case BLINK_CONNECTED:
+            BL_STATS_INC(joins);
+            break;
+        case BLINK_DISCONNECTED:
+            if (event_data.tag == BLINK_HANDOVER) {
+                BL_STATS_INC(handovers);
+            } else if (event_data.tag == BLINK_PEER_LOST_TIMEOUT) {
+                BL_STATS_INC(leaves_timeout);
+            } else if (event_data.tag == BLINK_PEER_LOST_BLOOM) {
+                BL_STATS_INC(leaves_bloom);
+            }
+            break;
         case BLINK_NODE_LEFT:
+            BL_STATS_INC(nodes_lost);
             bl_bloom_gateway_set_dirty();
             break;
         default:
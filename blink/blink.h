@@ -15,24 +15,43 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "models.h"
+#include "stats.h"
+#include "energy.h"
 
 //=========================== defines ==========================================
 
 #define BLINK_MAX_NODES 10 // TODO: find a way to sync with the pre-stored schedules
 #define BLINK_BROADCAST_ADDRESS 0xFFFFFFFFFFFFFFFF
+#define BLINK_TX_QUEUE_FULL (-1) // returned by the tx functions when the packet is not queued
 
 //=========================== prototypes ==========================================
 
-void blink_init(bl_node_type_t node_type, schedule_t *app_schedule, bl_event_cb_t app_event_callback);
+void blink_init(bl_node_type_t node_type, const schedule_t *app_schedule, bl_event_cb_t app_event_callback);
 void blink_event_loop(void);
-void blink_tx(uint8_t *packet, uint8_t length);
+int16_t blink_tx(uint8_t *packet, uint8_t length); // bulk, returns the packets waiting in its queue, or BLINK_TX_QUEUE_FULL
+int16_t blink_tx_priority(uint8_t *packet, uint8_t length, blink_priority_t priority, uint32_t ttl); // dropped if not sent within ttl slots, 0 for never, BLINK_TX_QUEUE_FULL for an unknown priority
+void blink_get_stats(bl_stats_t *stats);
+void blink_reset_stats(void);
+void blink_get_energy(bl_energy_t *energy);
+void blink_reset_energy(void);
+uint32_t blink_get_average_current_ua(void);
 bl_node_type_t blink_get_node_type(void);
 void blink_set_node_type(bl_node_type_t node_type);
+uint8_t blink_get_max_packet_len(void); // largest frame of the network, longer ones are dropped from the queue
+uint64_t blink_get_channel_blacklist(void); // data channels the network does not hop on, bit i for channel i
 
 size_t blink_gateway_get_nodes(uint64_t *nodes);
 size_t blink_gateway_count_nodes(void);
+bool blink_gateway_get_node_stats(uint64_t node_id, bl_node_stats_t *node_stats);
+size_t blink_gateway_get_nodes_stats(bl_node_stats_t *nodes_stats);
+size_t blink_gateway_tx_aggregated(const uint64_t *nodes, const uint8_t *payloads, uint8_t payload_len, size_t nodes_len); // payload_len bytes for each node, back to back, packed into as few frames as fit, returns the nodes whose payload is queued
+void blink_gateway_set_elastic_schedule(bool enabled); // switch between the available schedules as nodes join and leave, see bl_scheduler_gateway_update_elastic_schedule
+void blink_gateway_set_max_packet_len(uint8_t max_packet_len); // to be called before blink_init, shorter frames make shorter slots
 
-void blink_node_tx_payload(uint8_t *payload, uint8_t payload_len);
+bool blink_packet_hold(const blink_packet_t *packet); // keeps the packet of a BLINK_NEW_PACKET event past the callback, until blink_packet_release, false if no buffer is left for the radio
+void blink_packet_release(const blink_packet_t *packet);
+
+int16_t blink_node_tx_payload(uint8_t *payload, uint8_t payload_len); // same as blink_tx
 bool blink_node_is_connected(void);
 uint64_t blink_node_gateway_id(void);
 
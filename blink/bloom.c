@@ -23,7 +23,7 @@ typedef struct {
     // used by the gateway
     bool is_dirty; // true if the bloom filter needs to be re-computed
     bool is_available; // true if the bloom filter is being computed
-    uint8_t bloom[BLINK_BLOOM_M_BYTES]; // bloom filter output
+    uint8_t bloom[BLINK_BLOOM_M_BYTES_MAX]; // bloom filter output
 } bloom_vars_t;
 
 //=========================== variables ========================================
@@ -68,17 +68,13 @@ void bl_bloom_gateway_compute(void) {
     bloom_vars.is_available = false;
     memset(bloom_vars.bloom, 0, BLINK_BLOOM_M_BYTES);
 
-    schedule_t *schedule_ptr = bl_scheduler_get_active_schedule_ptr();
+    const bl_uplink_cells_t *uplinks = bl_scheduler_gateway_get_uplinks();
 
-    for (size_t i = 0; i < schedule_ptr->n_cells; i++) {
-        cell_t *cell = &schedule_ptr->cells[i];
-        if (cell->type != SLOT_TYPE_UPLINK) {
-            continue; // skip non-uplink cells
-        }
-        if (cell->assigned_node_id == NULL) {
+    for (size_t i = 0; i < uplinks->len; i++) {
+        uint64_t id = uplinks->node_id[i];
+        if (id == 0) {
             continue; // skip empty cells
         }
-        uint64_t id = cell->assigned_node_id;
 
         uint64_t h1 = bl_fnv1a64(id);
         uint64_t h2 = bl_fnv1a64(id ^ BLINK_BLOOM_FNV1A_H2_SALT);
@@ -18,9 +18,16 @@
 
 //=========================== defines =========================================
 
-#define BLINK_BLOOM_M_BITS 1024
+#ifndef BLINK_BLOOM_M_BITS
+#define BLINK_BLOOM_M_BITS 1024 // must be a power of 2
+#endif
 #define BLINK_BLOOM_M_BYTES (BLINK_BLOOM_M_BITS / 8)
+#ifndef BLINK_BLOOM_M_BYTES_MAX
+#define BLINK_BLOOM_M_BYTES_MAX BLINK_BLOOM_M_BYTES // storage reserved for the filter, can be larger when BLINK_BLOOM_M_BITS is not a constant
+#endif
+#ifndef BLINK_BLOOM_K_HASHES
 #define BLINK_BLOOM_K_HASHES 2
+#endif
 
 #define BLINK_BLOOM_FNV1A_H2_SALT 0x5bd1e995
 
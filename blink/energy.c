@@ -0,0 +1,84 @@
+/**
+ * @file
+ * @ingroup     energy
+ *
+ * @brief       Radio-on time and energy accounting
+ *
+ * @copyright Inria, 2025-now
+ */
+
+#include <nrf.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "bl_timer_hf.h"
+#include "mac.h"
+#include "energy.h"
+
+//=========================== variables ========================================
+
+bl_energy_vars_t bl_energy_vars = { 0 };
+
+// Typical values from the product specifications, at 3 V with the DC/DC converter enabled,
+// BLE 2 Mbit/s and 0 dBm. While sleeping between radio operations, the high frequency
+// crystal and the slot timer keep running.
+const bl_power_profile_t bl_power_profile_nrf52840 = {
+    .name = "nrf52840",
+    .current_ua = {
+        [BL_ENERGY_SLEEP]       = 500,
+        [BL_ENERGY_TX]          = 4800,
+        [BL_ENERGY_RX_LISTEN]   = 4600,
+        [BL_ENERGY_RX_DATA]     = 4600,
+        [BL_ENERGY_SCAN]        = 4600,
+    },
+};
+
+// Network core, the application core is accounted as idle
+const bl_power_profile_t bl_power_profile_nrf5340 = {
+    .name = "nrf5340",
+    .current_ua = {
+        [BL_ENERGY_SLEEP]       = 400,
+        [BL_ENERGY_TX]          = 3200,
+        [BL_ENERGY_RX_LISTEN]   = 2800,
+        [BL_ENERGY_RX_DATA]     = 2800,
+        [BL_ENERGY_SCAN]        = 2800,
+    },
+};
+
+//=========================== public ===========================================
+
+void bl_energy_init(void) {
+    memset(&bl_energy_vars, 0, sizeof(bl_energy_vars));
+    bl_energy_vars.state = BL_ENERGY_SLEEP;
+    bl_energy_vars.state_ts = bl_timer_hf_now(BLINK_TIMER_DEV);
+}
+
+void bl_energy_get(bl_energy_t *energy) {
+    // the MAC updates the counters from interrupts
+    __disable_irq();
+    uint32_t now_ts = bl_timer_hf_now(BLINK_TIMER_DEV);
+    *energy = bl_energy_vars.energy;
+    energy->us[bl_energy_vars.state] += now_ts - bl_energy_vars.state_ts;
+    __enable_irq();
+}
+
+void bl_energy_reset(void) {
+    __disable_irq();
+    memset(&bl_energy_vars.energy, 0, sizeof(bl_energy_t));
+    bl_energy_vars.state_ts = bl_timer_hf_now(BLINK_TIMER_DEV);
+    __enable_irq();
+}
+
+uint32_t bl_energy_average_current_ua(const bl_energy_t *energy, const bl_power_profile_t *profile) {
+    uint64_t total_us = 0;
+    uint64_t charge = 0; // in uA.us
+    for (size_t i = 0; i < BL_ENERGY_STATES; i++) {
+        total_us += energy->us[i];
+        charge += energy->us[i] * profile->current_ua[i];
+    }
+    if (total_us == 0) {
+        return 0;
+    }
+    return (uint32_t)(charge / total_us);
+}
@@ -0,0 +1,76 @@
+#ifndef __ENERGY_H
+#define __ENERGY_H
+
+/**
+ * @ingroup     blink
+ * @brief       Radio-on time and energy accounting
+ *
+ * The MAC reports every change of radio activity, and the time spent in each
+ * one is accumulated, in us. Combined with the current drawn in each activity,
+ * from a per-chip power profile, this gives the average current of the device,
+ * so that schedules and keep-alive policies can be compared by energy cost.
+ *
+ * @{
+ * @file
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=========================== defines ==========================================
+
+typedef enum {
+    BL_ENERGY_SLEEP,        ///< Radio off, including the tx/rx offsets before a radio operation
+    BL_ENERGY_TX,
+    BL_ENERGY_RX_LISTEN,    ///< Radio on, waiting for a packet in a slot
+    BL_ENERGY_RX_DATA,      ///< Receiving a packet in a slot
+    BL_ENERGY_SCAN,         ///< Radio on while scanning for gateways, in the foreground or in the background
+    BL_ENERGY_STATES,
+} bl_energy_state_t;
+
+typedef struct {
+    uint64_t us[BL_ENERGY_STATES];  ///< Time spent in each state, see bl_energy_state_t
+} bl_energy_t;
+
+typedef struct {
+    const char  *name;
+    uint32_t    current_ua[BL_ENERGY_STATES];   ///< Average current drawn by the chip in each state
+} bl_power_profile_t;
+
+typedef struct {
+    bl_energy_t         energy;
+    bl_energy_state_t   state;      ///< Current state
+    uint32_t            state_ts;   ///< When the current state was entered, or last accounted
+} bl_energy_vars_t;
+
+//=========================== variables ========================================
+
+extern bl_energy_vars_t bl_energy_vars;
+
+extern const bl_power_profile_t bl_power_profile_nrf52840;
+extern const bl_power_profile_t bl_power_profile_nrf5340;
+
+#if defined(NRF5340_XXAA)
+#define BL_POWER_PROFILE_DEFAULT (&bl_power_profile_nrf5340)
+#else
+#define BL_POWER_PROFILE_DEFAULT (&bl_power_profile_nrf52840)
+#endif
+
+//=========================== prototypes =======================================
+
+void bl_energy_init(void);
+void bl_energy_get(bl_energy_t *energy);
+void bl_energy_reset(void);
+uint32_t bl_energy_average_current_ua(const bl_energy_t *energy, const bl_power_profile_t *profile);
+
+//=========================== inline ===========================================
+
+static inline void bl_energy_enter(bl_energy_state_t state, uint32_t now_ts) {
+    bl_energy_vars.energy.us[bl_energy_vars.state] += now_ts - bl_energy_vars.state_ts;
+    bl_energy_vars.state = state;
+    bl_energy_vars.state_ts = now_ts;
+}
+
+#endif // __ENERGY_H
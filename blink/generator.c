@@ -0,0 +1,185 @@
+/**
+ * @file
+ * @ingroup     blink
+ *
+ * @brief       Schedules generated at runtime, see generator.h
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "generator.h"
+
+//=========================== defines ==========================================
+
+// channel = (asn + channel_offset) % 37, with asn = slotframe * n_cells + i: an offset of i * (step - 1) advances the channel by the step from one cell to the next
+#define BLINK_GENERATOR_OFFSET_STEP (BLINK_GENERATOR_CHANNEL_STEP - 1)
+
+//=========================== prototypes =======================================
+
+static inline uint32_t _n_cells(const bl_schedule_descriptor_t *descriptor);
+static inline uint32_t _block_start(const bl_schedule_descriptor_t *descriptor, uint32_t block);
+static void _start_block(const bl_schedule_descriptor_t *descriptor, bl_generator_cursor_t *cursor);
+static void _rewind(bl_generator_cursor_t *cursor);
+static inline void _set_block_cell(bl_generator_cursor_t *cursor);
+
+//=========================== public ===========================================
+
+bool bl_generator_is_valid(const bl_schedule_descriptor_t *descriptor) {
+    return descriptor->n_beacons != 0 &&
+           descriptor->n_downlink != 0 &&
+           descriptor->n_shared_uplink <= descriptor->n_downlink &&
+           _n_cells(descriptor) <= BLINK_GENERATOR_N_CELLS_MAX;
+}
+
+bool bl_generator_build_schedule(const bl_schedule_descriptor_t *descriptor, schedule_t *schedule) {
+    if (!bl_generator_is_valid(descriptor)) {
+        return false;
+    }
+    schedule->id = BLINK_SCHEDULE_ID_GENERATED;
+    schedule->max_nodes = descriptor->n_uplink < BLINK_N_UPLINK_CELLS_MAX ? descriptor->n_uplink : BLINK_N_UPLINK_CELLS_MAX;
+    schedule->backoff_n_min = BLINK_GENERATOR_BACKOFF_N_MIN;
+    schedule->backoff_n_max = BLINK_GENERATOR_BACKOFF_N_MAX;
+    schedule->n_cells = _n_cells(descriptor);
+    schedule->descriptor = *descriptor;
+    return true;
+}
+
+void bl_generator_cursor_seek(const bl_schedule_descriptor_t *descriptor, bl_generator_cursor_t *cursor, uint16_t cell_index) {
+    _rewind(cursor);
+    cursor->uplink_quotient = descriptor->n_uplink / descriptor->n_downlink;
+    cursor->uplink_remainder = descriptor->n_uplink % descriptor->n_downlink;
+    cursor->cell_index = cell_index;
+    cursor->hop_offset = ((uint32_t)cell_index * BLINK_GENERATOR_OFFSET_STEP) % BLINK_N_BLE_REGULAR_CHANNELS;
+    if (cell_index < descriptor->n_beacons) {
+        return;
+    }
+
+    // blocks start every n_data / n_downlink cells or so, the estimate is at most a couple of blocks early
+    uint32_t data_index = cell_index - descriptor->n_beacons;
+    uint32_t n_data = _n_cells(descriptor) - descriptor->n_beacons;
+    uint32_t block = data_index * descriptor->n_downlink / n_data;
+    while (block + 1 < descriptor->n_downlink && _block_start(descriptor, block + 1) <= data_index) {
+        block++;
+    }
+
+    cursor->block = block;
+    cursor->shared_acc = (block * descriptor->n_shared_uplink) % descriptor->n_downlink;
+    cursor->uplink_acc = (block * descriptor->n_uplink) % descriptor->n_downlink;
+    _start_block(descriptor, cursor);
+    cursor->block_offset = data_index - _block_start(descriptor, block);
+    cursor->uplink_position = (block * descriptor->n_uplink) / descriptor->n_downlink;
+    if (cursor->block_offset > cursor->block_shared) {
+        cursor->uplink_position += cursor->block_offset - cursor->block_shared - 1;
+    }
+    _set_block_cell(cursor);
+}
+
+void bl_generator_cursor_advance(const bl_schedule_descriptor_t *descriptor, bl_generator_cursor_t *cursor) {
+    bool was_uplink = cursor->cell.type == SLOT_TYPE_UPLINK;
+
+    if (++cursor->cell_index == _n_cells(descriptor)) {
+        _rewind(cursor);
+        return;
+    }
+    cursor->hop_offset += BLINK_GENERATOR_OFFSET_STEP;
+    if (cursor->hop_offset >= BLINK_N_BLE_REGULAR_CHANNELS) {
+        cursor->hop_offset -= BLINK_N_BLE_REGULAR_CHANNELS;
+    }
+    if (cursor->cell_index < descriptor->n_beacons) {
+        return;
+    }
+
+    if (cursor->cell_index == descriptor->n_beacons) {
+        _start_block(descriptor, cursor);
+    } else {
+        if (was_uplink) {
+            cursor->uplink_position++;
+        }
+        if (++cursor->block_offset == cursor->block_shared + 1 + cursor->block_uplinks) {
+            cursor->block++;
+            _start_block(descriptor, cursor);
+        }
+    }
+    _set_block_cell(cursor);
+}
+
+uint16_t bl_generator_uplink_cell_index(const bl_schedule_descriptor_t *descriptor, uint16_t uplink_position) {
+    // the block holding the uplink cell is the last one whose first uplink cell is not after it
+    uint32_t block = ((uint32_t)(uplink_position + 1) * descriptor->n_downlink - 1) / descriptor->n_uplink;
+    uint32_t block_shared = ((block + 1) * descriptor->n_shared_uplink) / descriptor->n_downlink - (block * descriptor->n_shared_uplink) / descriptor->n_downlink;
+    uint32_t first_uplink = (block * descriptor->n_uplink) / descriptor->n_downlink;
+    return descriptor->n_beacons + _block_start(descriptor, block) + block_shared + 1 + (uplink_position - first_uplink);
+}
+
+size_t bl_generator_build_cells(const bl_schedule_descriptor_t *descriptor, cell_t *cells, size_t max_cells) {
+    if (!bl_generator_is_valid(descriptor) || _n_cells(descriptor) > max_cells) {
+        return 0;
+    }
+    bl_generator_cursor_t cursor;
+    bl_generator_cursor_seek(descriptor, &cursor, 0);
+    size_t n_cells = _n_cells(descriptor);
+    for (size_t i = 0; i < n_cells; i++) {
+        cells[i] = cursor.cell;
+        bl_generator_cursor_advance(descriptor, &cursor);
+    }
+    return n_cells;
+}
+
+//=========================== private ==========================================
+
+static inline uint32_t _n_cells(const bl_schedule_descriptor_t *descriptor) {
+    return (uint32_t)descriptor->n_beacons + descriptor->n_shared_uplink + descriptor->n_downlink + descriptor->n_uplink;
+}
+
+// index of the first cell of a block, after the beacon cells
+static inline uint32_t _block_start(const bl_schedule_descriptor_t *descriptor, uint32_t block) {
+    return block + (block * descriptor->n_shared_uplink) / descriptor->n_downlink + (block * descriptor->n_uplink) / descriptor->n_downlink;
+}
+
+// enters cursor->block, whose accumulators hold block * n % n_downlink: block k gets floor((k + 1) * n / n_downlink) - floor(k * n / n_downlink) cells of each type
+static void _start_block(const bl_schedule_descriptor_t *descriptor, bl_generator_cursor_t *cursor) {
+    cursor->block_offset = 0;
+
+    cursor->block_shared = 0;
+    cursor->shared_acc += descriptor->n_shared_uplink;
+    if (cursor->shared_acc >= descriptor->n_downlink) {
+        cursor->shared_acc -= descriptor->n_downlink;
+        cursor->block_shared = 1;
+    }
+
+    cursor->block_uplinks = cursor->uplink_quotient;
+    cursor->uplink_acc += cursor->uplink_remainder;
+    if (cursor->uplink_acc >= descriptor->n_downlink) {
+        cursor->uplink_acc -= descriptor->n_downlink;
+        cursor->block_uplinks++;
+    }
+}
+
+// back to the first cell, a beacon, keeping the constants of the descriptor
+static void _rewind(bl_generator_cursor_t *cursor) {
+    cursor->cell_index = 0;
+    cursor->cell = (cell_t){ .type = SLOT_TYPE_BEACON, .channel_offset = 0 }; // beacons hop on the advertising channels
+    cursor->uplink_position = 0;
+    cursor->hop_offset = 0;
+    cursor->block = 0;
+    cursor->block_offset = 0;
+    cursor->block_shared = 0;
+    cursor->block_uplinks = 0;
+    cursor->shared_acc = 0;
+    cursor->uplink_acc = 0;
+}
+
+// a block is an optional shared uplink cell, a downlink cell, then uplink cells
+static inline void _set_block_cell(bl_generator_cursor_t *cursor) {
+    if (cursor->block_offset < cursor->block_shared) {
+        cursor->cell.type = SLOT_TYPE_SHARED_UPLINK;
+    } else if (cursor->block_offset == cursor->block_shared) {
+        cursor->cell.type = SLOT_TYPE_DOWNLINK;
+    } else {
+        cursor->cell.type = SLOT_TYPE_UPLINK;
+    }
+    cursor->cell.channel_offset = cursor->hop_offset;
+}
@@ -0,0 +1,120 @@
+#ifndef __GENERATOR_H
+#define __GENERATOR_H
+
+/**
+ * @ingroup     blink
+ * @brief       Schedules generated at runtime
+ *
+ * Instead of a table in all_schedules.c, a schedule can be described by its
+ * number of cells of each type (bl_schedule_descriptor_t). Gateways advertise
+ * the descriptor in their beacons, with the BLINK_SCHEDULE_ID_GENERATED schedule
+ * id, and nodes generate the same cells from it. Only integer arithmetic is used,
+ * so the cells do not depend on the device that generates them.
+ *
+ * The beacon cells come first, then the rest of the slotframe is cut into
+ * n_downlink blocks, each one holding one downlink cell, so that a downlink
+ * packet never waits much longer than n_cells / n_downlink slots. The shared
+ * uplink and uplink cells are spread evenly over the blocks: a block is an
+ * optional shared uplink cell, the downlink cell, then its uplink cells. Like in
+ * the built-in schedules, each shared uplink cell is thus right before a downlink
+ * cell, where the gateway answers join requests (see BLINK_JOINING_STATE_TIMEOUT),
+ * so a descriptor needs at least as many downlink cells as shared uplink cells.
+ * Channel offsets are chosen so that consecutive cells hop by
+ * BLINK_GENERATOR_CHANNEL_STEP channels, which uses every channel the same
+ * number of times per slotframe, give or take one.
+ *
+ * The cells are never stored: the scheduler walks them with a
+ * bl_generator_cursor_t, so a generated schedule can be much longer than
+ * BLINK_N_CELLS_MAX without using more RAM.
+ *
+ * @{
+ * @file
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "models.h"
+
+//=========================== defines ==========================================
+
+#define BLINK_SCHEDULE_ID_GENERATED (0x80) // the cells come from the descriptor in the beacon
+
+#define BLINK_GENERATOR_N_CELLS_MAX (INT16_MAX) // cell indices are int16_t in the scheduler API, and uint16_t in join responses
+#define BLINK_GENERATOR_CHANNEL_STEP (23) // coprime with BLINK_N_BLE_REGULAR_CHANNELS, close to 37 divided by the golden ratio
+#define BLINK_GENERATOR_BACKOFF_N_MIN (5)
+#define BLINK_GENERATOR_BACKOFF_N_MAX (9)
+
+/// Position in a generated schedule, moving to the next cell needs no division
+typedef struct {
+    uint16_t    cell_index;         ///< Index of the cell in the schedule
+    cell_t      cell;               ///< The cell, with a channel offset below BLINK_N_BLE_REGULAR_CHANNELS
+    uint16_t    uplink_position;    ///< Number of uplink cells before this one
+    uint8_t     hop_offset;         ///< Channel offset of the cell if it is not a beacon
+    uint8_t     block;              ///< Block of the cell, one per downlink cell
+    uint16_t    block_offset;       ///< Position of the cell in its block
+    uint8_t     block_shared;       ///< Number of shared uplink cells in the block, 0 or 1
+    uint16_t    block_uplinks;      ///< Number of uplink cells in the block
+    uint16_t    shared_acc;         ///< (block + 1) * n_shared_uplink % n_downlink
+    uint16_t    uplink_acc;         ///< (block + 1) * n_uplink % n_downlink
+    uint16_t    uplink_quotient;    ///< n_uplink / n_downlink
+    uint16_t    uplink_remainder;   ///< n_uplink % n_downlink
+} bl_generator_cursor_t;
+
+//=========================== prototypes =======================================
+
+/**
+ * @brief Checks that a descriptor can be generated
+ *
+ * @return false if it has no beacon or downlink cell, more shared uplink than downlink cells, or more than BLINK_GENERATOR_N_CELLS_MAX cells
+ */
+bool bl_generator_is_valid(const bl_schedule_descriptor_t *descriptor);
+
+/**
+ * @brief Fills a schedule_t with a generated schedule, with the BLINK_SCHEDULE_ID_GENERATED id
+ *
+ * The cells array is left untouched, use a bl_generator_cursor_t to walk the cells.
+ *
+ * @return false if the descriptor is not valid
+ */
+bool bl_generator_build_schedule(const bl_schedule_descriptor_t *descriptor, schedule_t *schedule);
+
+/**
+ * @brief Moves a cursor to any cell of a valid descriptor, in constant time
+ *
+ * @param[in]  descriptor   number of cells of each type
+ * @param[out] cursor       cursor to move
+ * @param[in]  cell_index   index of the cell, below the number of cells
+ */
+void bl_generator_cursor_seek(const bl_schedule_descriptor_t *descriptor, bl_generator_cursor_t *cursor, uint16_t cell_index);
+
+/**
+ * @brief Moves a cursor to the next cell, back to the first one after the last one
+ */
+void bl_generator_cursor_advance(const bl_schedule_descriptor_t *descriptor, bl_generator_cursor_t *cursor);
+
+/**
+ * @brief Computes the index of an uplink cell, in constant time
+ *
+ * @param[in] descriptor        number of cells of each type
+ * @param[in] uplink_position   position of the cell among the uplink cells, below n_uplink
+ *
+ * @return index of the cell in the schedule
+ */
+uint16_t bl_generator_uplink_cell_index(const bl_schedule_descriptor_t *descriptor, uint16_t uplink_position);
+
+/**
+ * @brief Computes all the cells of a generated schedule, e.g. to compare them across devices
+ *
+ * @param[in]  descriptor   number of cells of each type
+ * @param[out] cells        generated cells
+ * @param[in]  max_cells    capacity of @p cells
+ *
+ * @return number of cells, or 0 if the descriptor is invalid or the cells do not fit
+ */
+size_t bl_generator_build_cells(const bl_schedule_descriptor_t *descriptor, cell_t *cells, size_t max_cells);
+
+#endif // __GENERATOR_H
@@ -19,21 +19,24 @@
 #include "queue.h"
 #include "scan.h"
 #include "scheduler.h"
+#include "generator.h"
 #include "association.h"
+#include "bloom.h"
+#include "pool.h"
 #include "bl_radio.h"
 #include "bl_timer_hf.h"
 #include "packet.h"
 #include "bl_device.h"
+#include "trace.h"
+#include "stats.h"
+#include "energy.h"
 #if defined(NRF5340_XXAA) && defined(NRF_NETWORK)
 #include "ipc.h"
 #endif
 
 //=========================== debug ============================================
 
-#ifndef DEBUG // FIXME: remove before merge. Just to make VS Code enable code behind `#ifdef DEBUG`
-#define DEBUG
-#endif
-
+// pins for a logic analyzer, when building with DEBUG; see trace.h for a trace that works without one
 #ifdef DEBUG
 #include "bl_gpio.h" // for debugging
 // pins connected to logic analyzer, variable names reflect the channel number
@@ -46,11 +49,17 @@ bl_gpio_t pin3 = { .port = 1, .pin = 5 };
 #define DEBUG_GPIO_CLEAR(pin) bl_gpio_clear(pin)
 #else
 // No-op when DEBUG is not defined
-#define DEBUG_GPIO_TOGGLE(pin) ((void)0))
-#define DEBUG_GPIO_SET(pin) ((void)0))
-#define DEBUG_GPIO_CLEAR(pin) ((void)0))
+#define DEBUG_GPIO_TOGGLE(pin) ((void)0)
+#define DEBUG_GPIO_SET(pin) ((void)0)
+#define DEBUG_GPIO_CLEAR(pin) ((void)0)
 #endif // DEBUG
 
+#if BLINK_TRACE_ENABLED
+#define TRACE(activity, arg) bl_trace_emit(bl_timer_hf_now(BLINK_TIMER_DEV), mac_vars.asn, activity, mac_vars.state, arg)
+#else
+#define TRACE(activity, arg) ((void)0)
+#endif
+
 //=========================== defines ==========================================
 
 typedef enum {
@@ -74,23 +83,31 @@ typedef struct {
 
     bl_mac_state_t state; ///< State within the slot
     uint32_t start_slot_ts; ///< Timestamp of the start of the slot
+    uint32_t slot_ref_ts; ///< Expected start of the slot, reference of the inter-slot timer
     uint64_t asn; ///< Absolute slot number
     bl_slot_info_t current_slot_info; ///< Information about the current slot
+    const bl_slot_durations_t *current_durations; ///< Durations of the current slot, which depend on its type
 
     bl_event_cb_t blink_event_callback; ///< Function pointer, stores the application callback
 
     bl_received_packet_t received_packet; ///< Last received packet
+    bl_radio_pdu_t *rx_pdu; ///< Pool buffer the radio receives into, see pool.h
 
     bool is_scanning; ///< Whether the node is scanning for gateways
     uint32_t scan_started_ts; ///< Timestamp of the start of the scan
     uint32_t scan_expected_end_ts; ///< Timestamp of the expected end of the scan
     uint32_t current_scan_item_ts; ///< Timestamp of the current scan item
+    uint64_t scan_asn; ///< Asn of the beacon slot the scan listens for, which gives the scan channel
 
     bool is_bg_scanning; ///< Whether the node is scanning for gateways in the background
     bool bg_scan_sleep_next_slot; ///< Whether the next slot is a sleep slot
 
     uint64_t synced_gateway; ///< ID of the gateway the node is synchronized with
     uint32_t synced_ts; ///< Timestamp of the last synchronization
+
+    uint8_t max_packet_len; ///< Largest frame of the network, which slot_durations are computed for
+    bl_slot_durations_t beacon_durations; ///< Beacon slots, sized for a beacon and its bloom filter
+    bl_slot_durations_t shared_uplink_durations; ///< Shared uplink slots, sized for a join request
 } mac_vars_t;
 
 //=========================== variables ========================================
@@ -99,11 +116,11 @@ mac_vars_t mac_vars = { 0 };
 
 bl_slot_durations_t slot_durations = {
     .tx_offset = BLINK_TS_TX_OFFSET,
-    .tx_max = BLINK_PACKET_TOA_WITH_PADDING,
+    .tx_max = BLINK_PACKET_TOA_WITH_PADDING(BLINK_NETWORK_MAX_PACKET_LEN),
 
     .rx_guard = BLINK_RX_GUARD_TIME,
     .rx_offset = BLINK_TS_TX_OFFSET - BLINK_RX_GUARD_TIME,
-    .rx_max = BLINK_RX_GUARD_TIME + BLINK_PACKET_TOA_WITH_PADDING, // same as rx_guard + tx_max
+    .rx_max = BLINK_RX_GUARD_TIME + BLINK_PACKET_TOA_WITH_PADDING(BLINK_NETWORK_MAX_PACKET_LEN) + BLINK_END_GUARD_TIME / 2, // see bl_mac_compute_slot_durations
 
     .end_guard = BLINK_END_GUARD_TIME,
 
@@ -113,8 +130,12 @@ bl_slot_durations_t slot_durations = {
 //=========================== prototypes =======================================
 
 static inline void set_slot_state(bl_mac_state_t state);
+static void update_energy_state(void);
 
 static void new_slot_synced(void);
+static void schedule_next_slot(uint32_t duration);
+static uint32_t slot_duration(uint64_t asn);
+static void set_max_packet_len(uint8_t max_packet_len);
 static void end_slot(void);
 static void node_back_to_scanning(void);
 static void disable_radio_and_intra_slot_timers(void);
@@ -137,6 +158,8 @@ static void start_scan(void);
 static void end_scan(void);
 static void activity_scan_start_frame(uint32_t ts);
 static void activity_scan_end_frame(uint32_t ts);
+static void activity_scan_rx(void);
+static void activity_scan_frame_lost(void);
 static bool select_gateway_and_sync(void);
 
 static void start_background_scan(void);
@@ -157,9 +180,13 @@ void bl_mac_init(bl_node_type_t node_type, bl_event_cb_t event_callback) {
 
     // initialize the high frequency timer
     bl_timer_hf_init(BLINK_TIMER_DEV);
+    bl_energy_init();
 
-    // initialize the radio
+    // initialize the radio, which receives straight into a buffer of the pool
     bl_radio_init(&isr_mac_radio_start_frame, &isr_mac_radio_end_frame, BL_RADIO_BLE_2MBit);
+    bl_pool_init();
+    mac_vars.rx_pdu = bl_pool_alloc();
+    bl_radio_set_rx_pdu(mac_vars.rx_pdu);
 
     // node stuff
     mac_vars.node_type = node_type;
@@ -168,6 +195,16 @@ void bl_mac_init(bl_node_type_t node_type, bl_event_cb_t event_callback) {
     // synchronization stuff
     mac_vars.asn = 0;
 
+    // slots are sized for the largest frame of the network: the gateway picks it, nodes take it from its beacon when synchronizing
+    if (mac_vars.max_packet_len == 0) {
+        mac_vars.max_packet_len = BLINK_NETWORK_MAX_PACKET_LEN;
+    }
+    if (node_type == BLINK_GATEWAY) {
+        mac_vars.max_packet_len = bl_mac_gateway_max_packet_len(mac_vars.max_packet_len);
+    }
+    set_max_packet_len(mac_vars.max_packet_len);
+    mac_vars.current_durations = &slot_durations;
+
     // application callback
     mac_vars.blink_event_callback = event_callback;
 
@@ -176,22 +213,79 @@ void bl_mac_init(bl_node_type_t node_type, bl_event_cb_t event_callback) {
 
     if (mac_vars.node_type == BLINK_GATEWAY) {
         mac_vars.start_slot_ts = bl_timer_hf_now(BLINK_TIMER_DEV);
+        mac_vars.slot_ref_ts = mac_vars.start_slot_ts;
         bl_assoc_set_state(JOIN_STATE_JOINED);
-        bl_timer_hf_set_periodic_us(
-            BLINK_TIMER_DEV,
-            BLINK_TIMER_INTER_SLOT_CHANNEL,
-            slot_durations.whole_slot,
-            &new_slot_synced
-        );
+        schedule_next_slot(slot_durations.whole_slot);
     } else {
         start_scan();
     }
 }
 
+void bl_mac_set_max_packet_len(uint8_t max_packet_len) {
+    set_max_packet_len(max_packet_len);
+}
+
+uint8_t bl_mac_get_max_packet_len(void) {
+    return mac_vars.max_packet_len;
+}
+
+uint8_t bl_mac_gateway_max_packet_len(uint8_t max_packet_len) {
+    // beacon slots are sized on their own, only the control frames sent in data slots must fit
+    return max_packet_len < BLINK_CONTROL_PACKET_MAX_LEN ? BLINK_CONTROL_PACKET_MAX_LEN : max_packet_len;
+}
+
+void bl_mac_compute_slot_durations(bl_slot_durations_t *durations, uint8_t max_packet_len) {
+    uint32_t toa = BLINK_PACKET_TOA_WITH_PADDING(max_packet_len);
+    *durations = (bl_slot_durations_t){
+        .tx_offset = BLINK_TS_TX_OFFSET,
+        .tx_max = toa,
+
+        .rx_guard = BLINK_RX_GUARD_TIME,
+        .rx_offset = BLINK_TS_TX_OFFSET - BLINK_RX_GUARD_TIME,
+        .rx_max = BLINK_RX_GUARD_TIME + toa + BLINK_END_GUARD_TIME / 2, // a frame of the maximum length still fits when the node runs a bit early
+
+        .end_guard = BLINK_END_GUARD_TIME,
+
+        .whole_slot = BLINK_TS_TX_OFFSET + toa + BLINK_END_GUARD_TIME,
+    };
+}
+
+_Static_assert(BLINK_BEACON_MAX_HEADER_LEN + BLINK_BLOOM_M_BYTES_MAX <= BLINK_PACKET_MAX_SIZE, "a beacon with its bloom filter must fit in a frame, reduce BLINK_BLOOM_M_BITS");
+
+uint8_t bl_mac_slot_max_packet_len(slot_type_t type, uint8_t max_packet_len) {
+    size_t len;
+    switch (type) {
+        case SLOT_TYPE_BEACON:
+            return BLINK_BEACON_MAX_HEADER_LEN + BLINK_BLOOM_M_BYTES; // whatever the data frames, see the assert above
+        case SLOT_TYPE_SHARED_UPLINK:
+            len = sizeof(bl_packet_header_t); // join request
+            break;
+        default:
+            len = max_packet_len;
+            break;
+    }
+    return len < max_packet_len ? len : max_packet_len;
+}
+
+const bl_slot_durations_t *bl_mac_get_slot_durations(slot_type_t type) {
+    switch (type) {
+        case SLOT_TYPE_BEACON:
+            return &mac_vars.beacon_durations;
+        case SLOT_TYPE_SHARED_UPLINK:
+            return &mac_vars.shared_uplink_durations;
+        default:
+            return &slot_durations;
+    }
+}
+
 uint64_t bl_mac_get_asn(void) {
     return mac_vars.asn;
 }
 
+uint8_t bl_mac_get_channel(void) {
+    return mac_vars.current_slot_info.channel;
+}
+
 uint64_t bl_mac_get_synced_ts(void) {
     return mac_vars.synced_ts;
 }
@@ -208,6 +302,8 @@ inline bool bl_mac_node_is_synced(void) {
 
 static void set_slot_state(bl_mac_state_t state) {
     mac_vars.state = state;
+    TRACE(BL_TRACE_STATE, 0);
+    update_energy_state();
 
     switch (state) {
         case STATE_RX_DATA_LISTEN:
@@ -225,6 +321,28 @@ static void set_slot_state(bl_mac_state_t state) {
     }
 }
 
+static void update_energy_state(void) {
+    bl_energy_state_t energy_state;
+    switch (mac_vars.state) {
+        case STATE_TX_DATA:
+            energy_state = BL_ENERGY_TX;
+            break;
+        case STATE_RX_DATA_LISTEN:
+            energy_state = BL_ENERGY_RX_LISTEN;
+            break;
+        case STATE_RX_DATA:
+            energy_state = BL_ENERGY_RX_DATA;
+            break;
+        default:
+            energy_state = BL_ENERGY_SLEEP;
+            break;
+    }
+    if (energy_state != BL_ENERGY_SLEEP && (mac_vars.is_scanning || mac_vars.is_bg_scanning)) {
+        energy_state = BL_ENERGY_SCAN;
+    }
+    bl_energy_enter(energy_state, bl_timer_hf_now(BLINK_TIMER_DEV));
+}
+
 // --------------------- start/end synced slots -----------
 
 static void new_slot_synced(void) {
@@ -235,6 +353,10 @@ static void new_slot_synced(void) {
     if (mac_vars.node_type == BLINK_GATEWAY) {
         // too long without receiving a packet from certain nodes? disconnect them
         bl_assoc_gateway_clear_old_nodes(mac_vars.asn);
+        // here rather than in the main loop, so that the uplink cells do not change under joins and grants
+        bl_scheduler_gateway_update_elastic_schedule(mac_vars.asn);
+        // and that the beacons and the slots never see a change of the data channels half written
+        bl_scheduler_gateway_update_channel_blacklist(mac_vars.asn);
     } else if (mac_vars.node_type == BLINK_NODE) {
         if (bl_assoc_node_should_leave(mac_vars.asn)) {
             // assoc module determined that the node should leave, so disconnect and back to scanning
@@ -257,6 +379,11 @@ static void new_slot_synced(void) {
     }
 
     mac_vars.current_slot_info = bl_scheduler_tick(mac_vars.asn++);
+    TRACE(BL_TRACE_NEW_SLOT, (mac_vars.current_slot_info.type << 8) | mac_vars.current_slot_info.channel);
+
+    // slots are as long as the largest frame of their cell type, so the next one is programmed from this one
+    mac_vars.current_durations = bl_mac_get_slot_durations(mac_vars.current_slot_info.type);
+    schedule_next_slot(mac_vars.current_durations->whole_slot);
 
     if (mac_vars.current_slot_info.radio_action == BLINK_RADIO_ACTION_TX) {
         activity_ti1();
@@ -273,6 +400,29 @@ static void new_slot_synced(void) {
     }
 }
 
+static void schedule_next_slot(uint32_t duration) {
+    uint32_t slot_start_ts = mac_vars.slot_ref_ts;
+    mac_vars.slot_ref_ts += duration;
+    bl_timer_hf_set_oneshot_with_ref_diff_us(
+        BLINK_TIMER_DEV,
+        BLINK_TIMER_INTER_SLOT_CHANNEL,
+        slot_start_ts,
+        duration,
+        &new_slot_synced
+    );
+}
+
+static uint32_t slot_duration(uint64_t asn) {
+    return bl_mac_get_slot_durations(bl_scheduler_node_peek_slot(asn).type)->whole_slot;
+}
+
+static void set_max_packet_len(uint8_t max_packet_len) {
+    mac_vars.max_packet_len = max_packet_len;
+    bl_mac_compute_slot_durations(&slot_durations, max_packet_len);
+    bl_mac_compute_slot_durations(&mac_vars.beacon_durations, bl_mac_slot_max_packet_len(SLOT_TYPE_BEACON, max_packet_len));
+    bl_mac_compute_slot_durations(&mac_vars.shared_uplink_durations, bl_mac_slot_max_packet_len(SLOT_TYPE_SHARED_UPLINK, max_packet_len));
+}
+
 static void node_back_to_scanning(void) {
     mac_vars.synced_gateway = 0;
     mac_vars.synced_ts = 0;
@@ -282,7 +432,7 @@ static void node_back_to_scanning(void) {
 }
 
 static void end_slot(void) {
-    if (!bl_mac_node_is_synced()) {
+    if (mac_vars.node_type == BLINK_NODE && !bl_mac_node_is_synced()) {
         // not synced, so we are not in a slot
         return;
     }
@@ -303,7 +453,9 @@ static void disable_radio_and_intra_slot_timers(void) {
 static void start_scan(void) {
     mac_vars.scan_started_ts = bl_timer_hf_now(BLINK_TIMER_DEV);
     mac_vars.scan_expected_end_ts = mac_vars.scan_started_ts + BLINK_SCAN_MAX_DURATION;
+    mac_vars.scan_asn++; // start on the next channel, in case the previous scan found nothing because of a jammed one
     DEBUG_GPIO_SET(&pin0); // debug: show that a new scan started
+    TRACE(BL_TRACE_SCAN_START, 0);
     mac_vars.is_scanning = true;
     bl_assoc_set_state(JOIN_STATE_SCANNING);
 
@@ -320,17 +472,13 @@ static void start_scan(void) {
 
     set_slot_state(STATE_RX_DATA_LISTEN);
     bl_radio_disable();
-#ifdef BLINK_FIXED_SCAN_CHANNEL
-    bl_radio_set_channel(BLINK_FIXED_SCAN_CHANNEL); // not doing channel hopping for now
-#else
-    puts("Channel hopping not implemented yet for scanning");
-#endif
-    bl_radio_rx();
+    activity_scan_rx();
 }
 
 static void end_scan(void) {
     mac_vars.is_scanning = false;
     DEBUG_GPIO_CLEAR(&pin0); // debug: show that the scan is over
+    TRACE(BL_TRACE_SCAN_END, 0);
     set_slot_state(STATE_SLEEP);
     disable_radio_and_intra_slot_timers();
 
@@ -346,10 +494,11 @@ static void end_scan(void) {
 // --------------------- start/end background scan --------
 
 static void start_background_scan(void) {
+    TRACE(BL_TRACE_BG_SCAN_START, mac_vars.is_bg_scanning);
     // 1. prepare timestamps and and arm timer
     if (!mac_vars.is_bg_scanning) {
         mac_vars.scan_started_ts = mac_vars.start_slot_ts; // reuse the slot start time as reference
-        mac_vars.scan_expected_end_ts = mac_vars.scan_started_ts + BLINK_BG_SCAN_DURATION;
+        mac_vars.scan_expected_end_ts = mac_vars.scan_started_ts + BLINK_BG_SCAN_DURATION(mac_vars.current_durations->whole_slot);
     }
 
     // end_scan will be called when the scan is over
@@ -357,7 +506,7 @@ static void start_background_scan(void) {
         BLINK_TIMER_DEV,
         BLINK_TIMER_CHANNEL_1, // remember that the inter-slot timer is already being used for the slot
         mac_vars.start_slot_ts, // in this case, we use the slot start time as reference because we are synced
-        BLINK_BG_SCAN_DURATION, // scan for some time during this slot
+        BLINK_BG_SCAN_DURATION(mac_vars.current_durations->whole_slot), // scan for some time during this slot
         &end_background_scan
     );
 
@@ -365,23 +514,21 @@ static void start_background_scan(void) {
     if (!mac_vars.is_bg_scanning) {
         set_slot_state(STATE_RX_DATA_LISTEN);
         bl_radio_disable();
-#ifdef BLINK_FIXED_SCAN_CHANNEL
-        bl_radio_set_channel(BLINK_FIXED_SCAN_CHANNEL); // not doing channel hopping for now
-#else
-        puts("Channel hopping not implemented yet for scanning");
-#endif
-        bl_radio_rx();
+        activity_scan_rx();
     }
     mac_vars.is_bg_scanning = true;
+    update_energy_state();
 }
 
 static void end_background_scan(void) {
-    cell_t next_slot = bl_scheduler_node_peek_slot(mac_vars.asn); // remember: the asn was already incremented at new_slot_synced
-    mac_vars.bg_scan_sleep_next_slot = next_slot.type == SLOT_TYPE_UPLINK && next_slot.assigned_node_id != bl_device_id();
+    TRACE(BL_TRACE_BG_SCAN_END, 0);
+    bl_slot_info_t next_slot = bl_scheduler_node_peek_slot(mac_vars.asn); // remember: the asn was already incremented at new_slot_synced
+    mac_vars.bg_scan_sleep_next_slot = next_slot.type == SLOT_TYPE_UPLINK && next_slot.radio_action == BLINK_RADIO_ACTION_SLEEP;
 
     if (!mac_vars.bg_scan_sleep_next_slot) {
         // if next slot is not sleep, stop the background scan and check if there is an alternative gateway to join
         mac_vars.is_bg_scanning = false;
+        mac_vars.scan_asn++; // the next background scan listens on the next channel
         set_slot_state(STATE_SLEEP);
         disable_radio_and_intra_slot_timers();
 
@@ -395,6 +542,7 @@ static void end_background_scan(void) {
 // --------------------- tx activities --------------------
 
 static void activity_ti1(void) {
+    TRACE(BL_TRACE_TI1, 0);
     // ti1: arm tx timers and prepare the radio for tx
     // called by: function new_slot_synced
     set_slot_state(STATE_TX_OFFSET);
@@ -403,7 +551,7 @@ static void activity_ti1(void) {
         BLINK_TIMER_DEV,
         BLINK_TIMER_CHANNEL_1,
         mac_vars.start_slot_ts,
-        slot_durations.tx_offset,
+        mac_vars.current_durations->tx_offset,
         &activity_ti2
     );
 
@@ -411,17 +559,17 @@ static void activity_ti1(void) {
         BLINK_TIMER_DEV,
         BLINK_TIMER_CHANNEL_2,
         mac_vars.start_slot_ts,
-        slot_durations.tx_offset + slot_durations.tx_max,
+        mac_vars.current_durations->tx_offset + mac_vars.current_durations->tx_max,
         &activity_tie1
     );
 
     // FIXME: check if there is a packet to send before arming the timers
-    uint8_t packet[BLINK_PACKET_MAX_SIZE];
-    uint8_t packet_len = bl_queue_next_packet(mac_vars.current_slot_info.type, packet);
-    if (packet_len > 0) {
+    // the radio sends the frame straight from the queue, which keeps it until ti3
+    const bl_radio_pdu_t *pdu = bl_queue_next_pdu(mac_vars.current_slot_info.type);
+    if (pdu != NULL) {
         bl_radio_disable();
         bl_radio_set_channel(mac_vars.current_slot_info.channel);
-        bl_radio_tx_prepare(packet, packet_len);
+        bl_radio_tx_prepare_pdu(pdu);
     } else {
         // nothing to tx
         set_slot_state(STATE_SLEEP);
@@ -430,6 +578,7 @@ static void activity_ti1(void) {
 }
 
 static void activity_ti2(void) {
+    TRACE(BL_TRACE_TI2, 0);
     // ti2: tx actually begins
     // called by: timer isr
     set_slot_state(STATE_TX_DATA);
@@ -439,20 +588,25 @@ static void activity_ti2(void) {
 }
 
 static void activity_tie1(void) {
+    TRACE(BL_TRACE_TIE1, 0);
     // tte1: something went wrong, stayed in tx for too long, abort
     // called by: timer isr
     set_slot_state(STATE_SLEEP);
+    BL_STATS_INC(tie1);
 
     end_slot();
 }
 
 static void activity_ti3(void) {
+    TRACE(BL_TRACE_TI3, 0);
     // ti3: all fine, finished tx, cancel error timers and go to sleep
     // called by: radio isr
     set_slot_state(STATE_SLEEP);
 
     // cancel tte1 timer
     bl_timer_hf_cancel(BLINK_TIMER_DEV, BLINK_TIMER_CHANNEL_2);
+    BL_STATS_INC(tx[bl_stats_slot(mac_vars.current_slot_info.type)]);
+    bl_queue_tx_done();
 
     end_slot();
 }
@@ -462,6 +616,7 @@ static void activity_ti3(void) {
 // just write the placeholders for ri1
 
 static void activity_ri1(void) {
+    TRACE(BL_TRACE_RI1, 0);
     // ri1: arm rx timers and prepare the radio for rx
     // called by: function new_slot_synced
     set_slot_state(STATE_RX_OFFSET);
@@ -470,7 +625,7 @@ static void activity_ri1(void) {
         BLINK_TIMER_DEV,
         BLINK_TIMER_CHANNEL_1,
         mac_vars.start_slot_ts,
-        slot_durations.rx_offset,
+        mac_vars.current_durations->rx_offset,
         &activity_ri2
     );
 
@@ -478,7 +633,7 @@ static void activity_ri1(void) {
         BLINK_TIMER_DEV,
         BLINK_TIMER_CHANNEL_2,
         mac_vars.start_slot_ts,
-        slot_durations.tx_offset + slot_durations.rx_guard,
+        mac_vars.current_durations->tx_offset + mac_vars.current_durations->rx_guard,
         &activity_rie1
     );
 
@@ -486,12 +641,13 @@ static void activity_ri1(void) {
         BLINK_TIMER_DEV,
         BLINK_TIMER_CHANNEL_3,
         mac_vars.start_slot_ts,
-        slot_durations.rx_offset + slot_durations.rx_max,
+        mac_vars.current_durations->rx_offset + mac_vars.current_durations->rx_max,
         &activity_rie2
     );
 }
 
 static void activity_ri2(void) {
+    TRACE(BL_TRACE_RI2, 0);
     // ri2: rx actually begins
     // called by: timer isr
     set_slot_state(STATE_RX_DATA_LISTEN);
@@ -502,6 +658,7 @@ static void activity_ri2(void) {
 }
 
 static void activity_ri3(uint32_t ts) {
+    TRACE(BL_TRACE_RI3, 0);
     // ri3: a packet started to arrive
     // called by: radio isr
     set_slot_state(STATE_RX_DATA);
@@ -513,6 +670,7 @@ static void activity_ri3(uint32_t ts) {
 }
 
 static void activity_rie1(void) {
+    TRACE(BL_TRACE_RIE1, 0);
     // rie1: didn't receive start of packet before rx_guard, abort
     // called by: timer isr
     set_slot_state(STATE_SLEEP);
@@ -520,10 +678,17 @@ static void activity_rie1(void) {
     // cancel timer for rx_max (rie2)
     bl_timer_hf_cancel(BLINK_TIMER_DEV, BLINK_TIMER_CHANNEL_3);
 
+    BL_STATS_INC(rie1);
+    if (mac_vars.node_type == BLINK_GATEWAY && mac_vars.current_slot_info.type == SLOT_TYPE_UPLINK) {
+        bl_stats_gateway_node_missed(mac_vars.current_slot_info.uplink_position, false);
+        bl_scheduler_gateway_channel_outcome(mac_vars.current_slot_info.uplink_position, mac_vars.current_slot_info.channel, false);
+    }
+
     end_slot();
 }
 
 static void activity_ri4(uint32_t ts) {
+    TRACE(BL_TRACE_RI4, 0);
     // ri4: all fine, finished rx, cancel error timers and go to sleep
     // called by: radio isr
     set_slot_state(STATE_SLEEP);
@@ -537,7 +702,10 @@ static void activity_ri4(uint32_t ts) {
         return;
     }
 
-    bl_radio_get_rx_packet(mac_vars.received_packet.packet, &mac_vars.received_packet.packet_len);
+    // read in place, the radio received into the buffer of the pool
+    bl_radio_pdu_t *pdu = bl_radio_get_rx_pdu();
+    mac_vars.received_packet.packet = pdu->payload;
+    mac_vars.received_packet.packet_len = pdu->length;
 
     bl_packet_header_t *header = (bl_packet_header_t *)mac_vars.received_packet.packet;
 
@@ -559,29 +727,51 @@ static void activity_ri4(uint32_t ts) {
     mac_vars.received_packet.end_ts = ts;
     mac_vars.received_packet.asn = mac_vars.asn;
 
+    BL_STATS_INC(rx[bl_stats_slot(mac_vars.current_slot_info.type)]);
+    if (mac_vars.node_type == BLINK_GATEWAY && mac_vars.current_slot_info.type == SLOT_TYPE_UPLINK) {
+        bl_stats_gateway_node_rx(mac_vars.current_slot_info.uplink_position, header->src, mac_vars.received_packet.rssi);
+        bl_scheduler_gateway_channel_outcome(mac_vars.current_slot_info.uplink_position, mac_vars.current_slot_info.channel, true);
+    }
+
     bl_handle_packet(mac_vars.received_packet.packet, mac_vars.received_packet.packet_len);
+    if (bl_pool_is_shared(mac_vars.rx_pdu)) {
+        // the application held the packet, receive the next ones into another buffer (bl_pool_hold left one free)
+        bl_pool_release(mac_vars.rx_pdu);
+        mac_vars.rx_pdu = bl_pool_alloc();
+        bl_radio_set_rx_pdu(mac_vars.rx_pdu);
+    }
 
     end_slot();
 }
 
 static void activity_rie2(void) {
+    TRACE(BL_TRACE_RIE2, 0);
     // rie2: something went wrong, stayed in rx for too long, abort
     // called by: timer isr
     set_slot_state(STATE_SLEEP);
 
+    BL_STATS_INC(rie2);
+    if (mac_vars.node_type == BLINK_GATEWAY && mac_vars.current_slot_info.type == SLOT_TYPE_UPLINK) {
+        bl_stats_gateway_node_missed(mac_vars.current_slot_info.uplink_position, true);
+        bl_scheduler_gateway_channel_outcome(mac_vars.current_slot_info.uplink_position, mac_vars.current_slot_info.channel, false);
+    }
+
     end_slot();
 }
 
 static void fix_drift(uint32_t ts) {
     uint32_t time_cpu_periph = 78; // got this value by looking at the logic analyzer
 
-    uint32_t expected_ts = mac_vars.start_slot_ts + slot_durations.tx_offset + time_cpu_periph;
+    uint32_t expected_ts = mac_vars.start_slot_ts + mac_vars.current_durations->tx_offset + time_cpu_periph;
     int32_t clock_drift = ts - expected_ts;
     uint32_t abs_clock_drift = abs(clock_drift);
+    TRACE(BL_TRACE_FIX_DRIFT, (uint16_t)(int16_t)clock_drift);
 
     if (abs_clock_drift < 100) {
         // drift is acceptable
         // adjust the slot reference
+        BL_STATS_INC(drift_fixes);
+        mac_vars.slot_ref_ts += clock_drift;
         bl_timer_hf_adjust_periodic_us(
             BLINK_TIMER_DEV,
             BLINK_TIMER_INTER_SLOT_CHANNEL,
@@ -589,6 +779,8 @@ static void fix_drift(uint32_t ts) {
         );
     } else {
         // drift is too high, need to re-sync
+        TRACE(BL_TRACE_DESYNC, 0);
+        BL_STATS_INC(out_of_sync);
         bl_event_data_t event_data = { .data.gateway_info.gateway_id = mac_vars.synced_gateway, .tag = BLINK_OUT_OF_SYNC };
         mac_vars.blink_event_callback(BLINK_DISCONNECTED, event_data);
         bl_assoc_set_state(JOIN_STATE_IDLE);
@@ -601,12 +793,10 @@ static void fix_drift(uint32_t ts) {
 // --------------------- scan activities ------------------
 
 static void activity_scan_dispatch_new_schedule(void) {
-    bl_timer_hf_set_periodic_us(
-        BLINK_TIMER_DEV,
-        BLINK_TIMER_INTER_SLOT_CHANNEL,
-        slot_durations.whole_slot,
-        &new_slot_synced
-    );
+    TRACE(BL_TRACE_DISPATCH_SCHEDULE, 0);
+    // this is the start of the slot before mac_vars.asn, which is not used
+    mac_vars.slot_ref_ts = bl_timer_hf_now(BLINK_TIMER_DEV);
+    schedule_next_slot(slot_duration(mac_vars.asn - 1));
 }
 
 static bool select_gateway_and_sync(void) {
@@ -636,10 +826,26 @@ static bool select_gateway_and_sync(void) {
         is_handover = true;
     }
 
-    if (!bl_scheduler_set_schedule(selected_gateway.beacon.active_schedule_id)) {
+    // check the beacon before changing anything, a node keeps its current gateway otherwise
+    if (!bl_scheduler_is_schedule_available(selected_gateway.beacon.active_schedule_id, &selected_gateway.beacon.schedule)) {
         // schedule not found, a new scan will begin again via new_scan
         return false;
     }
+    if (bl_mac_gateway_max_packet_len(selected_gateway.beacon.max_packet_len) != selected_gateway.beacon.max_packet_len) {
+        // the control frames of this gateway would not fit in its slots
+        return false;
+    }
+
+    if (selected_gateway.beacon.active_schedule_id == BLINK_SCHEDULE_ID_GENERATED) {
+        bl_scheduler_set_generated_schedule(&selected_gateway.beacon.schedule);
+    } else {
+        bl_scheduler_set_schedule(selected_gateway.beacon.active_schedule_id);
+    }
+    bl_scheduler_node_set_next_schedule(selected_gateway.beacon.next_schedule_id, selected_gateway.beacon.switch_asn);
+    uint64_t blacklist, next_blacklist, channel_switch_asn;
+    bl_packet_beacon_get_channel_blacklist(&selected_gateway.beacon, &selected_gateway.channel_switch, &blacklist, &next_blacklist, &channel_switch_asn);
+    bl_scheduler_node_set_channel_blacklist(blacklist, next_blacklist, channel_switch_asn);
+    set_max_packet_len(selected_gateway.beacon.max_packet_len);
 
     if (is_handover) {
         DEBUG_GPIO_SET(&pin3); DEBUG_GPIO_CLEAR(&pin3); // pin3 DEBUG
@@ -648,7 +854,7 @@ static bool select_gateway_and_sync(void) {
         mac_vars.blink_event_callback(BLINK_DISCONNECTED, event_data);
         // NOTE: should we `bl_assoc_set_state(JOIN_STATE_IDLE);` here?
         // during handover, we don't want the inter slot timer to tick again before we finish sync, so just set if far away in the future
-        bl_timer_hf_set_periodic_us(
+        bl_timer_hf_set_oneshot_us(
             BLINK_TIMER_DEV,
             BLINK_TIMER_INTER_SLOT_CHANNEL,
             slot_durations.whole_slot << 4, // 16 slots in the future
@@ -658,52 +864,73 @@ static bool select_gateway_and_sync(void) {
 
     mac_vars.synced_gateway = selected_gateway.beacon.src;
     mac_vars.synced_ts = now_ts;
-
-    // the selected gateway may have been scanned a few slot_durations ago, so we need to account for that difference
-    // NOTE: this assumes that the slot duration is the same for gateways and nodes
-    uint32_t time_since_beacon = now_ts - selected_gateway.timestamp;
-    uint64_t asn_count_since_beacon = (time_since_beacon / slot_durations.whole_slot) + 1; // +1 because we are inside the current slot
-    uint64_t time_into_gateway_slot = time_since_beacon % slot_durations.whole_slot;
-
-    uint64_t time_to_skip_one_slot = 0;
-    if (time_into_gateway_slot > slot_durations.whole_slot / 2) {
-        // too close to the next slot, skip this one
-        asn_count_since_beacon++;
-        time_to_skip_one_slot = slot_durations.whole_slot;
-    }
+    bl_assoc_node_set_gateway_capacity(selected_gateway.beacon.remaining_capacity);
+    TRACE(BL_TRACE_SYNC, is_handover);
 
     uint64_t time_cpu_and_toa = 445; // magic number: measured using the logic analyzer
     if (is_handover) {
         time_cpu_and_toa += 116; // magic number: measured using the logic analyzer (why??)
     }
 
-    uint32_t time_dispatch_new_schedule = ((slot_durations.whole_slot - time_into_gateway_slot) + time_to_skip_one_slot) - time_cpu_and_toa;
+    // the selected gateway may have been scanned a few slots ago, so we need to account for that difference
+    // NOTE: this assumes that the slot durations are the same for gateways and nodes
+    // slots do not all have the same duration, so walk them from the one of the beacon, which started time_cpu_and_toa before it
+    uint32_t time_since_beacon_slot = now_ts - selected_gateway.timestamp + time_cpu_and_toa;
+    uint64_t asn = selected_gateway.beacon.asn - 1; // the beacon carries the asn that follows its own slot
+    uint32_t time_slot_end = slot_duration(asn);
+    while (time_slot_end <= time_since_beacon_slot) {
+        time_slot_end += slot_duration(++asn);
+    }
+    if (time_slot_end - time_since_beacon_slot < slot_duration(asn) / 2) {
+        // too close to the next slot, skip this one
+        time_slot_end += slot_duration(++asn);
+    }
+
     bl_timer_hf_set_oneshot_us(
         BLINK_TIMER_DEV,
         BLINK_TIMER_CHANNEL_1,
-        time_dispatch_new_schedule,
+        time_slot_end - time_since_beacon_slot,
         &activity_scan_dispatch_new_schedule
     );
 
-    // set the asn to match the gateway's
-    mac_vars.asn = selected_gateway.beacon.asn + asn_count_since_beacon;
+    // set the asn to match the gateway's: the dispatch happens at the start of slot asn + 1, and the first synced slot is the next one
+    mac_vars.asn = asn + 2;
 
     return true;
 }
 
 static void activity_scan_start_frame(uint32_t ts) {
+    TRACE(BL_TRACE_SCAN_START_FRAME, 0);
     set_slot_state(STATE_RX_DATA);
     mac_vars.current_scan_item_ts = ts;
 
-    // NOTE: should probably set an error timer here, in case the end event doesn't happen
+    if (mac_vars.is_scanning) {
+        // the end event doesn't happen if the CRC is invalid, and the radio stays off
+        bl_timer_hf_set_oneshot_with_ref_us(
+            BLINK_TIMER_DEV,
+            BLINK_TIMER_CHANNEL_3,
+            ts,
+            mac_vars.beacon_durations.tx_max, // only beacons are sent in beacon slots
+            &activity_scan_frame_lost
+        );
+    }
 }
 
 static void activity_scan_end_frame(uint32_t end_frame_ts) {
-    uint8_t packet[BLINK_PACKET_MAX_SIZE];
-    uint8_t packet_len;
-    bl_radio_get_rx_packet(packet, &packet_len);
+    // read in place, the radio is only enabled again once the beacon is handled
+    bl_radio_pdu_t *pdu = bl_radio_get_rx_pdu();
+    uint8_t *packet = pdu->payload;
+    uint8_t packet_len = pdu->length;
+    TRACE(BL_TRACE_SCAN_END_FRAME, packet_len);
+    if (mac_vars.is_scanning) {
+        bl_timer_hf_cancel(BLINK_TIMER_DEV, BLINK_TIMER_CHANNEL_3);
+    }
 
-    bl_assoc_handle_beacon(packet, packet_len, BLINK_FIXED_SCAN_CHANNEL, mac_vars.current_scan_item_ts);
+    bl_assoc_handle_beacon(packet, packet_len, bl_scheduler_get_channel(SLOT_TYPE_BEACON, mac_vars.scan_asn, 0), mac_vars.current_scan_item_ts);
+    if (packet_len >= sizeof(bl_beacon_packet_header_t) && packet[1] == BLINK_PACKET_BEACON) {
+        // hop in step with the gateway: the beacon carries the asn of the next slot, which may be a beacon slot too
+        mac_vars.scan_asn = ((bl_beacon_packet_header_t *)packet)->asn;
+    }
 
     // if there is still enough time before end of scan, re-enable the radio
     bool still_time_for_rx_scan = mac_vars.is_scanning && (end_frame_ts + BLINK_BEACON_TOA_WITH_PADDING < mac_vars.scan_expected_end_ts);
@@ -718,13 +945,27 @@ static void activity_scan_end_frame(uint32_t end_frame_ts) {
             BLINK_TIMER_CHANNEL_2,
             end_frame_ts,
             20, // arbitrary value, just to give some time for the radio to turn off
-            &bl_radio_rx
+            &activity_scan_rx
         );
     } else {
         set_slot_state(STATE_SLEEP);
     }
 }
 
+static void activity_scan_rx(void) {
+    bl_radio_set_channel(bl_scheduler_get_channel(SLOT_TYPE_BEACON, mac_vars.scan_asn, 0));
+    bl_radio_rx();
+}
+
+static void activity_scan_frame_lost(void) {
+    // corrupted frame, this channel may be jammed: listen on the next one, instead of staying off until the end of the scan
+    TRACE(BL_TRACE_SCAN_END_FRAME, 0);
+    mac_vars.scan_asn++;
+    set_slot_state(STATE_RX_DATA_LISTEN);
+    bl_radio_disable();
+    activity_scan_rx();
+}
+
 // --------------------- tx/rx activities ------------
 
 // --------------------- radio ---------------------
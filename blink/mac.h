@@ -36,14 +36,20 @@
 #define BLINK_TS_TX_OFFSET (300) // time for radio setup before TX
 #define BLINK_RX_GUARD_TIME (150) // time range relative to BLINK_TS_TX_OFFSET for the receiver to start RXing
 #define BLINK_END_GUARD_TIME BLINK_RX_GUARD_TIME
-#define BLINK_PACKET_TOA (BLE_2M_US_PER_BYTE * BLINK_BLE_PAYLOAD_MAX_LENGTH) // Time on air for the maximum payload.
-#define BLINK_PACKET_TOA_WITH_PADDING (BLINK_PACKET_TOA + 50) // Add padding based on experiments. Also, it takes 28 us until event ADDRESS is triggered (when the packet actually starts traveling over the air)
+#define BLINK_PACKET_OVERHEAD_BYTES (2 + 3) // S0 + LENGTH before the payload, CRC after it
+#define BLINK_PACKET_TOA(len) (BLE_2M_US_PER_BYTE * ((len) + BLINK_PACKET_OVERHEAD_BYTES)) // Time on air of a frame, from the ADDRESS event to its end
+#define BLINK_PACKET_TOA_PADDING (78 + 20) // it takes 78 us from TASKS_START until event ADDRESS is triggered (see time_cpu_periph in fix_drift), plus some margin
+#define BLINK_PACKET_TOA_WITH_PADDING(len) (BLINK_PACKET_TOA(len) + BLINK_PACKET_TOA_PADDING)
+
+#ifndef BLINK_NETWORK_MAX_PACKET_LEN
+#define BLINK_NETWORK_MAX_PACKET_LEN (238) // largest frame a gateway lets its network send, advertised in the beacon. The default fits in the historical 1520 us slots
+#endif
 
 // Duration of some packets
 #define BLINK_BEACON_TOA (BLE_2M_US_PER_BYTE * sizeof(bl_beacon_packet_header_t)) // Time on air for the beacon packet
 #define BLINK_BEACON_TOA_WITH_PADDING (BLINK_BEACON_TOA + 60) // Add padding based on experiments.
 
-#define BLINK_WHOLE_SLOT_DURATION (BLINK_TS_TX_OFFSET + BLINK_PACKET_TOA_WITH_PADDING + BLINK_END_GUARD_TIME) // Complete slot duration
+#define BLINK_WHOLE_SLOT_DURATION (BLINK_TS_TX_OFFSET + BLINK_PACKET_TOA_WITH_PADDING(BLINK_NETWORK_MAX_PACKET_LEN) + BLINK_END_GUARD_TIME) // Complete slot duration, for the largest frames. The actual ones are in slot_durations and bl_mac_get_slot_durations
 
 #define BLINK_MAX_TIME_NO_RX_DESYNC (BLINK_WHOLE_SLOT_DURATION * BLINK_SCAN_MAX_SLOTS) // us, arbitrary value for now
 
@@ -51,9 +57,11 @@
 #define BLINK_SCAN_MAX_SLOTS (BLINK_N_CELLS_MAX) // how many slots to scan for. should probably be the size of the largest schedule
 #define BLINK_SCAN_MAX_DURATION (BLINK_SCAN_MAX_SLOTS * BLINK_WHOLE_SLOT_DURATION) // how many slots to scan for. should probably be the size of the largest schedule
 
-#define BLINK_BG_SCAN_DURATION (BLINK_WHOLE_SLOT_DURATION - (BLINK_END_GUARD_TIME*2))
+#define BLINK_BG_SCAN_DURATION(whole_slot) ((whole_slot) - (BLINK_END_GUARD_TIME*2))
 
+#ifndef BLINK_MAX_SLOTFRAMES_NO_RX_LEAVE
 #define BLINK_MAX_SLOTFRAMES_NO_RX_LEAVE (5) // how many slotframes to wait before leaving the network if nothing is received
+#endif
 
 /* Duration of intra-slot sections */
 typedef struct {
@@ -73,7 +81,7 @@ typedef struct {
 
 //=========================== variables ========================================
 
-extern bl_slot_durations_t slot_durations;
+extern bl_slot_durations_t slot_durations; ///< Uplink and downlink slots, the longest ones
 
 //=========================== prototypes ==========================================
 
@@ -81,6 +89,51 @@ void bl_mac_init(bl_node_type_t node_type, bl_event_cb_t event_callback);
 uint64_t bl_mac_get_synced_ts(void);
 uint64_t bl_mac_get_synced_gateway(void);
 uint64_t bl_mac_get_asn(void);
+uint8_t bl_mac_get_channel(void); // channel of the current slot
 bool bl_mac_node_is_synced(void);
 
+/**
+ * @brief Sets the largest frame of the network of a gateway, to be called before bl_mac_init
+ *
+ * Nodes take it from the beacon of their gateway instead, when synchronizing.
+ */
+void bl_mac_set_max_packet_len(uint8_t max_packet_len);
+uint8_t bl_mac_get_max_packet_len(void);
+
+/**
+ * @brief Largest frame of the network of a gateway, at least large enough for its control frames
+ *
+ * Beacon slots do not depend on it, so a network of short frames gets short data slots.
+ *
+ * @param[in] max_packet_len    largest frame wanted by the application
+ */
+uint8_t bl_mac_gateway_max_packet_len(uint8_t max_packet_len);
+
+/**
+ * @brief Computes the durations of the slots of a network
+ *
+ * The gateway and its nodes compute them from the same maximum frame length, the one
+ * advertised in the beacon, so that their slots line up.
+ *
+ * @param[out] durations        intra-slot durations, in us
+ * @param[in] max_packet_len    largest frame of the network, in bytes
+ */
+void bl_mac_compute_slot_durations(bl_slot_durations_t *durations, uint8_t max_packet_len);
+
+/**
+ * @brief Largest frame sent in the slots of a cell type
+ *
+ * Beacon slots only carry a beacon and its bloom filter, whatever the largest frame of the
+ * network, and shared uplink slots a join request.
+ *
+ * @param[in] type              type of the cell
+ * @param[in] max_packet_len    largest frame of the network, in bytes
+ */
+uint8_t bl_mac_slot_max_packet_len(slot_type_t type, uint8_t max_packet_len);
+
+/**
+ * @brief Durations of the slots of a cell type, in the current network
+ */
+const bl_slot_durations_t *bl_mac_get_slot_durations(slot_type_t type);
+
 #endif // __MAC_H
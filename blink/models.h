@@ -27,11 +27,21 @@
 
 // #ifndef BLINK_FIXED_CHANNEL
 #define BLINK_FIXED_CHANNEL 0 // to hardcode the channel, use a valid value other than 0
-#define BLINK_FIXED_SCAN_CHANNEL 37 // to hardcode the channel, use a valid value other than 0
 // #endif
+#ifndef BLINK_FIXED_SCAN_CHANNEL
+#define BLINK_FIXED_SCAN_CHANNEL 0 // beacons hop over 37, 38 and 39 with the asn, and scans follow them. to hardcode the channel, use a valid value other than 0
+#endif
 
 #define BLINK_N_CELLS_MAX 137
 
+#ifndef BLINK_N_UPLINK_CELLS_MAX
+#define BLINK_N_UPLINK_CELLS_MAX 101 // uplink cells of the largest built-in schedule (schedule_huge), further uplink cells of a schedule are not assigned. Raise it, up to INT16_MAX, for larger generated schedules (see generator.h): a gateway needs 30 bytes per uplink cell
+#endif
+
+#ifndef BLINK_N_EXTRA_UPLINK_CELLS_MAX
+#define BLINK_N_EXTRA_UPLINK_CELLS_MAX 4 // uplink cells a node can get on top of its own one, with a bandwidth request
+#endif
+
 #define BLINK_ENABLE_BACKGROUND_SCAN 0
 
 #define BLINK_PACKET_MAX_SIZE 255
@@ -60,8 +70,14 @@ typedef enum {
     BLINK_GATEWAY_FULL = 4,
     BLINK_PEER_LOST_TIMEOUT = 5,
     BLINK_PEER_LOST_BLOOM = 6,
+    BLINK_SCHEDULE_SWITCH = 7,
 } bl_event_tag_t;
 
+typedef enum {
+    BLINK_PRIORITY_CONTROL, ///< Sent before any bulk packet, e.g. motion commands
+    BLINK_PRIORITY_BULK,    ///< e.g. telemetry
+} blink_priority_t;
+
 typedef struct {
     uint8_t len;
     bl_packet_header_t *header;
@@ -99,23 +115,24 @@ typedef struct {
     bl_radio_action_t radio_action;
     uint8_t channel;
     slot_type_t type;
+    uint16_t cell_index; ///< Index of the cell in the active schedule
+    uint16_t uplink_position; ///< Position of the cell among the uplink cells of the active schedule, only meaningful in uplink cells
 } bl_slot_info_t;
 
 typedef struct {
-    slot_type_t type;
+    uint8_t type; ///< A slot_type_t, on one byte so that schedules take 2 bytes per cell in flash
     uint8_t channel_offset;
-    uint64_t assigned_node_id;
-    uint64_t last_received_asn; ///< ASN marking the last time the node was heard from
 } cell_t;
 
 typedef struct {
     uint8_t id; // unique identifier for the schedule
-    uint8_t max_nodes; // maximum number of nodes that can be scheduled, equivalent to the number of uplink slot_durations
+    uint16_t max_nodes; // maximum number of nodes that can be scheduled, equivalent to the number of uplink slot_durations
     uint8_t backoff_n_min; // minimum exponent for the backoff algorithm
     uint8_t backoff_n_max; // maximum exponent for the backoff algorithm
     size_t n_cells; // number of cells in this schedule
-    cell_t cells[BLINK_N_CELLS_MAX]; // cells in this schedule. NOTE(FIXME?): the first 3 cells must be beacons
-} schedule_t;
+    cell_t cells[BLINK_N_CELLS_MAX]; // cells in this schedule, unused when id is BLINK_SCHEDULE_ID_GENERATED. NOTE(FIXME?): the first 3 cells must be beacons
+    bl_schedule_descriptor_t descriptor; // what the cells are generated from, when id is BLINK_SCHEDULE_ID_GENERATED, see generator.h
+} schedule_t; // immutable, the built-in schedules are const so that they stay in flash, see bl_uplink_cells_t for the assignments
 
 typedef struct {
     uint8_t channel;
@@ -124,7 +141,7 @@ typedef struct {
     uint32_t end_ts;
     uint64_t asn;
     bool to_me;
-    uint8_t packet[BLINK_PACKET_MAX_SIZE];
+    uint8_t *packet; // in the pool buffer the radio received it into, see pool.h
     uint8_t packet_len;
 } bl_received_packet_t;
 
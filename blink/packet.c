@@ -8,11 +8,14 @@
 #include <stdint.h>
 #include <string.h>
 #include "bl_device.h"
+#include "blink.h"
 #include "packet.h"
 
 //=========================== prototypes =======================================
 
 static size_t _set_header(uint8_t *buffer, uint64_t dst, bl_packet_type_t packet_type);
+static void _set_channel_mask(uint8_t *mask, uint64_t channels);
+static uint64_t _get_channel_mask(const uint8_t *mask);
 
 //=========================== public ===========================================
 
@@ -30,11 +33,83 @@ size_t bl_build_packet_join_request(uint8_t *buffer, uint64_t dst) {
     return _set_header(buffer, dst, BLINK_PACKET_JOIN_REQUEST);
 }
 
-size_t bl_build_packet_join_response(uint8_t *buffer, uint64_t dst) {
-    return _set_header(buffer, dst, BLINK_PACKET_JOIN_RESPONSE);
+size_t bl_build_packet_join_response(uint8_t *buffer, uint64_t dst, uint16_t cell_index) {
+    size_t header_len = _set_header(buffer, dst, BLINK_PACKET_JOIN_RESPONSE);
+    // the assigned cell follows the header, in the same byte order as the header fields
+    memcpy(buffer + header_len, &cell_index, sizeof(cell_index));
+    return header_len + sizeof(cell_index);
 }
 
-size_t bl_build_packet_beacon(uint8_t *buffer, uint64_t asn, uint8_t remaining_capacity, uint8_t active_schedule_id) {
+size_t bl_build_packet_cell_move(uint8_t *buffer, uint64_t dst, uint8_t schedule_id, uint16_t cell_index) {
+    size_t header_len = _set_header(buffer, dst, BLINK_PACKET_CELL_MOVE);
+    bl_cell_move_t cell_move = {
+        .schedule_id = schedule_id,
+        .cell_index = cell_index,
+    };
+    memcpy(buffer + header_len, &cell_move, sizeof(bl_cell_move_t));
+    return header_len + sizeof(bl_cell_move_t);
+}
+
+size_t bl_build_packet_bandwidth_request(uint8_t *buffer, uint64_t dst, uint8_t n_cells) {
+    size_t header_len = _set_header(buffer, dst, BLINK_PACKET_BANDWIDTH_REQUEST);
+    bl_bandwidth_request_t request = {
+        .n_cells = n_cells,
+    };
+    memcpy(buffer + header_len, &request, sizeof(bl_bandwidth_request_t));
+    return header_len + sizeof(bl_bandwidth_request_t);
+}
+
+size_t bl_build_packet_bandwidth_grant(uint8_t *buffer, uint64_t dst, uint8_t schedule_id, const uint16_t *cell_indexes, uint8_t n_cells) {
+    size_t header_len = _set_header(buffer, dst, BLINK_PACKET_BANDWIDTH_GRANT);
+    bl_bandwidth_grant_t grant = {
+        .schedule_id = schedule_id,
+        .n_cells = n_cells,
+    };
+    memcpy(buffer + header_len, &grant, sizeof(bl_bandwidth_grant_t));
+    memcpy(buffer + header_len + sizeof(bl_bandwidth_grant_t), cell_indexes, n_cells * sizeof(uint16_t));
+    return header_len + sizeof(bl_bandwidth_grant_t) + n_cells * sizeof(uint16_t);
+}
+
+size_t bl_build_packet_aggregated(uint8_t *buffer, uint8_t schedule_id) {
+    size_t header_len = _set_header(buffer, BLINK_BROADCAST_ADDRESS, BLINK_PACKET_DATA_AGGREGATED);
+    bl_aggregated_header_t aggregated = {
+        .schedule_id = schedule_id,
+    };
+    memcpy(buffer + header_len, &aggregated, sizeof(bl_aggregated_header_t));
+    return header_len + sizeof(bl_aggregated_header_t);
+}
+
+size_t bl_packet_aggregated_append(uint8_t *buffer, size_t len, uint16_t handle, uint64_t node_id, const uint8_t *data, uint8_t data_len) {
+    bl_aggregated_entry_t entry = {
+        .handle = handle,
+        .node_id_low = (uint16_t)node_id,
+        .len = data_len,
+    };
+    memcpy(buffer + len, &entry, sizeof(bl_aggregated_entry_t));
+    memcpy(buffer + len + sizeof(bl_aggregated_entry_t), data, data_len);
+    return len + sizeof(bl_aggregated_entry_t) + data_len;
+}
+
+size_t bl_packet_beacon_header_len(const uint8_t *packet) {
+    const bl_beacon_packet_header_t *beacon = (const bl_beacon_packet_header_t *)packet;
+    if (beacon->channel_blacklist[BLINK_CHANNEL_MASK_LEN - 1] & BLINK_BEACON_CHANNEL_SWITCH_PENDING) {
+        return sizeof(bl_beacon_packet_header_t) + sizeof(bl_beacon_channel_switch_t);
+    }
+    return sizeof(bl_beacon_packet_header_t);
+}
+
+void bl_packet_beacon_get_channel_blacklist(const bl_beacon_packet_header_t *beacon, const bl_beacon_channel_switch_t *channel_switch, uint64_t *blacklist, uint64_t *next_blacklist, uint64_t *switch_asn) {
+    *blacklist = _get_channel_mask(beacon->channel_blacklist);
+    if (channel_switch == NULL || !(beacon->channel_blacklist[BLINK_CHANNEL_MASK_LEN - 1] & BLINK_BEACON_CHANNEL_SWITCH_PENDING)) {
+        *next_blacklist = *blacklist;
+        *switch_asn = 0;
+        return;
+    }
+    *next_blacklist = _get_channel_mask(channel_switch->next_channel_blacklist);
+    *switch_asn = channel_switch->channel_switch_asn;
+}
+
+size_t bl_build_packet_beacon(uint8_t *buffer, uint64_t asn, uint16_t remaining_capacity, uint8_t active_schedule_id, const bl_schedule_descriptor_t *schedule, uint8_t next_schedule_id, uint64_t switch_asn, uint8_t max_packet_len, uint64_t channel_blacklist, uint64_t next_channel_blacklist, uint64_t channel_switch_asn) {
     bl_beacon_packet_header_t beacon = {
         .version = BLINK_PROTOCOL_VERSION,
         .type = BLINK_PACKET_BEACON,
@@ -42,9 +117,26 @@ size_t bl_build_packet_beacon(uint8_t *buffer, uint64_t asn, uint8_t remaining_c
         .src = bl_device_id(),
         .remaining_capacity = remaining_capacity,
         .active_schedule_id = active_schedule_id,
+        .schedule = *schedule,
+        .next_schedule_id = next_schedule_id,
+        .switch_asn = switch_asn,
+        .max_packet_len = max_packet_len,
     };
+    _set_channel_mask(beacon.channel_blacklist, channel_blacklist);
+    if (channel_switch_asn == 0) {
+        memcpy(buffer, &beacon, sizeof(bl_beacon_packet_header_t));
+        return sizeof(bl_beacon_packet_header_t);
+    }
+
+    // the next blacklist is only sent while it is pending
+    beacon.channel_blacklist[BLINK_CHANNEL_MASK_LEN - 1] |= BLINK_BEACON_CHANNEL_SWITCH_PENDING;
+    bl_beacon_channel_switch_t channel_switch = {
+        .channel_switch_asn = channel_switch_asn,
+    };
+    _set_channel_mask(channel_switch.next_channel_blacklist, next_channel_blacklist);
     memcpy(buffer, &beacon, sizeof(bl_beacon_packet_header_t));
-    return sizeof(bl_beacon_packet_header_t);
+    memcpy(buffer + sizeof(bl_beacon_packet_header_t), &channel_switch, sizeof(bl_beacon_channel_switch_t));
+    return sizeof(bl_beacon_packet_header_t) + sizeof(bl_beacon_channel_switch_t);
 }
 
 //=========================== private ==========================================
@@ -61,3 +153,18 @@ static size_t _set_header(uint8_t *buffer, uint64_t dst, bl_packet_type_t packet
     memcpy(buffer, &header, sizeof(bl_packet_header_t));
     return sizeof(bl_packet_header_t);
 }
+
+static void _set_channel_mask(uint8_t *mask, uint64_t channels) {
+    for (size_t i = 0; i < BLINK_CHANNEL_MASK_LEN; i++) {
+        mask[i] = (uint8_t)(channels >> (8 * i));
+    }
+    mask[BLINK_CHANNEL_MASK_LEN - 1] &= ~BLINK_BEACON_CHANNEL_SWITCH_PENDING;
+}
+
+static uint64_t _get_channel_mask(const uint8_t *mask) {
+    uint64_t channels = 0;
+    for (size_t i = 0; i < BLINK_CHANNEL_MASK_LEN; i++) {
+        channels |= (uint64_t)mask[i] << (8 * i);
+    }
+    return channels & ~((uint64_t)BLINK_BEACON_CHANNEL_SWITCH_PENDING << (8 * (BLINK_CHANNEL_MASK_LEN - 1)));
+}
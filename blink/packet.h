@@ -18,7 +18,10 @@
 
 //=========================== defines ==========================================
 
-#define BLINK_PROTOCOL_VERSION 1
+#define BLINK_PROTOCOL_VERSION 9
+
+#define BLINK_CHANNEL_MASK_LEN (5) // bytes of a set of data channels on air, bit i % 8 of byte i / 8 for channel i
+#define BLINK_BEACON_CHANNEL_SWITCH_PENDING (0x80) // set in the last byte of the blacklist of a beacon, above the channels, when a bl_beacon_channel_switch_t follows it
 
 //=========================== variables ========================================
 
@@ -28,6 +31,10 @@ typedef enum {
     BLINK_PACKET_JOIN_RESPONSE = 4,
     BLINK_PACKET_KEEPALIVE = 8,
     BLINK_PACKET_DATA = 16,
+    BLINK_PACKET_CELL_MOVE = 32,
+    BLINK_PACKET_BANDWIDTH_REQUEST = 64,
+    BLINK_PACKET_BANDWIDTH_GRANT = 128,
+    BLINK_PACKET_DATA_AGGREGATED = BLINK_PACKET_DATA | 1, // the types above use all the bits
 } bl_packet_type_t;
 
 // general packet header
@@ -38,26 +45,93 @@ typedef struct __attribute__((packed)) {
     uint64_t          src;
 } bl_packet_header_t;
 
+// number of cells of each type of a generated schedule, see generator.h
+typedef struct __attribute__((packed)) {
+    uint8_t           n_beacons;
+    uint8_t           n_shared_uplink;
+    uint8_t           n_downlink;
+    uint16_t          n_uplink;
+} bl_schedule_descriptor_t;
+
 // beacon packet
 typedef struct __attribute__((packed)) {
     uint8_t           version;
     bl_packet_type_t  type;
     uint64_t          asn;
     uint64_t          src;
-    uint8_t           remaining_capacity;
+    uint16_t          remaining_capacity;
     uint8_t           active_schedule_id;
+    bl_schedule_descriptor_t schedule; // only used when active_schedule_id is BLINK_SCHEDULE_ID_GENERATED, zeroed otherwise
+    uint8_t           next_schedule_id; // schedule used from switch_asn on, same as active_schedule_id when no switch is planned
+    uint64_t          switch_asn; // 0 when no switch is planned
+    uint8_t           max_packet_len; // largest frame of the network, which every slot is sized for
+    uint8_t           channel_blacklist[BLINK_CHANNEL_MASK_LEN]; // data channels left out of the hopping sequence, with BLINK_BEACON_CHANNEL_SWITCH_PENDING
 } bl_beacon_packet_header_t;
 
+// planned change of the data channels, between the beacon header and the bloom filter, only while one is pending
+typedef struct __attribute__((packed)) {
+    uint8_t           next_channel_blacklist[BLINK_CHANNEL_MASK_LEN]; // blacklist used from channel_switch_asn on
+    uint64_t          channel_switch_asn;
+} bl_beacon_channel_switch_t;
+
+#define BLINK_BEACON_MAX_HEADER_LEN (sizeof(bl_beacon_packet_header_t) + sizeof(bl_beacon_channel_switch_t)) // the beacon slots are sized for it, with the bloom filter
+
+// cell-move packet, sent by a gateway before a schedule switch to the nodes whose uplink cell does not exist in the next schedule
+typedef struct __attribute__((packed)) {
+    uint8_t           schedule_id; // schedule of the cell, usually the next one
+    uint16_t          cell_index;
+} bl_cell_move_t;
+
+// bandwidth request, sent by a node in one of its uplink cells to ask for extra uplink cells
+typedef struct __attribute__((packed)) {
+    uint8_t           n_cells; // extra cells wanted in total, 0 to release them all
+} bl_bandwidth_request_t;
+
+// bandwidth grant, the answer of the gateway: all the extra cells of the node, followed by n_cells cell indexes on 2 bytes
+typedef struct __attribute__((packed)) {
+    uint8_t           schedule_id; // schedule of the cells
+    uint8_t           n_cells;
+} bl_bandwidth_grant_t;
+
+#define BLINK_CONTROL_PACKET_MAX_LEN (sizeof(bl_packet_header_t) + sizeof(bl_bandwidth_grant_t) + BLINK_N_EXTRA_UPLINK_CELLS_MAX * sizeof(uint16_t)) // largest frame sent by the MAC in data slots, a full bandwidth grant
+
+// aggregated data, the payloads of several nodes in one broadcast frame from the gateway, each one after a
+// bl_aggregated_entry_t. Nodes are designated by the position of their uplink cell among the uplink cells,
+// and the low bytes of their id, as another node may have taken the position since the frame was queued
+typedef struct __attribute__((packed)) {
+    uint8_t           schedule_id; // schedule of the positions, the frame is ignored by the nodes of another one
+} bl_aggregated_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t          handle; // position of the uplink cell of the node
+    uint16_t          node_id_low; // lower 16 bits of the id of the node
+    uint8_t           len; // of the payload that follows
+} bl_aggregated_entry_t;
+
 //=========================== prototypes =======================================
 
 size_t bl_build_packet_data(uint8_t *buffer, uint64_t dst, uint8_t *data, size_t data_len);
 
 size_t bl_build_packet_join_request(uint8_t *buffer, uint64_t dst);
 
-size_t bl_build_packet_join_response(uint8_t *buffer, uint64_t dst);
+size_t bl_build_packet_join_response(uint8_t *buffer, uint64_t dst, uint16_t cell_index);
 
 size_t bl_build_packet_keepalive(uint8_t *buffer, uint64_t dst);
 
-size_t bl_build_packet_beacon(uint8_t *buffer, uint64_t asn, uint8_t remaining_capacity, uint8_t active_schedule_id);
+size_t bl_build_packet_cell_move(uint8_t *buffer, uint64_t dst, uint8_t schedule_id, uint16_t cell_index);
+
+size_t bl_build_packet_bandwidth_request(uint8_t *buffer, uint64_t dst, uint8_t n_cells);
+
+size_t bl_build_packet_bandwidth_grant(uint8_t *buffer, uint64_t dst, uint8_t schedule_id, const uint16_t *cell_indexes, uint8_t n_cells);
+
+size_t bl_build_packet_aggregated(uint8_t *buffer, uint8_t schedule_id); // without any payload, see bl_packet_aggregated_append
+
+size_t bl_packet_aggregated_append(uint8_t *buffer, size_t len, uint16_t handle, uint64_t node_id, const uint8_t *data, uint8_t data_len); // returns the new length of the packet
+
+size_t bl_packet_beacon_header_len(const uint8_t *packet); // the bloom filter follows
+
+void bl_packet_beacon_get_channel_blacklist(const bl_beacon_packet_header_t *beacon, const bl_beacon_channel_switch_t *channel_switch, uint64_t *blacklist, uint64_t *next_blacklist, uint64_t *switch_asn); // channel_switch is ignored unless the beacon has one, next_blacklist is then blacklist and switch_asn 0
+
+size_t bl_build_packet_beacon(uint8_t *buffer, uint64_t asn, uint16_t remaining_capacity, uint8_t active_schedule_id, const bl_schedule_descriptor_t *schedule, uint8_t next_schedule_id, uint64_t switch_asn, uint8_t max_packet_len, uint64_t channel_blacklist, uint64_t next_channel_blacklist, uint64_t channel_switch_asn);
 
 #endif
@@ -0,0 +1,85 @@
+/**
+ * @file
+ * @ingroup     blink
+ *
+ * @brief       Pool of packet buffers the radio receives into
+ *
+ * @copyright Inria, 2025-now
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "pool.h"
+
+//=========================== variables ========================================
+
+typedef struct {
+    bl_radio_pdu_t buffers[BLINK_POOL_SIZE];
+    uint8_t refs[BLINK_POOL_SIZE]; // references to each buffer, 0 when free, only changed with atomics
+} pool_vars_t;
+
+static pool_vars_t _pool_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static int8_t _index(const void *ptr);
+
+//=========================== public ===========================================
+
+void bl_pool_init(void) {
+    memset(_pool_vars.refs, 0, sizeof(_pool_vars.refs));
+}
+
+bl_radio_pdu_t *bl_pool_alloc(void) {
+    for (size_t i = 0; i < BLINK_POOL_SIZE; i++) {
+        uint8_t free = 0;
+        if (__atomic_compare_exchange_n(&_pool_vars.refs[i], &free, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return &_pool_vars.buffers[i];
+        }
+    }
+    return NULL;
+}
+
+bool bl_pool_hold(const void *ptr) {
+    int8_t i = _index(ptr);
+    if (i < 0 || __atomic_load_n(&_pool_vars.refs[i], __ATOMIC_RELAXED) == 0 || bl_pool_available() == 0) {
+        return false;
+    }
+    __atomic_add_fetch(&_pool_vars.refs[i], 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+void bl_pool_release(const void *ptr) {
+    int8_t i = _index(ptr);
+    if (i < 0 || __atomic_load_n(&_pool_vars.refs[i], __ATOMIC_RELAXED) == 0) {
+        return;
+    }
+    // the contents must be read before the buffer can be taken again
+    __atomic_sub_fetch(&_pool_vars.refs[i], 1, __ATOMIC_RELEASE);
+}
+
+bool bl_pool_is_shared(const bl_radio_pdu_t *pdu) {
+    int8_t i = _index(pdu);
+    return i >= 0 && __atomic_load_n(&_pool_vars.refs[i], __ATOMIC_RELAXED) > 1;
+}
+
+uint8_t bl_pool_available(void) {
+    uint8_t count = 0;
+    for (size_t i = 0; i < BLINK_POOL_SIZE; i++) {
+        count += __atomic_load_n(&_pool_vars.refs[i], __ATOMIC_RELAXED) == 0;
+    }
+    return count;
+}
+
+//=========================== private ==========================================
+
+static int8_t _index(const void *ptr) {
+    const uint8_t *start = (const uint8_t *)_pool_vars.buffers;
+    const uint8_t *p = (const uint8_t *)ptr;
+    if (p < start || p >= start + sizeof(_pool_vars.buffers)) {
+        return -1;
+    }
+    return (p - start) / sizeof(bl_radio_pdu_t);
+}
@@ -0,0 +1,66 @@
+#ifndef __POOL_H
+#define __POOL_H
+
+/**
+ * @ingroup     blink
+ * @brief       Pool of packet buffers the radio receives into
+ *
+ * Buffers are laid out as radio PDUs, so that the radio writes frames straight into
+ * them (see bl_radio_set_rx_pdu), and are reference counted: the MAC holds the one
+ * armed for reception, and the application can hold a received packet past its
+ * callback. Lock-free, buffers can be taken and released from interrupts and from
+ * the main loop.
+ *
+ * @{
+ * @file
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bl_radio.h"
+
+//=========================== defines =========================================
+
+#ifndef BLINK_POOL_SIZE
+#define BLINK_POOL_SIZE (4) // buffers, one of them is always armed for reception
+#endif
+
+//=========================== prototypes ======================================
+
+void bl_pool_init(void);
+
+/**
+ * @brief Takes a free buffer, with one reference
+ *
+ * @return the buffer, or NULL if they are all taken
+ */
+bl_radio_pdu_t *bl_pool_alloc(void);
+
+/**
+ * @brief Adds a reference to the buffer holding @p ptr
+ *
+ * Only succeeds while another buffer is free, so that the MAC can always arm one for
+ * reception in place of the held one.
+ *
+ * @param[in] ptr       anywhere in a taken buffer
+ *
+ * @return false if @p ptr is not in a taken buffer, or no other buffer is free
+ */
+bool bl_pool_hold(const void *ptr);
+
+/**
+ * @brief Drops a reference to the buffer holding @p ptr, which is free again after the last one
+ */
+void bl_pool_release(const void *ptr);
+
+/**
+ * @brief Whether the buffer has more than one reference, e.g. the application held it
+ */
+bool bl_pool_is_shared(const bl_radio_pdu_t *pdu);
+
+uint8_t bl_pool_available(void);
+
+#endif // __POOL_H
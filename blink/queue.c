@@ -12,8 +12,10 @@
 #include <nrf.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 
+#include "bl_radio.h"
 #include "packet.h"
 #include "mac.h"
 #include "scheduler.h"
@@ -21,128 +23,347 @@
 #include "bloom.h"
 #include "blink.h"
 #include "queue.h"
+#include "stats.h"
 
 //=========================== defines ==========================================
 
-typedef struct {
-    uint8_t length;
-    uint8_t buffer[BLINK_PACKET_MAX_SIZE];
-} bl_packet_t;
+// packets are stored as radio frames, sent by the radio straight from the queue
+typedef bl_radio_pdu_t bl_packet_t;
+
+typedef enum {
+    BL_QUEUE_TX_NONE,
+    BL_QUEUE_TX_FRAME,      ///< Beacon or keepalive, built at the start of the slot
+    BL_QUEUE_TX_QUEUE,      ///< Head of the packet queue
+    BL_QUEUE_TX_JOIN,
+    BL_QUEUE_TX_BANDWIDTH,
+} bl_queue_tx_source_t;
+
+// lock-free ring of bytes, filled from the application and the interrupts, drained by the MAC in its interrupts
+// each record is a marker byte, the slot at which it expires, the slot at which it was queued, the node it is
+// for and the next record for that node (see below), then the frame, header and length then the packet.
+// Records never wrap around the end of the ring, so that the radio reads them in one piece.
+// Positions are in bytes, run freely and wrap at 65536. The bytes not used by a record are zero, so that
+// no marker is seen before it is set
+typedef enum {
+    BL_QUEUE_RECORD_EMPTY = 0,  ///< Claimed by a producer that is still writing it, or not claimed
+    BL_QUEUE_RECORD_READY,
+    BL_QUEUE_RECORD_WRAP,       ///< Unused end of the ring, the record is at its start
+    BL_QUEUE_RECORD_SENT,       ///< Removed before the records in front of it, freed once they are
+} bl_queue_record_marker_t;
+
+#define BL_QUEUE_RECORD_EXPIRY      (1) // offset of the expiry, the lower 32 bits of an asn, 0 if the packet never expires
+#define BL_QUEUE_RECORD_QUEUED      (BL_QUEUE_RECORD_EXPIRY + sizeof(uint32_t)) // lower 16 bits of the asn
+#define BL_QUEUE_RECORD_FLOW        (BL_QUEUE_RECORD_QUEUED + sizeof(uint16_t))
+#define BL_QUEUE_RECORD_NEXT        (BL_QUEUE_RECORD_FLOW + sizeof(uint16_t))
+#define BL_QUEUE_RECORD_FRAME       (BL_QUEUE_RECORD_NEXT + sizeof(uint16_t))
+#define BL_QUEUE_RECORD_OVERHEAD    (BL_QUEUE_RECORD_FRAME + offsetof(bl_radio_pdu_t, payload))
+#define BL_QUEUE_PRIORITIES         (BLINK_PRIORITY_BULK + 1)
+
+// at the gateway, the bulk packets for each node are also linked in a list, its flow, and the MAC serves the
+// flows in deficit round-robin order, so that a node with many packets does not delay the others. Flows are
+// indexed by the position of the uplink cell of the node, and follow it when it moves, the last one is for
+// broadcasts and unknown nodes. It holds up to BLINK_PACKET_QUEUE_OTHER_BYTES, the others a number of packets
+#define BL_QUEUE_FLOWS              (BLINK_N_UPLINK_CELLS_MAX + 1)
+#define BL_QUEUE_FLOW_OTHER         (BLINK_N_UPLINK_CELLS_MAX)
+#define BL_QUEUE_NONE               (UINT16_MAX) // end of a list
 
 typedef struct {
-    uint8_t         current;                            ///< Current position in the queue
-    uint8_t         last;                               ///< Position of the last item added in the queue
-    bl_packet_t  packets[BLINK_PACKET_QUEUE_SIZE];
+    uint16_t        current;    ///< Position of the next record to send, only written by the MAC, once it is done with it
+    uint16_t        last;       ///< Next position to fill, claimed by the producers
+    uint16_t        count;      ///< Records claimed and not popped yet
+    uint16_t        size;       ///< Bytes of the ring, a power of 2
+    uint8_t         *bytes;
 } blink_packet_queue_t;
 
 typedef struct {
-    blink_packet_queue_t    packet_queue;
+    uint16_t        pending;    ///< Packets queued for the node and not removed yet, counted by the producers
+    uint16_t        count;      ///< Records in the flow, linked by the MAC
+    uint16_t        head;       ///< Position of the first one, the others are linked from it
+    uint16_t        tail;
+    uint16_t        deficit;    ///< Bytes the node may still be sent in this round
+    uint16_t        next;       ///< Next flow of the round, BL_QUEUE_NONE for the last one
+} bl_queue_flow_t;
+
+typedef struct {
+    blink_packet_queue_t    packet_queues[BL_QUEUE_PRIORITIES]; ///< Drained in order, see blink_priority_t
+    uint8_t              control_bytes[BLINK_PACKET_QUEUE_CONTROL_BYTES];
+    uint8_t              bulk_bytes[BLINK_PACKET_QUEUE_BYTES];
     bl_packet_t          join_packet;
+    bl_packet_t          bandwidth_packet;  ///< Bandwidth request of the node, sent before the queued packets
+    bl_packet_t          tx_frame;          ///< Beacon or keepalive of the current slot
+    bl_queue_tx_source_t tx_source;         ///< Where the frame handed to the radio is, removed by bl_queue_tx_done
+    blink_priority_t     tx_priority;       ///< Queue of the frame, if it is BL_QUEUE_TX_QUEUE
+    uint8_t              *tx_record;        ///< Record of the frame, in that queue
+    bl_queue_flow_t      flows[BL_QUEUE_FLOWS]; ///< Of the bulk queue, only used by gateways
+    uint16_t             round_head;        ///< Flows with packets, in the order they are served
+    uint16_t             round_tail;
+    uint16_t             scanned;           ///< Position in the bulk queue of the first record not in a flow yet
+    uint16_t             other_bytes;       ///< Bytes of the records of the last flow, counted by the producers
 } queue_vars_t;
 
 //=========================== variables ========================================
 
-static queue_vars_t queue_vars = { 0 };
+static queue_vars_t queue_vars = {
+    .packet_queues = {
+        [BLINK_PRIORITY_CONTROL] = { .size = BLINK_PACKET_QUEUE_CONTROL_BYTES, .bytes = queue_vars.control_bytes },
+        [BLINK_PRIORITY_BULK] = { .size = BLINK_PACKET_QUEUE_BYTES, .bytes = queue_vars.bulk_bytes },
+    },
+    .round_head = BL_QUEUE_NONE,
+    .round_tail = BL_QUEUE_NONE,
+};
 
 //=========================== prototypes =======================================
 
+static const bl_packet_t *_queue_select(bool fitting);
+static int16_t _queue_push(blink_packet_queue_t *queue, const uint8_t *packet, uint8_t length, uint32_t expiry, bool multi_producer);
+static uint8_t *_queue_head(blink_packet_queue_t *queue);
+static void _queue_remove(blink_packet_queue_t *queue, uint8_t *record, bool sent);
+static void _queue_remove_head(blink_packet_queue_t *queue);
+static bool _queue_is_fair(const blink_packet_queue_t *queue);
+static uint16_t _queue_flow_of(const uint8_t *packet, uint8_t length);
+static bool _queue_flow_claim(uint16_t index, uint16_t size);
+static void _queue_flow_release(uint16_t index, uint16_t size);
+static void _queue_fair_scan(blink_packet_queue_t *queue);
+static uint8_t *_queue_fair_head(blink_packet_queue_t *queue);
+static void _queue_fair_remove(blink_packet_queue_t *queue, uint8_t *record, bool sent);
+static void _queue_fair_release(blink_packet_queue_t *queue);
+static void _queue_fair_drop(blink_packet_queue_t *queue, uint16_t index);
+static void _queue_round_append(uint16_t flow);
+
+static inline bl_packet_t *_record_frame(uint8_t *record) {
+    return (bl_packet_t *)(record + BL_QUEUE_RECORD_FRAME);
+}
+
+static inline uint16_t _record_field(const uint8_t *record, size_t offset) {
+    uint16_t value;
+    memcpy(&value, record + offset, sizeof(value));
+    return value;
+}
+
 //=========================== public ===========================================
 
-uint8_t bl_queue_next_packet(slot_type_t slot_type, uint8_t *packet) {
-    uint8_t len = 0;
+const bl_radio_pdu_t *bl_queue_next_pdu(slot_type_t slot_type) {
+    const bl_packet_t *pdu = NULL;
+    queue_vars.tx_source = BL_QUEUE_TX_NONE;
 
     if (blink_get_node_type() == BLINK_GATEWAY) {
         if (slot_type == SLOT_TYPE_BEACON) {
             // prepare a beacon packet with current asn, remaining capacity and active schedule id
-            len = bl_build_packet_beacon(
+            uint8_t *packet = queue_vars.tx_frame.payload;
+            uint8_t len = bl_build_packet_beacon(
                 packet,
                 bl_mac_get_asn(),
                 bl_scheduler_gateway_remaining_capacity(),
-                bl_scheduler_get_active_schedule_id()
+                bl_scheduler_get_active_schedule_id(),
+                &bl_scheduler_get_active_schedule_ptr()->descriptor,
+                bl_scheduler_get_next_schedule_id(),
+                bl_scheduler_get_switch_asn(),
+                bl_mac_get_max_packet_len(),
+                bl_scheduler_get_channel_blacklist(),
+                bl_scheduler_get_next_channel_blacklist(),
+                bl_scheduler_get_channel_switch_asn()
             );
             if (bl_bloom_gateway_is_available()) {
-                len += bl_bloom_gateway_copy(packet + sizeof(bl_beacon_packet_header_t));
+                len += bl_bloom_gateway_copy(packet + len);
             }
+            queue_vars.tx_frame.length = len;
+            queue_vars.tx_source = BL_QUEUE_TX_FRAME;
         } else if (slot_type == SLOT_TYPE_DOWNLINK) {
             if (bl_queue_has_join_packet()) {
-                len = bl_queue_get_join_packet(packet);
-            } else {
-                // load a packet from the queue, if any is available
-                len = bl_queue_peek(packet);
-                if (len) {
-                    // actually pop the packet from the queue
-                    bl_queue_pop();
-                }
+                queue_vars.tx_source = BL_QUEUE_TX_JOIN;
+            } else if (_queue_select(true) != NULL) {
+                // send the next packet of the queue, if any is available
+                queue_vars.tx_source = BL_QUEUE_TX_QUEUE;
             }
         }
     } else if (blink_get_node_type() == BLINK_NODE) {
         if (slot_type == SLOT_TYPE_SHARED_UPLINK) {
             if (bl_assoc_node_ready_to_join()) {
                 bl_assoc_node_start_joining();
-                len = bl_queue_get_join_packet(packet);
+                if (bl_queue_has_join_packet()) {
+                    queue_vars.tx_source = BL_QUEUE_TX_JOIN;
+                }
             }
         } else if (slot_type == SLOT_TYPE_UPLINK) {
-            // load a packet from the queue, if any is available
-            len = bl_queue_peek(packet);
-            if (len) {
-                // actually pop the packet from the queue
-                bl_queue_pop();
-            } else if (BLINK_AUTO_UPLINK_KEEPALIVE) {
-                // send a keepalive packet
-                len = bl_build_packet_keepalive(packet, bl_mac_get_synced_gateway());
+            if (queue_vars.bandwidth_packet.length > 0) {
+                queue_vars.tx_source = BL_QUEUE_TX_BANDWIDTH;
+            } else if (_queue_select(true) != NULL) {
+                // send the packet at the head of the queue, if any is available
+                queue_vars.tx_source = BL_QUEUE_TX_QUEUE;
+            } else if (BLINK_AUTO_UPLINK_KEEPALIVE && !bl_scheduler_node_in_extra_cell()) {
+                // send a keepalive packet, the own cell of the node is enough for that
+                queue_vars.tx_frame.length = bl_build_packet_keepalive(queue_vars.tx_frame.payload, bl_mac_get_synced_gateway());
+                queue_vars.tx_source = BL_QUEUE_TX_FRAME;
+            }
+            // the queue is drained across all the uplink cells of the node, ask for more of them if it does not keep up
+            uint8_t backlog = bl_queue_length() - (queue_vars.tx_source == BL_QUEUE_TX_QUEUE);
+            int16_t n_cells = bl_scheduler_node_update_bandwidth(backlog, queue_vars.tx_source != BL_QUEUE_TX_NONE, bl_mac_get_asn());
+            // never overwrite a request that the radio is about to send
+            if (n_cells >= 0 && queue_vars.tx_source != BL_QUEUE_TX_BANDWIDTH) {
+                queue_vars.bandwidth_packet.length = bl_build_packet_bandwidth_request(queue_vars.bandwidth_packet.payload, bl_mac_get_synced_gateway(), n_cells);
+                BL_STATS_INC(bandwidth_requests);
             }
         }
     }
 
-    return len;
+    switch (queue_vars.tx_source) {
+        case BL_QUEUE_TX_FRAME:
+            pdu = &queue_vars.tx_frame;
+            break;
+        case BL_QUEUE_TX_QUEUE:
+            pdu = _record_frame(queue_vars.tx_record);
+            break;
+        case BL_QUEUE_TX_JOIN:
+            pdu = &queue_vars.join_packet;
+            break;
+        case BL_QUEUE_TX_BANDWIDTH:
+            pdu = &queue_vars.bandwidth_packet;
+            break;
+        default:
+            break;
+    }
+
+    return pdu;
+}
+
+void bl_queue_tx_done(void) {
+    switch (queue_vars.tx_source) {
+        case BL_QUEUE_TX_QUEUE:
+            // not bl_queue_pop, a control packet may have been added since the start of the slot
+            _queue_remove(&queue_vars.packet_queues[queue_vars.tx_priority], queue_vars.tx_record, true);
+            break;
+        case BL_QUEUE_TX_JOIN:
+            bl_queue_clear_join_packet();
+            break;
+        case BL_QUEUE_TX_BANDWIDTH:
+            queue_vars.bandwidth_packet.length = 0;
+            break;
+        default:
+            break;
+    }
+    queue_vars.tx_source = BL_QUEUE_TX_NONE;
+}
+
+bool bl_queue_add(const uint8_t *packet, uint8_t length) {
+    return _queue_push(&queue_vars.packet_queues[BLINK_PRIORITY_BULK], packet, length, 0, false) >= 0;
 }
 
-void bl_queue_add(uint8_t *packet, uint8_t length) {
-    // enqueue for transmission
-    memcpy(queue_vars.packet_queue.packets[queue_vars.packet_queue.last].buffer, packet, length);
-    queue_vars.packet_queue.packets[queue_vars.packet_queue.last].length = length;
-    // increment the `last` index
-    queue_vars.packet_queue.last = (queue_vars.packet_queue.last + 1) % BLINK_PACKET_QUEUE_SIZE;
+bool bl_queue_add_mp(const uint8_t *packet, uint8_t length) {
+    return _queue_push(&queue_vars.packet_queues[BLINK_PRIORITY_BULK], packet, length, 0, true) >= 0;
+}
+
+int16_t bl_queue_add_priority(const uint8_t *packet, uint8_t length, blink_priority_t priority, uint32_t ttl) {
+    uint32_t expiry = 0;
+    if (ttl > 0) {
+        // 0 means no expiry, be one slot late instead
+        expiry = (uint32_t)(bl_mac_get_asn() + ttl);
+        expiry = expiry ? expiry : 1;
+    }
+    return _queue_push(&queue_vars.packet_queues[priority], packet, length, expiry, true);
 }
 
 uint8_t bl_queue_peek(uint8_t *packet) {
-    if (queue_vars.packet_queue.current == queue_vars.packet_queue.last) {
+    const bl_packet_t *next = _queue_select(false);
+    if (next == NULL) {
         return 0;
     }
 
-    memcpy(packet, queue_vars.packet_queue.packets[queue_vars.packet_queue.current].buffer, queue_vars.packet_queue.packets[queue_vars.packet_queue.current].length);
-    // do not increment the `current` index here, as this is just a peek
-    return queue_vars.packet_queue.packets[queue_vars.packet_queue.current].length;
+    memcpy(packet, next->payload, next->length);
+    // do not remove it here, as this is just a peek
+    return next->length;
 }
 
 bool bl_queue_pop(void) {
-    if (queue_vars.packet_queue.current == queue_vars.packet_queue.last) {
+    if (_queue_select(false) == NULL) {
         return false;
-    } else {
-        // increment the `current` index
-        queue_vars.packet_queue.current = (queue_vars.packet_queue.current + 1) % BLINK_PACKET_QUEUE_SIZE;
-        return true;
+    }
+    _queue_remove(&queue_vars.packet_queues[queue_vars.tx_priority], queue_vars.tx_record, false);
+    return true;
+}
+
+uint8_t bl_queue_length(void) {
+    // includes the packets claimed by producers that are still writing them
+    uint16_t count = 0;
+    for (size_t i = 0; i < BL_QUEUE_PRIORITIES; i++) {
+        count += __atomic_load_n(&queue_vars.packet_queues[i].count, __ATOMIC_RELAXED);
+    }
+    return count > UINT8_MAX ? UINT8_MAX : count;
+}
+
+uint16_t bl_queue_gateway_node_length(uint64_t node_id) {
+    int16_t position = bl_scheduler_gateway_find_uplink_position(node_id);
+    if (position < 0) {
+        return 0;
+    }
+    return __atomic_load_n(&queue_vars.flows[position].pending, __ATOMIC_RELAXED);
+}
+
+void bl_queue_gateway_node_left(uint16_t uplink_position) {
+    blink_packet_queue_t *queue = &queue_vars.packet_queues[BLINK_PRIORITY_BULK];
+    if (!_queue_is_fair(queue)) {
+        return;
+    }
+    // not for the node that takes the position next
+    _queue_fair_scan(queue);
+    _queue_fair_drop(queue, uplink_position);
+}
+
+void bl_queue_gateway_node_moved(uint16_t from_uplink_position, uint16_t to_uplink_position) {
+    blink_packet_queue_t *queue = &queue_vars.packet_queues[BLINK_PRIORITY_BULK];
+    if (!_queue_is_fair(queue)) {
+        return;
+    }
+    _queue_fair_scan(queue);
+    // left by a producer that queued a packet for a node while it was leaving, if any
+    _queue_fair_drop(queue, to_uplink_position);
+
+    // the linked records go with the node, those still being written are linked to the flow they were queued for
+    bl_queue_flow_t *from = &queue_vars.flows[from_uplink_position];
+    bl_queue_flow_t *to = &queue_vars.flows[to_uplink_position];
+    if (from->count == 0) {
+        return;
+    }
+    __atomic_sub_fetch(&from->pending, from->count, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&to->pending, from->count, __ATOMIC_RELAXED);
+    to->count = from->count;
+    to->head = from->head;
+    to->tail = from->tail;
+    to->deficit = from->deficit;
+    to->next = from->next;
+    from->count = 0;
+    from->deficit = 0;
+    // and keep its turn in the round
+    for (uint16_t *link = &queue_vars.round_head; *link != BL_QUEUE_NONE; link = &queue_vars.flows[*link].next) {
+        if (*link == from_uplink_position) {
+            *link = to_uplink_position;
+            break;
+        }
+    }
+    if (queue_vars.round_tail == from_uplink_position) {
+        queue_vars.round_tail = to_uplink_position;
     }
 }
 
 void bl_queue_set_join_request(uint64_t node_id) {
-    queue_vars.join_packet.length = bl_build_packet_join_request(queue_vars.join_packet.buffer, node_id);
+    queue_vars.join_packet.length = bl_build_packet_join_request(queue_vars.join_packet.payload, node_id);
 }
 
-void bl_queue_set_join_response(uint64_t node_id, uint8_t assigned_cell_id) {
-    uint8_t len = bl_build_packet_join_response(queue_vars.join_packet.buffer, node_id);
-    queue_vars.join_packet.buffer[len++] = assigned_cell_id;
-    queue_vars.join_packet.length = len;
+void bl_queue_set_join_response(uint64_t node_id, uint16_t assigned_cell_id) {
+    queue_vars.join_packet.length = bl_build_packet_join_response(queue_vars.join_packet.payload, node_id, assigned_cell_id);
 }
 
 bool bl_queue_has_join_packet(void) {
     return queue_vars.join_packet.length > 0;
 }
 
+void bl_queue_clear_join_packet(void) {
+    queue_vars.join_packet.length = 0;
+}
+
 // if used by the node, gets it a join request packet
 // if used by the gateway, gets it a join response packet
 uint8_t bl_queue_get_join_packet(uint8_t *packet) {
-    memcpy(packet, queue_vars.join_packet.buffer, queue_vars.join_packet.length);
+    memcpy(packet, queue_vars.join_packet.payload, queue_vars.join_packet.length);
     uint8_t len = queue_vars.join_packet.length;
 
     // clear the join request
@@ -150,3 +371,311 @@ uint8_t bl_queue_get_join_packet(uint8_t *packet) {
 
     return len;
 }
+
+//=========================== private ==========================================
+
+// finds the next packet to send, by priority, and keeps it in tx_priority and tx_record. When fitting,
+// those larger than the slots of the network and the expired ones are dropped on the way
+static const bl_packet_t *_queue_select(bool fitting) {
+    uint32_t asn = (uint32_t)bl_mac_get_asn();
+    for (size_t i = 0; i < BL_QUEUE_PRIORITIES; i++) {
+        blink_packet_queue_t *queue = &queue_vars.packet_queues[i];
+        uint8_t *record;
+        while ((record = _queue_is_fair(queue) ? _queue_fair_head(queue) : _queue_head(queue)) != NULL) {
+            uint32_t expiry;
+            memcpy(&expiry, record + BL_QUEUE_RECORD_EXPIRY, sizeof(expiry));
+            if (fitting && expiry != 0 && (int32_t)(asn - expiry) >= 0) {
+                BL_STATS_INC(ttl_drops);
+            } else if (fitting && _record_frame(record)->length > bl_mac_get_max_packet_len()) {
+                BL_STATS_INC(oversized_drops);
+            } else {
+                queue_vars.tx_priority = i;
+                queue_vars.tx_record = record;
+                return _record_frame(record);
+            }
+            _queue_remove(queue, record, false);
+        }
+    }
+    return NULL;
+}
+
+// returns the depth of the queue with the packet, -1 if it or the flow of the packet is full
+static int16_t _queue_push(blink_packet_queue_t *queue, const uint8_t *packet, uint8_t length, uint32_t expiry, bool multi_producer) {
+    uint16_t size = BL_QUEUE_RECORD_OVERHEAD + length;
+    uint16_t flow = BL_QUEUE_FLOW_OTHER;
+    if (_queue_is_fair(queue)) {
+        flow = _queue_flow_of(packet, length);
+        if (!_queue_flow_claim(flow, size)) {
+            BL_STATS_INC_ATOMIC(queue_drops);
+            return -1;
+        }
+    }
+
+    uint16_t last = __atomic_load_n(&queue->last, __ATOMIC_RELAXED);
+    uint16_t claimed;
+    do {
+        // bytes are free once the MAC is done reading them
+        uint16_t current = __atomic_load_n(&queue->current, __ATOMIC_ACQUIRE);
+        uint16_t offset = last & (queue->size - 1);
+        claimed = size;
+        if (offset + size > queue->size) {
+            // skip the end of the ring, too short for the record
+            claimed += queue->size - offset;
+        }
+        if ((uint16_t)(last - current) + claimed > queue->size) {
+            if (_queue_is_fair(queue)) {
+                _queue_flow_release(flow, size);
+            }
+            BL_STATS_INC_ATOMIC(queue_drops);
+            return -1;
+        }
+        if (!multi_producer) {
+            __atomic_store_n(&queue->last, last + claimed, __ATOMIC_RELAXED);
+            break;
+        }
+        // claim the bytes, against the producers that interrupt this one or are interrupted by it
+    } while (!__atomic_compare_exchange_n(&queue->last, &last, last + claimed, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    uint16_t depth = __atomic_add_fetch(&queue->count, 1, __ATOMIC_RELAXED);
+
+    // the MAC waits for this record if the producer is interrupted before setting it ready, even if later ones are
+    uint8_t *record = &queue->bytes[(last + claimed - size) & (queue->size - 1)];
+    uint16_t queued = (uint16_t)bl_mac_get_asn();
+    memcpy(record + BL_QUEUE_RECORD_EXPIRY, &expiry, sizeof(expiry));
+    memcpy(record + BL_QUEUE_RECORD_QUEUED, &queued, sizeof(queued));
+    memcpy(record + BL_QUEUE_RECORD_FLOW, &flow, sizeof(flow));
+    bl_packet_t *entry = _record_frame(record);
+    entry->header = 0;
+    entry->length = length;
+    memcpy(entry->payload, packet, length);
+    // publish the packet to the MAC, after it has been written
+    __atomic_store_n(record, BL_QUEUE_RECORD_READY, __ATOMIC_RELEASE);
+    if (claimed > size) {
+        __atomic_store_n(&queue->bytes[last & (queue->size - 1)], BL_QUEUE_RECORD_WRAP, __ATOMIC_RELEASE);
+    }
+
+    BL_STATS_MAX_ATOMIC(queue_high_watermark, depth);
+    return depth;
+}
+
+// the record at the head of the queue, NULL if there is none or it is not fully written, only called by the MAC
+static uint8_t *_queue_head(blink_packet_queue_t *queue) {
+    while (true) {
+        uint16_t offset = queue->current & (queue->size - 1);
+        uint8_t marker = __atomic_load_n(&queue->bytes[offset], __ATOMIC_ACQUIRE);
+        if (marker == BL_QUEUE_RECORD_WRAP) {
+            // hand the end of the ring back to the producers, and look at its start
+            memset(&queue->bytes[offset], 0, queue->size - offset);
+            __atomic_store_n(&queue->current, queue->current + queue->size - offset, __ATOMIC_RELEASE);
+        } else if (marker == BL_QUEUE_RECORD_SENT) {
+            // left by the flows, if the node was a gateway
+            _queue_remove_head(queue);
+        } else if (marker == BL_QUEUE_RECORD_READY) {
+            return &queue->bytes[offset];
+        } else {
+            return NULL;
+        }
+    }
+}
+
+// of a record returned by _queue_select
+static void _queue_remove(blink_packet_queue_t *queue, uint8_t *record, bool sent) {
+    if (_queue_is_fair(queue)) {
+        _queue_fair_remove(queue, record, sent);
+    } else {
+        __atomic_sub_fetch(&queue->count, 1, __ATOMIC_RELAXED);
+        _queue_remove_head(queue);
+    }
+}
+
+// frees the record at the head of a queue, whether it was sent or not
+static void _queue_remove_head(blink_packet_queue_t *queue) {
+    uint16_t offset = queue->current & (queue->size - 1);
+    uint16_t size = BL_QUEUE_RECORD_OVERHEAD + _record_frame(&queue->bytes[offset])->length;
+    memset(&queue->bytes[offset], 0, size);
+    // hand the bytes back to the producers, after they have been read and cleared
+    __atomic_store_n(&queue->current, queue->current + size, __ATOMIC_RELEASE);
+}
+
+static bool _queue_is_fair(const blink_packet_queue_t *queue) {
+    return queue == &queue_vars.packet_queues[BLINK_PRIORITY_BULK] && blink_get_node_type() == BLINK_GATEWAY;
+}
+
+// a producer may read the index of the scheduler while the MAC changes it, at worst the packet goes to another flow
+static uint16_t _queue_flow_of(const uint8_t *packet, uint8_t length) {
+    if (length < sizeof(bl_packet_header_t)) {
+        return BL_QUEUE_FLOW_OTHER;
+    }
+    uint64_t dst;
+    memcpy(&dst, packet + offsetof(bl_packet_header_t, dst), sizeof(dst));
+    int16_t position = bl_scheduler_gateway_find_uplink_position(dst);
+    return position < 0 ? BL_QUEUE_FLOW_OTHER : (uint16_t)position;
+}
+
+// counts a record in its flow, false if the flow is full: a node flow by packets, the last one by bytes, as it
+// holds the broadcasts and aggregated frames for all the nodes
+static bool _queue_flow_claim(uint16_t index, uint16_t size) {
+    uint16_t pending = __atomic_add_fetch(&queue_vars.flows[index].pending, 1, __ATOMIC_RELAXED);
+    bool full = pending > BLINK_PACKET_QUEUE_NODE_MAX;
+    if (index == BL_QUEUE_FLOW_OTHER) {
+        full = __atomic_add_fetch(&queue_vars.other_bytes, size, __ATOMIC_RELAXED) > BLINK_PACKET_QUEUE_OTHER_BYTES;
+    }
+    if (full) {
+        _queue_flow_release(index, size);
+    }
+    return !full;
+}
+
+static void _queue_flow_release(uint16_t index, uint16_t size) {
+    __atomic_sub_fetch(&queue_vars.flows[index].pending, 1, __ATOMIC_RELAXED);
+    if (index == BL_QUEUE_FLOW_OTHER) {
+        __atomic_sub_fetch(&queue_vars.other_bytes, size, __ATOMIC_RELAXED);
+    }
+}
+
+// links the records written since the last call to their flows, in the order they were claimed
+static void _queue_fair_scan(blink_packet_queue_t *queue) {
+    uint16_t last = __atomic_load_n(&queue->last, __ATOMIC_RELAXED);
+    if ((int16_t)(queue->current - queue_vars.scanned) > 0) {
+        // the records were removed in order, before the node became a gateway
+        queue_vars.scanned = queue->current;
+    }
+    while (queue_vars.scanned != last) {
+        uint16_t offset = queue_vars.scanned & (queue->size - 1);
+        uint8_t *record = &queue->bytes[offset];
+        uint8_t marker = __atomic_load_n(record, __ATOMIC_ACQUIRE);
+        if (marker == BL_QUEUE_RECORD_WRAP) {
+            // freed with the records in front of it
+            queue_vars.scanned += queue->size - offset;
+            continue;
+        }
+        if (marker != BL_QUEUE_RECORD_READY) {
+            return;
+        }
+        uint16_t position = queue_vars.scanned;
+        uint16_t none = BL_QUEUE_NONE;
+        memcpy(record + BL_QUEUE_RECORD_NEXT, &none, sizeof(none));
+        bl_queue_flow_t *flow = &queue_vars.flows[_record_field(record, BL_QUEUE_RECORD_FLOW)];
+        if (flow->count++ == 0) {
+            flow->head = position;
+            _queue_round_append(_record_field(record, BL_QUEUE_RECORD_FLOW));
+        } else {
+            memcpy(&queue->bytes[(flow->tail & (queue->size - 1)) + BL_QUEUE_RECORD_NEXT], &position, sizeof(position));
+        }
+        flow->tail = position;
+        queue_vars.scanned += BL_QUEUE_RECORD_OVERHEAD + _record_frame(record)->length;
+    }
+}
+
+// the first record of the flow whose turn it is, NULL if all are empty
+static uint8_t *_queue_fair_head(blink_packet_queue_t *queue) {
+    _queue_fair_scan(queue);
+    while (queue_vars.round_head != BL_QUEUE_NONE) {
+        bl_queue_flow_t *flow = &queue_vars.flows[queue_vars.round_head];
+        uint8_t *record = &queue->bytes[flow->head & (queue->size - 1)];
+        if (_record_frame(record)->length <= flow->deficit) {
+            return record;
+        }
+        // the node had its share of this round, and gets another one at the next round
+        uint16_t index = queue_vars.round_head;
+        queue_vars.round_head = flow->next;
+        if (queue_vars.round_head == BL_QUEUE_NONE) {
+            queue_vars.round_tail = BL_QUEUE_NONE;
+        }
+        _queue_round_append(index);
+    }
+    return NULL;
+}
+
+// of the record returned by _queue_fair_head, the first of the flow at the head of the round
+static void _queue_fair_remove(blink_packet_queue_t *queue, uint8_t *record, bool sent) {
+    uint16_t index = queue_vars.round_head;
+    bl_queue_flow_t *flow = &queue_vars.flows[index];
+    bl_packet_t *frame = _record_frame(record);
+
+    if (sent) {
+        flow->deficit -= frame->length;
+        if (frame->length >= sizeof(bl_packet_header_t)) {
+            uint64_t dst;
+            memcpy(&dst, frame->payload + offsetof(bl_packet_header_t, dst), sizeof(dst));
+            uint16_t latency = (uint16_t)bl_mac_get_asn() - _record_field(record, BL_QUEUE_RECORD_QUEUED);
+            bl_stats_gateway_node_downlink(bl_scheduler_gateway_find_uplink_position(dst), dst, latency);
+        }
+    }
+    flow->head = _record_field(record, BL_QUEUE_RECORD_NEXT);
+    if (--flow->count == 0) {
+        // the node leaves the round, and starts a new one without credit
+        flow->deficit = 0;
+        queue_vars.round_head = flow->next;
+        if (queue_vars.round_head == BL_QUEUE_NONE) {
+            queue_vars.round_tail = BL_QUEUE_NONE;
+        }
+    }
+    __atomic_store_n(record, BL_QUEUE_RECORD_SENT, __ATOMIC_RELAXED);
+    _queue_flow_release(index, BL_QUEUE_RECORD_OVERHEAD + frame->length);
+    __atomic_sub_fetch(&queue->count, 1, __ATOMIC_RELAXED);
+    _queue_fair_release(queue);
+}
+
+// frees the records removed from the flows, up to the first one that is still waiting
+static void _queue_fair_release(blink_packet_queue_t *queue) {
+    uint16_t current = queue->current;
+    while (current != queue_vars.scanned) {
+        uint16_t offset = current & (queue->size - 1);
+        uint8_t marker = queue->bytes[offset];
+        uint16_t size;
+        if (marker == BL_QUEUE_RECORD_WRAP) {
+            size = queue->size - offset;
+        } else if (marker == BL_QUEUE_RECORD_SENT) {
+            size = BL_QUEUE_RECORD_OVERHEAD + _record_frame(&queue->bytes[offset])->length;
+        } else {
+            break;
+        }
+        memset(&queue->bytes[offset], 0, size);
+        current += size;
+    }
+    // hand the bytes back to the producers, after they have been cleared
+    __atomic_store_n(&queue->current, current, __ATOMIC_RELEASE);
+}
+
+// removes all the records of a flow, wherever it is in the round, without sending them
+static void _queue_fair_drop(blink_packet_queue_t *queue, uint16_t index) {
+    bl_queue_flow_t *flow = &queue_vars.flows[index];
+    if (flow->count == 0) {
+        return;
+    }
+    while (flow->count > 0) {
+        uint8_t *record = &queue->bytes[flow->head & (queue->size - 1)];
+        flow->head = _record_field(record, BL_QUEUE_RECORD_NEXT);
+        flow->count--;
+        __atomic_store_n(record, BL_QUEUE_RECORD_SENT, __ATOMIC_RELAXED);
+        _queue_flow_release(index, BL_QUEUE_RECORD_OVERHEAD + _record_frame(record)->length);
+        __atomic_sub_fetch(&queue->count, 1, __ATOMIC_RELAXED);
+        BL_STATS_INC_ATOMIC(queue_drops);
+    }
+    flow->deficit = 0;
+    uint16_t previous = BL_QUEUE_NONE;
+    for (uint16_t *link = &queue_vars.round_head; *link != BL_QUEUE_NONE; link = &queue_vars.flows[*link].next) {
+        if (*link == index) {
+            *link = flow->next;
+            if (queue_vars.round_tail == index) {
+                queue_vars.round_tail = previous;
+            }
+            break;
+        }
+        previous = *link;
+    }
+    _queue_fair_release(queue);
+}
+
+// at the tail of the round, with the share of the node for it
+static void _queue_round_append(uint16_t index) {
+    bl_queue_flow_t *flow = &queue_vars.flows[index];
+    flow->deficit += BLINK_PACKET_QUEUE_QUANTUM;
+    flow->next = BL_QUEUE_NONE;
+    if (queue_vars.round_tail == BL_QUEUE_NONE) {
+        queue_vars.round_head = index;
+    } else {
+        queue_vars.flows[queue_vars.round_tail].next = index;
+    }
+    queue_vars.round_tail = index;
+}
@@ -16,25 +16,48 @@
 #include <stdbool.h>
 
 #include "models.h"
+#include "bl_radio.h"
 
 //=========================== defines =========================================
 
-#define BLINK_PACKET_QUEUE_SIZE (32) // must be a power of 2
+#ifndef BLINK_PACKET_QUEUE_BYTES
+#define BLINK_PACKET_QUEUE_BYTES (2048) // bulk packets, must be a power of 2, from 1024 to 32768, each packet takes its length and 13 bytes
+#endif
+#ifndef BLINK_PACKET_QUEUE_NODE_MAX
+#define BLINK_PACKET_QUEUE_NODE_MAX (8) // bulk packets waiting for one node at the gateway, further ones are refused
+#endif
+#ifndef BLINK_PACKET_QUEUE_OTHER_BYTES
+#define BLINK_PACKET_QUEUE_OTHER_BYTES (BLINK_PACKET_QUEUE_BYTES - BLINK_PACKET_MAX_SIZE) // bytes of the ring for broadcasts, aggregated frames and unknown nodes at the gateway, the rest is left to the nodes
+#endif
+#ifndef BLINK_PACKET_QUEUE_QUANTUM
+#define BLINK_PACKET_QUEUE_QUANTUM (BLINK_PACKET_MAX_SIZE) // bytes of bulk packets sent to each node per round at the gateway, at least the largest packet
+#endif
+#ifndef BLINK_PACKET_QUEUE_CONTROL_BYTES
+#define BLINK_PACKET_QUEUE_CONTROL_BYTES (1024) // control packets, sent before the bulk ones, same constraints
+#endif
 
 #define BLINK_AUTO_UPLINK_KEEPALIVE 1 // whether to send a keepalive packet when there is nothing to send
 
 //=========================== prototypes ======================================
 
-void bl_queue_add(uint8_t *packet, uint8_t length);
-uint8_t bl_queue_next_packet(slot_type_t slot_type, uint8_t *packet);
+bool bl_queue_add(const uint8_t *packet, uint8_t length); // bulk, single producer, false if the queue is full
+bool bl_queue_add_mp(const uint8_t *packet, uint8_t length); // same, from the application and interrupts at once
+int16_t bl_queue_add_priority(const uint8_t *packet, uint8_t length, blink_priority_t priority, uint32_t ttl); // multiple producers, dropped ttl slots later if not sent (0 for never), returns the packets in its queue, -1 if it is full
+const bl_radio_pdu_t *bl_queue_next_pdu(slot_type_t slot_type); // frame to send in the slot, in place, NULL if none
+void bl_queue_tx_done(void); // removes the frame of the slot once sent, it is sent again in a later slot otherwise
 uint8_t bl_queue_peek(uint8_t *packet);
 bool bl_queue_pop(void);
+uint8_t bl_queue_length(void);
+uint16_t bl_queue_gateway_node_length(uint64_t node_id); // bulk packets waiting for a node, at the gateway
+void bl_queue_gateway_node_left(uint16_t uplink_position); // drops the bulk packets waiting for the node, from the MAC interrupts
+void bl_queue_gateway_node_moved(uint16_t from_uplink_position, uint16_t to_uplink_position); // keeps them for it, same
 
 // void bl_queue_set_join_packet(uint64_t node_id, bl_packet_type_t packet_type);
 void bl_queue_set_join_request(uint64_t node_id);
-void bl_queue_set_join_response(uint64_t node_id, uint8_t assigned_cell_id);
+void bl_queue_set_join_response(uint64_t node_id, uint16_t assigned_cell_id);
 
 bool bl_queue_has_join_packet(void);
 uint8_t bl_queue_get_join_packet(uint8_t *packet);
+void bl_queue_clear_join_packet(void);
 
 #endif // __QUEUE_H
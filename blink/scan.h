@@ -23,7 +23,9 @@
 
 #define BLINK_MAX_SCAN_LIST_SIZE (5)
 #define BLINK_SCAN_OLD_US (1000*500) // rssi reading considered old after 500 ms
+#ifndef BLINK_HANDOVER_RSSI_HYSTERESIS
 #define BLINK_HANDOVER_RSSI_HYSTERESIS (9) // hysteresis (in dBm) for handover
+#endif
 #define BLINK_HANDOVER_MIN_INTERVAL (1000*1000*3) // minimum interval between handovers (in us)
 
 //=========================== variables =======================================
@@ -33,6 +35,7 @@ typedef struct {
     uint32_t                    timestamp;
     uint64_t                    captured_asn;
     bl_beacon_packet_header_t   beacon;
+    bl_beacon_channel_switch_t  channel_switch; ///< Only valid if the beacon has one, see bl_packet_beacon_get_channel_blacklist
 } bl_channel_info_t;
 
 typedef struct {
@@ -42,7 +45,7 @@ typedef struct {
 
 //=========================== prototypes ======================================
 
-void bl_scan_add(bl_beacon_packet_header_t beacon, int8_t rssi, uint8_t channel, uint32_t ts_scan, uint64_t asn_scan);
+void bl_scan_add(bl_beacon_packet_header_t beacon, const bl_beacon_channel_switch_t *channel_switch, int8_t rssi, uint8_t channel, uint32_t ts_scan, uint64_t asn_scan);
 
 bool bl_scan_select(bl_channel_info_t *best_channel_info, uint32_t ts_scan_started, uint32_t ts_scan_ended);
 
@@ -20,11 +20,88 @@
 #endif
 
 #include "scheduler.h"
+#include "generator.h"
+#include "stats.h"
 #include "all_schedules.c"
 #include "association.c"
 
 //=========================== defines ==========================================
 
+// open-addressing index from node_id to uplink cell, with linear probing, at least twice as large as BLINK_N_UPLINK_CELLS_MAX to keep the probes short
+#if BLINK_N_UPLINK_CELLS_MAX <= 128
+#define BLINK_NODE_INDEX_BITS (8)
+#elif BLINK_N_UPLINK_CELLS_MAX <= 512
+#define BLINK_NODE_INDEX_BITS (10)
+#elif BLINK_N_UPLINK_CELLS_MAX <= 2048
+#define BLINK_NODE_INDEX_BITS (12)
+#elif BLINK_N_UPLINK_CELLS_MAX <= 8192
+#define BLINK_NODE_INDEX_BITS (14)
+#else
+#define BLINK_NODE_INDEX_BITS (16)
+#endif
+#define BLINK_NODE_INDEX_SIZE (1UL << BLINK_NODE_INDEX_BITS)
+#define BLINK_NODE_INDEX_EMPTY (0) // entries hold the position of the uplink cell + 1
+
+#if BLINK_N_UPLINK_CELLS_MAX < UINT8_MAX
+typedef uint8_t node_index_entry_t;
+#else
+typedef uint16_t node_index_entry_t;
+#endif
+
+#ifndef BLINK_ELASTIC_SPARE_CELLS
+#define BLINK_ELASTIC_SPARE_CELLS (2) // free uplink cells kept for joining nodes, see bl_scheduler_gateway_update_elastic_schedule
+#endif
+
+#ifndef BLINK_SCHEDULE_SWITCH_SLOTFRAMES
+#define BLINK_SCHEDULE_SWITCH_SLOTFRAMES (4) // slotframes during which an elastic switch is announced, so that nodes hear it in several beacons
+#endif
+
+#ifndef BLINK_BANDWIDTH_RESERVED_CELLS
+#define BLINK_BANDWIDTH_RESERVED_CELLS (2) // free uplink cells never handed out as extra cells, so that nodes can still join
+#endif
+
+#ifndef BLINK_BANDWIDTH_REQUEST_SLOTFRAMES
+#define BLINK_BANDWIDTH_REQUEST_SLOTFRAMES (2) // slotframes between two bandwidth requests of a node, so that the grant has time to arrive
+#endif
+
+#ifndef BLINK_BANDWIDTH_IDLE_SLOTFRAMES
+#define BLINK_BANDWIDTH_IDLE_SLOTFRAMES (4) // slotframes after which unused extra cells are released
+#endif
+
+#ifndef BLINK_CHANNEL_BLACKLIST_ENABLED
+#define BLINK_CHANNEL_BLACKLIST_ENABLED (1) // gateways leave the data channels where they lose most uplink packets out of the hopping sequence, see bl_scheduler_gateway_update_channel_blacklist
+#endif
+
+#ifndef BLINK_CHANNEL_MIN_EXPECTED
+#define BLINK_CHANNEL_MIN_EXPECTED (8) // packets that a data channel as good as the reference one would have received, before judging it
+#endif
+
+#ifndef BLINK_CHANNEL_BAD_RATIO
+#define BLINK_CHANNEL_BAD_RATIO (3) // a data channel is blacklisted when it received less than this fraction of the expected packets
+#endif
+
+#ifndef BLINK_CHANNEL_MIN_WHITELISTED
+#define BLINK_CHANNEL_MIN_WHITELISTED (8) // data channels never blacklisted, to keep some frequency diversity
+#endif
+
+#ifndef BLINK_CHANNEL_BAN_SLOTFRAMES
+#define BLINK_CHANNEL_BAN_SLOTFRAMES (256) // slotframes after which a blacklisted channel is tried again
+#endif
+
+#define BLINK_CHANNEL_HISTORY (256) // uplink slots over which the reception ratio of a channel is computed, roughly
+#define BLINK_CHANNEL_MIN_ATTEMPTS (16) // uplink slots on a channel before its reception ratio is trusted as a reference
+
+// one bit per uplink cell of the active schedule, set when the cell is free, the first uplink cell being the most significant bit of the first word
+#define BLINK_UPLINK_BITMAP_WORDS ((BLINK_N_UPLINK_CELLS_MAX + 31) / 32)
+
+// position in the schedule and in the hopping sequences of a given slot, so that moving to the next slot needs no division
+typedef struct {
+    uint64_t asn;               // asn of the slot
+    uint16_t cell_index;        // asn % n_cells
+    uint8_t channel_base;       // asn % n_channels
+    uint8_t beacon_channel;     // asn % BLINK_N_BLE_ADVERTISING_CHANNELS
+    bl_generator_cursor_t generated; // the cell itself, when the active schedule is generated
+} slot_cursor_t;
 
 //=========================== variables ========================================
 
@@ -32,13 +109,51 @@ typedef struct {
     bl_node_type_t node_type; // whether the node is a gateway or a dotbot
 
     // counters and indexes
-    schedule_t *active_schedule_ptr; // pointer to the currently active schedule
+    const schedule_t *active_schedule_ptr; // pointer to the currently active schedule
     uint32_t slotframe_counter; // used to cycle beacon channels through slotframes (when listening for beacons at uplink slot_durations)
+    slot_cursor_t cursor; // next slot expected by bl_scheduler_tick
+    bool is_generated; // whether the cells of the active schedule come from the generator, instead of the tables below
+    const schedule_t *next_schedule_ptr; // schedule used from switch_asn on, NULL when no switch is planned
+    uint64_t switch_asn; // first slot of the next schedule
+
+    // data channels, see bl_scheduler_get_channel
+    uint64_t channel_blacklist; // data channels left out of the hopping sequence, bit i for channel i
+    uint64_t next_channel_blacklist; // blacklist used from channel_switch_asn on
+    uint64_t channel_switch_asn; // first slot of the next blacklist, 0 when no change is planned
+    uint8_t n_channels; // data channels in the hopping sequence
+    uint8_t channel_map[2 * BLINK_N_BLE_REGULAR_CHANNELS]; // channel at each position of the hopping sequence, twice, so that channel_base + channel_offset needs no modulo
+
+    // built-in schedules, indexed by cell, see _activate_schedule
+    uint8_t channel_offsets[BLINK_N_CELLS_MAX]; // channel offset of each cell, modulo BLINK_N_BLE_REGULAR_CHANNELS
+    uint8_t uplink_positions[BLINK_N_CELLS_MAX]; // position of each uplink cell among the uplink cells
+    uint8_t uplink_cells[BLINK_N_CELLS_MAX]; // cell at each position among the uplink cells
 
-    uint8_t num_assigned_uplink_nodes; // number of nodes with assigned uplink slots
+    // gateway only
+    bl_uplink_cells_t uplinks; // assignments of the uplink cells of the active schedule
+    uint16_t num_assigned_uplink_nodes; // number of nodes with assigned uplink slots
+    node_index_entry_t node_index[BLINK_NODE_INDEX_SIZE]; // uplink cell of each node, see _node_index_find
+    uint32_t uplink_free[BLINK_UPLINK_BITMAP_WORDS]; // free uplink cells, see BLINK_UPLINK_BITMAP_WORDS
+    bool is_elastic; // whether to switch schedules as nodes join and leave
+    uint16_t channel_attempts[BLINK_N_BLE_REGULAR_CHANNELS]; // uplink slots of joined nodes on each data channel, see bl_scheduler_gateway_channel_outcome
+    uint16_t channel_received[BLINK_N_BLE_REGULAR_CHANNELS]; // packets received in those slots
+    uint64_t channel_banned_until[BLINK_N_BLE_REGULAR_CHANNELS]; // slot from which a blacklisted channel is tried again
+    uint64_t channel_update_asn; // next slot in which to update the blacklist
+
+    // node only
+    int16_t node_cell_index; // uplink cell assigned to this node, -1 if none
+    int16_t node_uplink_position; // position of that cell among the uplink cells, its handle in aggregated packets
+    uint8_t node_moved_schedule_id; // schedule of node_moved_cell_index
+    int16_t node_moved_cell_index; // uplink cell received in a CELL_MOVE for the next schedule, -1 if none
+    uint16_t node_extra_cells[BLINK_N_EXTRA_UPLINK_CELLS_MAX]; // extra uplink cells granted to this node, see bl_scheduler_node_update_bandwidth
+    uint8_t node_extra_cells_len;
+    uint8_t node_extra_requested; // extra cells asked for in the last bandwidth request
+    uint64_t node_extra_request_asn; // slot of the last bandwidth request
+    uint16_t node_extra_idle; // extra cells in a row in which the node had nothing to send
+    bool node_in_extra_cell; // whether the slot of the last tick is an extra cell
+    schedule_t generated_schedule; // built from the descriptor in the beacon of the gateway, see generator.h
 
     // static data
-    schedule_t *available_schedules[BLINK_N_SCHEDULES];
+    const schedule_t *available_schedules[BLINK_N_SCHEDULES];
     size_t available_schedules_len;
 } schedule_vars_t;
 
@@ -47,81 +162,233 @@ static schedule_vars_t _schedule_vars = { 0 };
 //========================== prototypes ========================================
 
 // Compute the radio action when the node is a gateway
-void _compute_gateway_action(cell_t cell, bl_slot_info_t *slot_info);
+void _compute_gateway_action(const cell_t *cell, bl_slot_info_t *slot_info);
 
 // Compute the radio action when the node is a dotbot
-void _compute_dotbot_action(cell_t cell, bl_slot_info_t *slot_info);
+void _compute_dotbot_action(const cell_t *cell, bl_slot_info_t *slot_info);
+
+static bl_slot_info_t _slot_info(const slot_cursor_t *cursor);
+static void _cursor_seek(slot_cursor_t *cursor, uint64_t asn);
+static inline void _cursor_advance(slot_cursor_t *cursor);
+static inline uint8_t _cursor_channel(const slot_cursor_t *cursor, uint8_t type, uint8_t channel_offset);
+static void _activate_schedule(void);
+static void _load_schedule(void);
+static void _apply_switch(void);
+static void _set_channel_blacklist(uint64_t blacklist);
+static const schedule_t *_find_schedule(uint8_t schedule_id);
+static uint16_t _schedule_uplink_len(const schedule_t *schedule);
+static uint16_t _schedule_uplink_cell_index(const schedule_t *schedule, uint16_t uplink_position);
+static uint16_t _uplink_cell_index(size_t uplink_position);
+static uint16_t _uplink_position(uint16_t cell_index);
+static int16_t _take_free_uplink(void);
+static bool _is_uplink_cell(uint16_t cell_index);
+static void _release_extra_cells(int16_t uplink);
+static bool _node_owns_extra_cell(uint16_t cell_index);
+static void _node_clear_extra_cells(void);
+static int16_t _find_uplink(uint64_t node_id);
+static inline size_t _node_index_hash(uint64_t node_id);
+static size_t _node_index_find(uint64_t node_id);
+static void _node_index_remove(uint64_t node_id);
 
 //=========================== public ===========================================
 
-void bl_scheduler_init(bl_node_type_t node_type, schedule_t *application_schedule) {
+void bl_scheduler_init(bl_node_type_t node_type, const schedule_t *application_schedule) {
     _schedule_vars.node_type = node_type;
 
-    if (_schedule_vars.available_schedules_len == BLINK_N_SCHEDULES) return; // FIXME: this is just to simplify debugging (allows calling init multiple times)
-
-    // FIXME: schedules only used for debugging
-    //_schedule_vars.available_schedules[_schedule_vars.available_schedules_len++] = schedule_test;
+    // init may be called multiple times (e.g. to switch the node type), the built-in schedules are only registered once
+    if (_schedule_vars.available_schedules_len == 0) {
+        // FIXME: schedules only used for debugging
+        //_schedule_vars.available_schedules[_schedule_vars.available_schedules_len++] = schedule_test;
 
-    _schedule_vars.available_schedules[_schedule_vars.available_schedules_len++] = &schedule_minuscule;
-    _schedule_vars.available_schedules[_schedule_vars.available_schedules_len++] = &schedule_tiny;
-    _schedule_vars.available_schedules[_schedule_vars.available_schedules_len++] = &schedule_huge;
+        _schedule_vars.available_schedules[_schedule_vars.available_schedules_len++] = &schedule_minuscule;
+        _schedule_vars.available_schedules[_schedule_vars.available_schedules_len++] = &schedule_tiny;
+        _schedule_vars.available_schedules[_schedule_vars.available_schedules_len++] = &schedule_huge;
+    }
 
     if (application_schedule != NULL) {
-        _schedule_vars.available_schedules[_schedule_vars.available_schedules_len++] = application_schedule;
+        if (_schedule_vars.available_schedules_len < BLINK_N_SCHEDULES) {
+            _schedule_vars.available_schedules[_schedule_vars.available_schedules_len++] = application_schedule;
+        }
         _schedule_vars.active_schedule_ptr = application_schedule;
     }
+
+    // all the data channels, until the gateway knows better
+    memset(_schedule_vars.channel_attempts, 0, sizeof(_schedule_vars.channel_attempts));
+    memset(_schedule_vars.channel_received, 0, sizeof(_schedule_vars.channel_received));
+    _schedule_vars.channel_switch_asn = 0;
+    _schedule_vars.channel_update_asn = 0;
+    _set_channel_blacklist(0);
+
+    _activate_schedule();
 }
 
 bool bl_scheduler_set_schedule(uint8_t schedule_id) {
-    for (size_t i = 0; i < BLINK_N_SCHEDULES; i++) {
-        if (_schedule_vars.available_schedules[i]->id == schedule_id) {
-            _schedule_vars.active_schedule_ptr = _schedule_vars.available_schedules[i];
-            return true;
-        }
+    const schedule_t *schedule = _find_schedule(schedule_id);
+    if (schedule == NULL) {
+        return false;
     }
-    return false;
+    _schedule_vars.active_schedule_ptr = schedule;
+    _activate_schedule();
+    return true;
+}
+
+bool bl_scheduler_set_generated_schedule(const bl_schedule_descriptor_t *descriptor) {
+    schedule_t *schedule = &_schedule_vars.generated_schedule;
+    bool up_to_date = schedule->n_cells != 0 && memcmp(&schedule->descriptor, descriptor, sizeof(bl_schedule_descriptor_t)) == 0;
+    if (!up_to_date && !bl_generator_build_schedule(descriptor, schedule)) {
+        schedule->n_cells = 0;
+        return false;
+    }
+    _schedule_vars.active_schedule_ptr = schedule;
+    _activate_schedule();
+    return true;
+}
+
+bool bl_scheduler_is_schedule_available(uint8_t schedule_id, const bl_schedule_descriptor_t *descriptor) {
+    if (schedule_id == BLINK_SCHEDULE_ID_GENERATED) {
+        return bl_generator_is_valid(descriptor);
+    }
+    return _find_schedule(schedule_id) != NULL;
 }
 
 // ------------ node functions ------------
 
 // to be called at the NODE when processing a JOIN_RESPONSE
 bool bl_scheduler_node_assign_myself_to_cell(uint16_t cell_index) {
-    for (size_t i = 0; i < _schedule_vars.active_schedule_ptr->n_cells; i++) {
-        cell_t *cell = &_schedule_vars.active_schedule_ptr->cells[i];
-        if (cell->type == SLOT_TYPE_UPLINK && i == cell_index) {
-            cell->assigned_node_id = bl_device_id();
-            return true;
-        }
+    if (!_is_uplink_cell(cell_index)) {
+        return false;
     }
-    return false;
+    _schedule_vars.node_cell_index = cell_index;
+    _schedule_vars.node_uplink_position = _uplink_position(cell_index);
+    return true;
 }
 
 void bl_scheduler_node_deassign_myself_from_schedule(void) {
-    for (size_t i = 0; i < _schedule_vars.active_schedule_ptr->n_cells; i++) {
-        cell_t *cell = &_schedule_vars.active_schedule_ptr->cells[i];
-        if (cell->type == SLOT_TYPE_UPLINK && cell->assigned_node_id == bl_device_id()) {
-            cell->assigned_node_id = NULL;
-            cell->last_received_asn = 0;
+    _schedule_vars.node_cell_index = -1;
+    _node_clear_extra_cells();
+}
+
+// to be called at the NODE when processing a beacon of its gateway
+bool bl_scheduler_node_set_next_schedule(uint8_t schedule_id, uint64_t switch_asn) {
+    if (switch_asn == 0) {
+        _schedule_vars.next_schedule_ptr = NULL;
+        _schedule_vars.switch_asn = 0;
+        return true;
+    }
+    const schedule_t *next = _find_schedule(schedule_id);
+    if (next == NULL) {
+        return false;
+    }
+    _schedule_vars.next_schedule_ptr = next;
+    _schedule_vars.switch_asn = switch_asn;
+    return true;
+}
+
+// to be called at the NODE when processing a beacon of its gateway
+void bl_scheduler_node_set_channel_blacklist(uint64_t blacklist, uint64_t next_blacklist, uint64_t switch_asn) {
+    if (blacklist != _schedule_vars.channel_blacklist) {
+        // just synchronized, or missed the announcement
+        _set_channel_blacklist(blacklist);
+    }
+    _schedule_vars.next_channel_blacklist = next_blacklist;
+    _schedule_vars.channel_switch_asn = switch_asn;
+}
+
+// to be called at the NODE when processing a CELL_MOVE
+bool bl_scheduler_node_move_myself_to_cell(uint8_t schedule_id, uint16_t cell_index) {
+    if (schedule_id == _schedule_vars.active_schedule_ptr->id) {
+        // sent before the switch, but received after it
+        return bl_scheduler_node_assign_myself_to_cell(cell_index);
+    }
+    // keep the current cell until the switch
+    _schedule_vars.node_moved_schedule_id = schedule_id;
+    _schedule_vars.node_moved_cell_index = cell_index;
+    return true;
+}
+
+// to be called at the NODE when processing a BANDWIDTH_GRANT
+bool bl_scheduler_node_set_extra_cells(uint8_t schedule_id, const uint16_t *cell_indexes, uint8_t n_cells) {
+    if (schedule_id != _schedule_vars.active_schedule_ptr->id || _schedule_vars.node_cell_index < 0) {
+        // granted before a schedule switch, or after leaving
+        return false;
+    }
+    if (_schedule_vars.node_extra_requested == 0 && n_cells > 0) {
+        // late answer to a request sent before the cells were released
+        return false;
+    }
+    uint8_t len = 0;
+    for (size_t i = 0; i < n_cells && len < BLINK_N_EXTRA_UPLINK_CELLS_MAX; i++) {
+        uint16_t cell_index = cell_indexes[i];
+        if (_is_uplink_cell(cell_index) && cell_index != _schedule_vars.node_cell_index && _uplink_position(cell_index) < _schedule_vars.uplinks.len) {
+            _schedule_vars.node_extra_cells[len++] = cell_index;
         }
     }
+    _schedule_vars.node_extra_cells_len = len;
+    _schedule_vars.node_extra_idle = 0;
+    return true;
+}
+
+// to be called at the NODE in each of its uplink cells
+int16_t bl_scheduler_node_update_bandwidth(uint8_t backlog, bool has_sent, uint64_t asn) {
+    uint8_t len = _schedule_vars.node_extra_cells_len;
+    if (_schedule_vars.node_in_extra_cell) {
+        _schedule_vars.node_extra_idle = has_sent ? 0 : _schedule_vars.node_extra_idle + 1;
+    }
+    if (len > 0 && _schedule_vars.node_extra_idle >= len * BLINK_BANDWIDTH_IDLE_SLOTFRAMES) {
+        // stop using them now, the gateway hands them out again when it gets the request
+        _node_clear_extra_cells();
+        _schedule_vars.node_extra_request_asn = asn;
+        return 0;
+    }
+
+    uint8_t wanted = backlog < BLINK_N_EXTRA_UPLINK_CELLS_MAX ? backlog : BLINK_N_EXTRA_UPLINK_CELLS_MAX;
+    uint64_t request_period = BLINK_BANDWIDTH_REQUEST_SLOTFRAMES * _schedule_vars.active_schedule_ptr->n_cells;
+    bool can_request = _schedule_vars.node_extra_requested == 0 || asn - _schedule_vars.node_extra_request_asn >= request_period;
+    if (wanted > len && can_request) {
+        _schedule_vars.node_extra_requested = wanted;
+        _schedule_vars.node_extra_request_asn = asn;
+        return wanted;
+    }
+    return -1;
+}
+
+int16_t bl_scheduler_node_get_uplink_position(void) {
+    return _schedule_vars.node_cell_index >= 0 ? _schedule_vars.node_uplink_position : -1;
+}
+
+bool bl_scheduler_node_in_extra_cell(void) {
+    return _schedule_vars.node_in_extra_cell;
+}
+
+uint8_t bl_scheduler_node_get_extra_cells_count(void) {
+    return _schedule_vars.node_extra_cells_len;
 }
 
 // ------------ gateway functions ---------
 
 // to be called at the GATEWAY when processing a JOIN_REQUEST
 int16_t bl_scheduler_gateway_assign_next_available_uplink_cell(uint64_t node_id, uint64_t asn) {
-    for (size_t i = 0; i < _schedule_vars.active_schedule_ptr->n_cells; i++) {
-        cell_t *cell = &_schedule_vars.active_schedule_ptr->cells[i];
-        // normally the cell is available if empty, but it may also be that case that
-        // the node just temporarily lost connection, so we can just re-assign the same cell_id
-        if (cell->type == SLOT_TYPE_UPLINK && (cell->assigned_node_id == NULL || cell->assigned_node_id == node_id)) {
-            cell->assigned_node_id = node_id;
-            cell->last_received_asn = asn;
-            _schedule_vars.num_assigned_uplink_nodes++;
-            return i;
-        }
+    bl_uplink_cells_t *uplinks = &_schedule_vars.uplinks;
+
+    // the node may already have a cell, e.g. if it did not receive the join response, in that case just re-assign the same cell_id
+    int16_t uplink = _find_uplink(node_id);
+    if (uplink >= 0) {
+        uplinks->last_received_asn[uplink] = asn;
+        // the node starts over without extra cells
+        _release_extra_cells(uplink);
+        return _uplink_cell_index(uplink);
     }
-    return -1;
+
+    int16_t i = _take_free_uplink();
+    if (i < 0) {
+        return -1;
+    }
+    uplinks->node_id[i] = node_id;
+    uplinks->last_received_asn[i] = asn;
+    _schedule_vars.num_assigned_uplink_nodes++;
+    _schedule_vars.node_index[_node_index_find(node_id)] = i + 1;
+    bl_stats_gateway_node_joined(i, node_id);
+    return _uplink_cell_index(i);
 }
 
 // to be called at the GATEWAY when a node leaves
@@ -129,56 +396,300 @@ inline void bl_scheduler_gateway_decrease_nodes_counter(void) {
     _schedule_vars.num_assigned_uplink_nodes--;
 }
 
-// to be called at the GATEWAY to build a beacon
-uint8_t bl_scheduler_gateway_remaining_capacity(void) {
-    // TODO: can be optimized, if we pre-compute the number of uplink slots in a schedule
-    uint8_t remaining_capacity = 0;
-    for (size_t i = 0; i < _schedule_vars.active_schedule_ptr->n_cells; i++) {
-        cell_t *cell = &_schedule_vars.active_schedule_ptr->cells[i];
-        if (cell->type == SLOT_TYPE_UPLINK && cell->assigned_node_id == NULL) {
-            remaining_capacity++;
+// to be called at the GATEWAY when a node leaves
+bool bl_scheduler_gateway_remove_node(uint64_t node_id) {
+    int16_t uplink = _find_uplink(node_id);
+    if (uplink < 0) {
+        return false;
+    }
+    _release_extra_cells(uplink);
+    _node_index_remove(node_id);
+    _schedule_vars.uplinks.node_id[uplink] = 0;
+    _schedule_vars.uplinks.last_received_asn[uplink] = 0;
+    _schedule_vars.uplink_free[uplink / 32] |= 0x80000000UL >> (uplink % 32);
+    bl_scheduler_gateway_decrease_nodes_counter();
+    return true;
+}
+
+// to be called at the GATEWAY for every packet received, in constant time
+int16_t bl_scheduler_gateway_find_node(uint64_t node_id) {
+    int16_t uplink = _find_uplink(node_id);
+    if (uplink < 0) {
+        return -1;
+    }
+    return _uplink_cell_index(uplink);
+}
+
+int16_t bl_scheduler_gateway_find_uplink_position(uint64_t node_id) {
+    return _find_uplink(node_id);
+}
+
+bool bl_scheduler_gateway_keep_node_alive(uint64_t node_id, uint64_t asn) {
+    int16_t uplink = _find_uplink(node_id);
+    if (uplink < 0) {
+        return false;
+    }
+    _schedule_vars.uplinks.last_received_asn[uplink] = asn;
+    return true;
+}
+
+// to be called at the GATEWAY when processing a BANDWIDTH_REQUEST
+int16_t bl_scheduler_gateway_grant_bandwidth(uint64_t node_id, uint8_t n_cells, uint16_t *cell_indexes) {
+    bl_uplink_cells_t *uplinks = &_schedule_vars.uplinks;
+    int16_t uplink = _find_uplink(node_id);
+    if (uplink < 0) {
+        return -1;
+    }
+    if (n_cells == 0) {
+        _release_extra_cells(uplink);
+        return 0;
+    }
+
+    // cells are never taken back here, the node may be using some that it was granted before
+    uint8_t count = 0;
+    for (size_t i = 0; i < uplinks->len && count < BLINK_N_EXTRA_UPLINK_CELLS_MAX; i++) {
+        if (uplinks->owner[i] == uplink + 1) {
+            cell_indexes[count++] = _uplink_cell_index(i);
         }
     }
+    if (n_cells > BLINK_N_EXTRA_UPLINK_CELLS_MAX) {
+        n_cells = BLINK_N_EXTRA_UPLINK_CELLS_MAX;
+    }
+    while (count < n_cells && _schedule_vars.next_schedule_ptr == NULL && bl_scheduler_gateway_remaining_capacity() > BLINK_BANDWIDTH_RESERVED_CELLS) {
+        int16_t i = _take_free_uplink();
+        uplinks->owner[i] = uplink + 1;
+        cell_indexes[count++] = _uplink_cell_index(i);
+        BL_STATS_INC(extra_cells_granted);
+    }
+    return count;
+}
+
+const bl_uplink_cells_t *bl_scheduler_gateway_get_uplinks(void) {
+    return &_schedule_vars.uplinks;
+}
+
+// to be called at the GATEWAY to build a beacon
+uint16_t bl_scheduler_gateway_remaining_capacity(void) {
+    uint16_t remaining_capacity = 0;
+    for (size_t w = 0; w < BLINK_UPLINK_BITMAP_WORDS; w++) {
+        remaining_capacity += __builtin_popcount(_schedule_vars.uplink_free[w]);
+    }
     return remaining_capacity;
 }
 
 // to be called at the GATEWAY to build a beacon
-uint8_t bl_scheduler_gateway_get_nodes_count(void) {
+uint16_t bl_scheduler_gateway_get_nodes_count(void) {
     return _schedule_vars.num_assigned_uplink_nodes;
 }
 
-uint8_t bl_scheduler_gateway_get_nodes(uint64_t *nodes) {
-    uint8_t count = 0;
-    for (size_t i = 0; i < _schedule_vars.active_schedule_ptr->n_cells; i++) {
-        cell_t *cell = &_schedule_vars.active_schedule_ptr->cells[i];
-        if (cell->type == SLOT_TYPE_UPLINK && cell->assigned_node_id != NULL) {
-            nodes[count++] = cell->assigned_node_id;
+uint16_t bl_scheduler_gateway_get_nodes(uint64_t *nodes) {
+    uint16_t count = 0;
+    for (size_t i = 0; i < _schedule_vars.uplinks.len; i++) {
+        if (_schedule_vars.uplinks.node_id[i] != 0) {
+            nodes[count++] = _schedule_vars.uplinks.node_id[i];
         }
     }
     return count;
 }
 
+bool bl_scheduler_gateway_switch_schedule(uint8_t schedule_id, uint64_t switch_asn) {
+    const schedule_t *next = _find_schedule(schedule_id);
+    if (_schedule_vars.next_schedule_ptr != NULL || next == NULL || next == _schedule_vars.active_schedule_ptr) {
+        return false;
+    }
+    bl_uplink_cells_t *uplinks = &_schedule_vars.uplinks;
+    uint16_t next_len = _schedule_uplink_len(next);
+
+    // the nodes beyond the next schedule need free cells within it, extra cells are not taken back for them
+    size_t n_to_move = 0, n_free = 0;
+    for (size_t i = 0; i < uplinks->len; i++) {
+        if (i >= next_len) {
+            n_to_move += uplinks->node_id[i] != 0;
+        } else {
+            n_free += (_schedule_vars.uplink_free[i / 32] >> (31 - i % 32)) & 1;
+        }
+    }
+    if (n_to_move > n_free) {
+        return false;
+    }
+
+    // from now on, only hand out cells that also exist in the next schedule
+    for (size_t i = next_len; i < uplinks->len; i++) {
+        _schedule_vars.uplink_free[i / 32] &= ~(0x80000000UL >> (i % 32));
+        // extra cells beyond it are dropped at the switch, by the nodes too
+        uplinks->owner[i] = 0;
+    }
+
+    // nodes keep the position of their cell among the uplink cells, those beyond the next schedule get a free one
+    uint8_t packet[BLINK_PACKET_MAX_SIZE];
+    for (size_t i = next_len; i < uplinks->len; i++) {
+        uint64_t node_id = uplinks->node_id[i];
+        if (node_id == 0) {
+            continue;
+        }
+        int16_t to = _take_free_uplink(); // there are fewer nodes than cells in the next schedule
+        _schedule_vars.node_index[_node_index_find(node_id)] = to + 1;
+        uplinks->node_id[to] = node_id;
+        uplinks->last_received_asn[to] = uplinks->last_received_asn[i];
+        for (size_t j = 0; j < next_len; j++) {
+            if (uplinks->owner[j] == i + 1) {
+                uplinks->owner[j] = to + 1;
+            }
+        }
+        uplinks->node_id[i] = 0;
+        uplinks->last_received_asn[i] = 0;
+        bl_stats_gateway_node_moved(i, to);
+        bl_queue_gateway_node_moved(i, to);
+
+        uint8_t len = bl_build_packet_cell_move(packet, node_id, next->id, _schedule_uplink_cell_index(next, to));
+        bl_queue_add_priority(packet, len, BLINK_PRIORITY_CONTROL, 0);
+        BL_STATS_INC(cell_moves);
+    }
+
+    _schedule_vars.next_schedule_ptr = next;
+    _schedule_vars.switch_asn = switch_asn;
+    return true;
+}
+
+void bl_scheduler_gateway_set_elastic(bool enabled) {
+    _schedule_vars.is_elastic = enabled;
+}
+
+void bl_scheduler_gateway_update_elastic_schedule(uint64_t asn) {
+    if (!_schedule_vars.is_elastic || _schedule_vars.node_type != BLINK_GATEWAY || _schedule_vars.next_schedule_ptr != NULL) {
+        return;
+    }
+    if (_schedule_vars.is_generated) {
+        // a generated schedule is sized by the application, keep it
+        return;
+    }
+    // cells taken by the nodes and their extra cells
+    uint16_t n_free = bl_scheduler_gateway_remaining_capacity();
+    uint16_t n_used = _schedule_vars.uplinks.len - n_free;
+    uint16_t n_wanted = n_used + 2 * BLINK_ELASTIC_SPARE_CELLS;
+
+    // the smallest schedule with n_wanted uplink cells, or else the largest one
+    const schedule_t *target = NULL;
+    uint16_t target_len = 0;
+    for (size_t i = 0; i < _schedule_vars.available_schedules_len; i++) {
+        const schedule_t *schedule = _schedule_vars.available_schedules[i];
+        uint16_t len = schedule->max_nodes < BLINK_N_UPLINK_CELLS_MAX ? schedule->max_nodes : BLINK_N_UPLINK_CELLS_MAX;
+        bool is_better = target_len >= n_wanted ? (len >= n_wanted && len < target_len) : len > target_len;
+        if (target == NULL || is_better) {
+            target = schedule;
+            target_len = len;
+        }
+    }
+
+    uint16_t len = _schedule_vars.uplinks.len;
+    bool grow = n_free < BLINK_ELASTIC_SPARE_CELLS && target_len > len;
+    bool shrink = target_len < len && target_len >= n_wanted;
+    if (grow || shrink) {
+        bl_scheduler_gateway_switch_schedule(target->id, asn + BLINK_SCHEDULE_SWITCH_SLOTFRAMES * _schedule_vars.active_schedule_ptr->n_cells);
+    }
+}
+
+// to be called at the GATEWAY at the end of each uplink slot, from the radio and timer interrupts
+void bl_scheduler_gateway_channel_outcome(uint16_t uplink_position, uint8_t channel, bool received) {
+    if (uplink_position >= _schedule_vars.uplinks.len || _schedule_vars.uplinks.node_id[uplink_position] == 0 || channel >= BLINK_N_BLE_REGULAR_CHANNELS) {
+        // nothing is expected in free cells
+        return;
+    }
+    if (_schedule_vars.channel_attempts[channel] == BLINK_CHANNEL_HISTORY) {
+        // forget the oldest slots, to follow changes
+        _schedule_vars.channel_attempts[channel] /= 2;
+        _schedule_vars.channel_received[channel] /= 2;
+    }
+    _schedule_vars.channel_attempts[channel]++;
+    _schedule_vars.channel_received[channel] += received;
+}
+
+void bl_scheduler_gateway_update_channel_blacklist(uint64_t asn) {
+#if(BLINK_CHANNEL_BLACKLIST_ENABLED == 0)
+    return;
+#endif
+    if (_schedule_vars.node_type != BLINK_GATEWAY || _schedule_vars.channel_switch_asn != 0 || asn < _schedule_vars.channel_update_asn) {
+        return;
+    }
+    uint16_t n_cells = _schedule_vars.active_schedule_ptr->n_cells;
+    _schedule_vars.channel_update_asn = asn + n_cells;
+
+    // the reference is the upper quartile of the reception ratios, 16-bit fixed point, so that it holds even when most channels are jammed
+    uint32_t ratios[BLINK_N_BLE_REGULAR_CHANNELS];
+    size_t n_ratios = 0;
+    for (size_t channel = 0; channel < BLINK_N_BLE_REGULAR_CHANNELS; channel++) {
+        uint16_t attempts = _schedule_vars.channel_attempts[channel];
+        if ((_schedule_vars.channel_blacklist & (1ULL << channel)) || attempts < BLINK_CHANNEL_MIN_ATTEMPTS) {
+            continue;
+        }
+        uint32_t ratio = ((uint32_t)_schedule_vars.channel_received[channel] << 16) / attempts;
+        size_t i = n_ratios++;
+        for (; i > 0 && ratios[i - 1] > ratio; i--) {
+            ratios[i] = ratios[i - 1];
+        }
+        ratios[i] = ratio;
+    }
+    if (n_ratios == 0) {
+        return;
+    }
+    uint32_t reference = ratios[n_ratios * 3 / 4];
+
+    uint64_t blacklist = _schedule_vars.channel_blacklist;
+    for (size_t channel = 0; channel < BLINK_N_BLE_REGULAR_CHANNELS; channel++) {
+        uint64_t bit = 1ULL << channel;
+        if (blacklist & bit) {
+            if (asn >= _schedule_vars.channel_banned_until[channel]) {
+                // try it again, from scratch
+                blacklist &= ~bit;
+                _schedule_vars.channel_attempts[channel] = 0;
+                _schedule_vars.channel_received[channel] = 0;
+            }
+            continue;
+        }
+        // packets the channel would have received, if it were as good as the reference
+        uint32_t expected = ((uint64_t)_schedule_vars.channel_attempts[channel] * reference) >> 16;
+        bool is_bad = expected >= BLINK_CHANNEL_MIN_EXPECTED && (uint32_t)_schedule_vars.channel_received[channel] * BLINK_CHANNEL_BAD_RATIO < expected;
+        if (is_bad && __builtin_popcountll(blacklist) < BLINK_N_BLE_REGULAR_CHANNELS - BLINK_CHANNEL_MIN_WHITELISTED) {
+            blacklist |= bit;
+            _schedule_vars.channel_banned_until[channel] = asn + BLINK_CHANNEL_BAN_SLOTFRAMES * n_cells;
+            _schedule_vars.channel_attempts[channel] = 0;
+            _schedule_vars.channel_received[channel] = 0;
+        }
+    }
+
+    if (blacklist != _schedule_vars.channel_blacklist) {
+        // announced like a schedule switch, the asn last since it marks the change as planned
+        _schedule_vars.next_channel_blacklist = blacklist;
+        _schedule_vars.channel_switch_asn = asn + BLINK_SCHEDULE_SWITCH_SLOTFRAMES * n_cells;
+    }
+}
+
 // ------------ general functions ---------
 
 bl_slot_info_t bl_scheduler_tick(uint64_t asn) {
-    // get the current cell
-    size_t cell_index = asn % (_schedule_vars.active_schedule_ptr)->n_cells;
-    cell_t cell = (_schedule_vars.active_schedule_ptr)->cells[cell_index];
+    if (_schedule_vars.next_schedule_ptr != NULL && asn >= _schedule_vars.switch_asn) {
+        _apply_switch();
+    }
+    if (_schedule_vars.channel_switch_asn != 0 && asn >= _schedule_vars.channel_switch_asn) {
+        _set_channel_blacklist(_schedule_vars.next_channel_blacklist);
+        _schedule_vars.channel_switch_asn = 0;
+        BL_STATS_INC(channel_blacklist_changes);
+    }
+    // slots are normally consecutive, only seek after a (re)synchronization
+    if (asn != _schedule_vars.cursor.asn) {
+        _cursor_seek(&_schedule_vars.cursor, asn);
+    }
+    bl_slot_info_t slot_info = _slot_info(&_schedule_vars.cursor);
+    _cursor_advance(&_schedule_vars.cursor);
+    _schedule_vars.node_in_extra_cell = slot_info.type == SLOT_TYPE_UPLINK && slot_info.radio_action == BLINK_RADIO_ACTION_TX && slot_info.cell_index != _schedule_vars.node_cell_index;
 
-    bl_slot_info_t slot_info = {
-        .radio_action = BLINK_RADIO_ACTION_SLEEP,
-        .channel = bl_scheduler_get_channel(cell.type, asn, cell.channel_offset),
-        .type = cell.type, // FIXME: only for debugging, remove before merge
-    };
-    if (_schedule_vars.node_type == BLINK_GATEWAY) {
-        _compute_gateway_action(cell, &slot_info);
-    } else {
-        _compute_dotbot_action(cell, &slot_info);
+    // the backoff counts join opportunities, which are sparse in long generated schedules
+    if (_schedule_vars.node_type == BLINK_NODE && slot_info.type == SLOT_TYPE_SHARED_UPLINK) {
         bl_assoc_node_tick_backoff();
     }
 
     // if the slotframe wrapped, keep track of how many slotframes have passed (used to cycle beacon channels)
-    if (asn != 0 && cell_index == 0) {
+    if (asn != 0 && slot_info.cell_index == 0) {
         _schedule_vars.slotframe_counter++;
     }
 
@@ -193,7 +704,7 @@ uint8_t bl_scheduler_get_channel(slot_type_t slot_type, uint64_t asn, uint8_t ch
     return BLINK_FIXED_CHANNEL;
 #endif
     if (slot_type == SLOT_TYPE_BEACON) {
-#ifdef BLINK_FIXED_SCAN_CHANNEL
+#if(BLINK_FIXED_SCAN_CHANNEL != 0)
         return BLINK_FIXED_SCAN_CHANNEL;
 #else
         // special handling in case the cell is a beacon
@@ -202,11 +713,12 @@ uint8_t bl_scheduler_get_channel(slot_type_t slot_type, uint64_t asn, uint8_t ch
     } else {
         // As per RFC 7554:
         //   frequency = F {(ASN + channelOffset) mod nFreq}
-        return (asn + channel_offset) % BLINK_N_BLE_REGULAR_CHANNELS;
+        // with F the channels left out of the blacklist, and the offset taken modulo BLINK_N_BLE_REGULAR_CHANNELS like the one of built-in cells
+        return _schedule_vars.channel_map[asn % _schedule_vars.n_channels + channel_offset % BLINK_N_BLE_REGULAR_CHANNELS];
     }
 }
 
-schedule_t *bl_scheduler_get_active_schedule_ptr(void) {
+const schedule_t *bl_scheduler_get_active_schedule_ptr(void) {
     return _schedule_vars.active_schedule_ptr;
 }
 
@@ -214,21 +726,149 @@ uint8_t bl_scheduler_get_active_schedule_id(void) {
     return _schedule_vars.active_schedule_ptr->id;
 }
 
-uint8_t bl_scheduler_get_active_schedule_slot_count(void) {
+uint8_t bl_scheduler_get_next_schedule_id(void) {
+    if (_schedule_vars.next_schedule_ptr == NULL) {
+        return _schedule_vars.active_schedule_ptr->id;
+    }
+    return _schedule_vars.next_schedule_ptr->id;
+}
+
+uint64_t bl_scheduler_get_switch_asn(void) {
+    return _schedule_vars.switch_asn;
+}
+
+uint64_t bl_scheduler_get_channel_blacklist(void) {
+    return _schedule_vars.channel_blacklist;
+}
+
+uint64_t bl_scheduler_get_next_channel_blacklist(void) {
+    if (_schedule_vars.channel_switch_asn == 0) {
+        return _schedule_vars.channel_blacklist;
+    }
+    return _schedule_vars.next_channel_blacklist;
+}
+
+uint64_t bl_scheduler_get_channel_switch_asn(void) {
+    return _schedule_vars.channel_switch_asn;
+}
+
+uint16_t bl_scheduler_get_active_schedule_slot_count(void) {
     return _schedule_vars.active_schedule_ptr->n_cells;
 }
 
-cell_t bl_scheduler_node_peek_slot(uint64_t asn) {
-    size_t cell_index = (asn) % (_schedule_vars.active_schedule_ptr)->n_cells;
-    cell_t cell = (_schedule_vars.active_schedule_ptr)->cells[cell_index];
+uint16_t bl_scheduler_get_active_schedule_cell_count(slot_type_t type) {
+    const schedule_t *schedule = _schedule_vars.active_schedule_ptr;
+    if (_schedule_vars.is_generated) {
+        switch (type) {
+            case SLOT_TYPE_BEACON:
+                return schedule->descriptor.n_beacons;
+            case SLOT_TYPE_SHARED_UPLINK:
+                return schedule->descriptor.n_shared_uplink;
+            case SLOT_TYPE_DOWNLINK:
+                return schedule->descriptor.n_downlink;
+            default:
+                return schedule->descriptor.n_uplink;
+        }
+    }
+    uint16_t count = 0;
+    for (size_t i = 0; i < schedule->n_cells; i++) {
+        count += schedule->cells[i].type == type;
+    }
+    return count;
+}
+
+bl_slot_info_t bl_scheduler_node_peek_slot(uint64_t asn) {
+    bl_slot_info_t slot_info;
+    bl_scheduler_peek_slots(asn, &slot_info, 1);
+    return slot_info;
+}
 
-    return cell;
+void bl_scheduler_peek_slots(uint64_t asn, bl_slot_info_t *slots, size_t n_slots) {
+    slot_cursor_t cursor = _schedule_vars.cursor;
+    if (asn != cursor.asn) {
+        _cursor_seek(&cursor, asn);
+    }
+    for (size_t i = 0; i < n_slots; i++) {
+        slots[i] = _slot_info(&cursor);
+        _cursor_advance(&cursor);
+    }
 }
 
 //=========================== private ==========================================
 
-void _compute_gateway_action(cell_t cell, bl_slot_info_t *slot_info) {
-    switch (cell.type) {
+static bl_slot_info_t _slot_info(const slot_cursor_t *cursor) {
+    const cell_t *cell = &cursor->generated.cell;
+    uint8_t channel_offset = cursor->generated.cell.channel_offset;
+    uint16_t uplink_position = cursor->generated.uplink_position;
+    if (!_schedule_vars.is_generated) {
+        cell = &_schedule_vars.active_schedule_ptr->cells[cursor->cell_index];
+        channel_offset = _schedule_vars.channel_offsets[cursor->cell_index];
+        uplink_position = _schedule_vars.uplink_positions[cursor->cell_index];
+    }
+
+    bl_slot_info_t slot_info = {
+        .radio_action = BLINK_RADIO_ACTION_SLEEP,
+        .channel = _cursor_channel(cursor, cell->type, channel_offset),
+        .type = cell->type, // FIXME: only for debugging, remove before merge
+        .cell_index = cursor->cell_index,
+        .uplink_position = uplink_position,
+    };
+    if (_schedule_vars.node_type == BLINK_GATEWAY) {
+        _compute_gateway_action(cell, &slot_info);
+    } else {
+        _compute_dotbot_action(cell, &slot_info);
+    }
+    return slot_info;
+}
+
+// the only place with divisions, see bl_scheduler_get_channel for the hopping sequences
+static void _cursor_seek(slot_cursor_t *cursor, uint64_t asn) {
+    cursor->asn = asn;
+    cursor->cell_index = asn % _schedule_vars.active_schedule_ptr->n_cells;
+    cursor->channel_base = asn % _schedule_vars.n_channels;
+    cursor->beacon_channel = asn % BLINK_N_BLE_ADVERTISING_CHANNELS;
+    if (_schedule_vars.is_generated) {
+        bl_generator_cursor_seek(&_schedule_vars.active_schedule_ptr->descriptor, &cursor->generated, cursor->cell_index);
+    }
+}
+
+static inline void _cursor_advance(slot_cursor_t *cursor) {
+    cursor->asn++;
+    if (++cursor->cell_index == _schedule_vars.active_schedule_ptr->n_cells) {
+        cursor->cell_index = 0;
+    }
+    if (++cursor->channel_base == _schedule_vars.n_channels) {
+        cursor->channel_base = 0;
+    }
+    if (++cursor->beacon_channel == BLINK_N_BLE_ADVERTISING_CHANNELS) {
+        cursor->beacon_channel = 0;
+    }
+    if (_schedule_vars.is_generated) {
+        bl_generator_cursor_advance(&_schedule_vars.active_schedule_ptr->descriptor, &cursor->generated);
+    }
+}
+
+// same as bl_scheduler_get_channel, from the cursor
+static inline uint8_t _cursor_channel(const slot_cursor_t *cursor, uint8_t type, uint8_t channel_offset) {
+#if(BLINK_FIXED_CHANNEL != 0)
+    (void)cursor;
+    (void)type;
+    (void)channel_offset;
+    return BLINK_FIXED_CHANNEL;
+#endif
+    if (type == SLOT_TYPE_BEACON) {
+#if(BLINK_FIXED_SCAN_CHANNEL != 0)
+        return BLINK_FIXED_SCAN_CHANNEL;
+#else
+        return BLINK_N_BLE_REGULAR_CHANNELS + cursor->beacon_channel;
+#endif
+    }
+    // both terms are below BLINK_N_BLE_REGULAR_CHANNELS
+    return _schedule_vars.channel_map[cursor->channel_base + channel_offset];
+}
+
+void _compute_gateway_action(const cell_t *cell, bl_slot_info_t *slot_info) {
+    switch (cell->type) {
         case SLOT_TYPE_BEACON:
         case SLOT_TYPE_DOWNLINK:
             slot_info->radio_action = BLINK_RADIO_ACTION_TX;
@@ -240,8 +880,8 @@ void _compute_gateway_action(cell_t cell, bl_slot_info_t *slot_info) {
     }
 }
 
-void _compute_dotbot_action(cell_t cell, bl_slot_info_t *slot_info) {
-    switch (cell.type) {
+void _compute_dotbot_action(const cell_t *cell, bl_slot_info_t *slot_info) {
+    switch (cell->type) {
         case SLOT_TYPE_BEACON:
         case SLOT_TYPE_DOWNLINK:
             slot_info->radio_action = BLINK_RADIO_ACTION_RX;
@@ -250,7 +890,7 @@ void _compute_dotbot_action(cell_t cell, bl_slot_info_t *slot_info) {
             slot_info->radio_action = BLINK_RADIO_ACTION_TX;
             break;
         case SLOT_TYPE_UPLINK:
-            if (cell.assigned_node_id == bl_device_id()) {
+            if (slot_info->cell_index == _schedule_vars.node_cell_index || _node_owns_extra_cell(slot_info->cell_index)) {
                 slot_info->radio_action = BLINK_RADIO_ACTION_TX;
             } else {
                 slot_info->radio_action = BLINK_RADIO_ACTION_SLEEP;
@@ -260,3 +900,299 @@ void _compute_dotbot_action(cell_t cell, bl_slot_info_t *slot_info) {
             break;
     }
 }
+
+// to be called when the active schedule changes, which then starts with all its uplink cells free
+static void _activate_schedule(void) {
+    bl_uplink_cells_t *uplinks = &_schedule_vars.uplinks;
+
+    memset(uplinks, 0, sizeof(*uplinks));
+    memset(_schedule_vars.uplink_free, 0, sizeof(_schedule_vars.uplink_free));
+    memset(_schedule_vars.node_index, BLINK_NODE_INDEX_EMPTY, sizeof(_schedule_vars.node_index));
+    _schedule_vars.num_assigned_uplink_nodes = 0;
+    _schedule_vars.node_cell_index = -1;
+    _schedule_vars.node_moved_cell_index = -1;
+    _node_clear_extra_cells();
+    _schedule_vars.next_schedule_ptr = NULL;
+    _schedule_vars.switch_asn = 0;
+    if (_schedule_vars.active_schedule_ptr == NULL) {
+        return;
+    }
+
+    _load_schedule();
+    for (size_t i = 0; i < uplinks->len; i++) {
+        _schedule_vars.uplink_free[i / 32] |= 0x80000000UL >> (i % 32);
+    }
+}
+
+// computes the tables of the active schedule, and leaves the assignments untouched
+static void _load_schedule(void) {
+    const schedule_t *schedule = _schedule_vars.active_schedule_ptr;
+    bl_uplink_cells_t *uplinks = &_schedule_vars.uplinks;
+
+    // generated schedules are walked by the cursor, built-in ones get their hopping and uplink tables
+    _schedule_vars.is_generated = schedule->id == BLINK_SCHEDULE_ID_GENERATED;
+    uplinks->len = 0;
+    if (_schedule_vars.is_generated) {
+        uplinks->len = schedule->descriptor.n_uplink < BLINK_N_UPLINK_CELLS_MAX ? schedule->descriptor.n_uplink : BLINK_N_UPLINK_CELLS_MAX;
+    } else {
+        for (size_t i = 0; i < schedule->n_cells; i++) {
+            _schedule_vars.channel_offsets[i] = schedule->cells[i].channel_offset % BLINK_N_BLE_REGULAR_CHANNELS;
+            _schedule_vars.uplink_positions[i] = 0;
+            if (schedule->cells[i].type == SLOT_TYPE_UPLINK && uplinks->len < BLINK_N_UPLINK_CELLS_MAX) {
+                _schedule_vars.uplink_positions[i] = uplinks->len;
+                _schedule_vars.uplink_cells[uplinks->len++] = i;
+            }
+        }
+    }
+    _cursor_seek(&_schedule_vars.cursor, _schedule_vars.cursor.asn);
+}
+
+// at the first slot of the next schedule, see bl_scheduler_gateway_switch_schedule
+// to be called when the data channels change, on both sides at the same slot
+static void _set_channel_blacklist(uint64_t blacklist) {
+    uint8_t n_channels = 0;
+    for (uint8_t channel = 0; channel < BLINK_N_BLE_REGULAR_CHANNELS; channel++) {
+        if (!(blacklist & (1ULL << channel))) {
+            _schedule_vars.channel_map[n_channels++] = channel;
+        }
+    }
+    if (n_channels == 0) {
+        // not a valid blacklist, hop on all the channels
+        blacklist = 0;
+        for (uint8_t channel = 0; channel < BLINK_N_BLE_REGULAR_CHANNELS; channel++) {
+            _schedule_vars.channel_map[n_channels++] = channel;
+        }
+    }
+    for (size_t i = n_channels; i < 2 * BLINK_N_BLE_REGULAR_CHANNELS; i++) {
+        _schedule_vars.channel_map[i] = _schedule_vars.channel_map[i - n_channels];
+    }
+    _schedule_vars.channel_blacklist = blacklist;
+    _schedule_vars.n_channels = n_channels;
+
+    // the position in the hopping sequence depends on the number of channels
+    if (_schedule_vars.active_schedule_ptr != NULL) {
+        _cursor_seek(&_schedule_vars.cursor, _schedule_vars.cursor.asn);
+    }
+}
+
+static void _apply_switch(void) {
+    bl_uplink_cells_t *uplinks = &_schedule_vars.uplinks;
+    const schedule_t *next = _schedule_vars.next_schedule_ptr;
+    int16_t node_cell_index = _schedule_vars.node_cell_index;
+    uint16_t node_uplink_position = node_cell_index >= 0 ? _uplink_position(node_cell_index) : 0;
+    uint64_t switch_asn = _schedule_vars.switch_asn;
+    uint16_t extra_positions[BLINK_N_EXTRA_UPLINK_CELLS_MAX];
+    for (size_t i = 0; i < _schedule_vars.node_extra_cells_len; i++) {
+        extra_positions[i] = _uplink_position(_schedule_vars.node_extra_cells[i]);
+    }
+
+    _schedule_vars.active_schedule_ptr = next;
+    _schedule_vars.next_schedule_ptr = NULL;
+    _schedule_vars.switch_asn = 0;
+    _load_schedule();
+    BL_STATS_INC(schedule_switches);
+
+    if (_schedule_vars.node_type == BLINK_GATEWAY) {
+        // the nodes beyond the next schedule were moved when the switch was planned
+        memset(_schedule_vars.uplink_free, 0, sizeof(_schedule_vars.uplink_free));
+        for (size_t i = 0; i < uplinks->len; i++) {
+            if (uplinks->node_id[i] == 0 && uplinks->owner[i] == 0) {
+                _schedule_vars.uplink_free[i / 32] |= 0x80000000UL >> (i % 32);
+            } else if (uplinks->node_id[i] != 0) {
+                // the timeouts are counted in slotframes, restart them with the new slotframe length
+                uplinks->last_received_asn[i] = switch_asn;
+            }
+        }
+        // a pending join response points to a cell of the previous schedule, the node will ask again
+        bl_queue_clear_join_packet();
+        return;
+    }
+
+    if (node_cell_index < 0) {
+        return;
+    }
+    bl_assoc_node_keep_gateway_alive(switch_asn);
+    bool is_assigned;
+    if (_schedule_vars.node_moved_cell_index >= 0 && _schedule_vars.node_moved_schedule_id == next->id) {
+        is_assigned = bl_scheduler_node_assign_myself_to_cell(_schedule_vars.node_moved_cell_index);
+    } else {
+        is_assigned = node_uplink_position < uplinks->len && bl_scheduler_node_assign_myself_to_cell(_uplink_cell_index(node_uplink_position));
+    }
+    _schedule_vars.node_moved_cell_index = -1;
+    if (!is_assigned) {
+        // the CELL_MOVE was lost
+        _schedule_vars.node_cell_index = -1;
+        _node_clear_extra_cells();
+        bl_assoc_node_handle_cell_lost();
+        return;
+    }
+
+    // like the gateway, keep the extra cells that exist in the next schedule
+    uint8_t extra_len = 0;
+    for (size_t i = 0; i < _schedule_vars.node_extra_cells_len; i++) {
+        if (extra_positions[i] < uplinks->len) {
+            _schedule_vars.node_extra_cells[extra_len++] = _uplink_cell_index(extra_positions[i]);
+        }
+    }
+    _schedule_vars.node_extra_cells_len = extra_len;
+}
+
+static const schedule_t *_find_schedule(uint8_t schedule_id) {
+    for (size_t i = 0; i < _schedule_vars.available_schedules_len; i++) {
+        if (_schedule_vars.available_schedules[i]->id == schedule_id) {
+            return _schedule_vars.available_schedules[i];
+        }
+    }
+    return NULL;
+}
+
+// number of uplink cells of any schedule, as _load_schedule would count them
+static uint16_t _schedule_uplink_len(const schedule_t *schedule) {
+    size_t len = 0;
+    if (schedule->id == BLINK_SCHEDULE_ID_GENERATED) {
+        len = schedule->descriptor.n_uplink;
+    } else {
+        for (size_t i = 0; i < schedule->n_cells; i++) {
+            len += schedule->cells[i].type == SLOT_TYPE_UPLINK;
+        }
+    }
+    return len < BLINK_N_UPLINK_CELLS_MAX ? len : BLINK_N_UPLINK_CELLS_MAX;
+}
+
+// index in any schedule of the uplink cell at a position, linear for built-in schedules
+static uint16_t _schedule_uplink_cell_index(const schedule_t *schedule, uint16_t uplink_position) {
+    if (schedule->id == BLINK_SCHEDULE_ID_GENERATED) {
+        return bl_generator_uplink_cell_index(&schedule->descriptor, uplink_position);
+    }
+    for (size_t i = 0; i < schedule->n_cells; i++) {
+        if (schedule->cells[i].type == SLOT_TYPE_UPLINK && uplink_position-- == 0) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+// index in the active schedule of the uplink cell at a position
+static uint16_t _uplink_cell_index(size_t uplink_position) {
+    if (_schedule_vars.is_generated) {
+        return bl_generator_uplink_cell_index(&_schedule_vars.active_schedule_ptr->descriptor, uplink_position);
+    }
+    return _schedule_vars.uplink_cells[uplink_position];
+}
+
+// position among the uplink cells of an uplink cell of the active schedule
+static uint16_t _uplink_position(uint16_t cell_index) {
+    if (_schedule_vars.is_generated) {
+        bl_generator_cursor_t cursor;
+        bl_generator_cursor_seek(&_schedule_vars.active_schedule_ptr->descriptor, &cursor, cell_index);
+        return cursor.uplink_position;
+    }
+    return _schedule_vars.uplink_positions[cell_index];
+}
+
+// marks the first free uplink cell as taken, and returns its position, or -1 if there is none
+static int16_t _take_free_uplink(void) {
+    for (size_t w = 0; w < BLINK_UPLINK_BITMAP_WORDS; w++) {
+        uint32_t free_cells = _schedule_vars.uplink_free[w];
+        if (free_cells == 0) {
+            continue;
+        }
+        size_t bit = __builtin_clz(free_cells);
+        _schedule_vars.uplink_free[w] &= ~(0x80000000UL >> bit);
+        return w * 32 + bit;
+    }
+    return -1;
+}
+
+// whether a cell of the active schedule exists and is an uplink cell
+static bool _is_uplink_cell(uint16_t cell_index) {
+    const schedule_t *schedule = _schedule_vars.active_schedule_ptr;
+    if (cell_index >= schedule->n_cells) {
+        return false;
+    }
+    if (_schedule_vars.is_generated) {
+        bl_generator_cursor_t cursor;
+        bl_generator_cursor_seek(&schedule->descriptor, &cursor, cell_index);
+        return cursor.cell.type == SLOT_TYPE_UPLINK;
+    }
+    return schedule->cells[cell_index].type == SLOT_TYPE_UPLINK;
+}
+
+// frees the extra cells of the node at an uplink position
+static void _release_extra_cells(int16_t uplink) {
+    bl_uplink_cells_t *uplinks = &_schedule_vars.uplinks;
+    for (size_t i = 0; i < uplinks->len; i++) {
+        if (uplinks->owner[i] == uplink + 1) {
+            uplinks->owner[i] = 0;
+            _schedule_vars.uplink_free[i / 32] |= 0x80000000UL >> (i % 32);
+        }
+    }
+}
+
+static bool _node_owns_extra_cell(uint16_t cell_index) {
+    for (size_t i = 0; i < _schedule_vars.node_extra_cells_len; i++) {
+        if (_schedule_vars.node_extra_cells[i] == cell_index) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void _node_clear_extra_cells(void) {
+    _schedule_vars.node_extra_cells_len = 0;
+    _schedule_vars.node_extra_requested = 0;
+    _schedule_vars.node_extra_idle = 0;
+}
+
+// returns the position of the uplink cell of node_id in _schedule_vars.uplinks, or -1
+static int16_t _find_uplink(uint64_t node_id) {
+    if (node_id == 0) {
+        return -1;
+    }
+    size_t slot = _node_index_find(node_id);
+    if (_schedule_vars.node_index[slot] == BLINK_NODE_INDEX_EMPTY) {
+        return -1;
+    }
+    return _schedule_vars.node_index[slot] - 1;
+}
+
+static inline size_t _node_index_hash(uint64_t node_id) {
+    // device ids are not uniformly distributed in their lower bits, so mix all of them in (Fibonacci hashing)
+    return (size_t)((node_id * 0x9E3779B97F4A7C15ULL) >> (64 - BLINK_NODE_INDEX_BITS));
+}
+
+// returns the entry holding node_id, or the empty entry where it would be inserted
+static size_t _node_index_find(uint64_t node_id) {
+    size_t slot = _node_index_hash(node_id);
+    while (_schedule_vars.node_index[slot] != BLINK_NODE_INDEX_EMPTY) {
+        if (_schedule_vars.uplinks.node_id[_schedule_vars.node_index[slot] - 1] == node_id) {
+            break;
+        }
+        slot = (slot + 1) & (BLINK_NODE_INDEX_SIZE - 1);
+    }
+    return slot;
+}
+
+// must be called while the uplink cell still holds node_id
+static void _node_index_remove(uint64_t node_id) {
+    size_t slot = _node_index_find(node_id);
+    if (_schedule_vars.node_index[slot] == BLINK_NODE_INDEX_EMPTY) {
+        return;
+    }
+
+    // backward-shift deletion: move up the following entries that would no longer be reachable, so that no tombstones are needed
+    size_t next = slot;
+    while (true) {
+        next = (next + 1) & (BLINK_NODE_INDEX_SIZE - 1);
+        if (_schedule_vars.node_index[next] == BLINK_NODE_INDEX_EMPTY) {
+            break;
+        }
+        size_t home = _node_index_hash(_schedule_vars.uplinks.node_id[_schedule_vars.node_index[next] - 1]);
+        // the entry can move to the hole if its home is not cyclically in (slot, next]
+        if (((next - home) & (BLINK_NODE_INDEX_SIZE - 1)) >= ((next - slot) & (BLINK_NODE_INDEX_SIZE - 1))) {
+            _schedule_vars.node_index[slot] = _schedule_vars.node_index[next];
+            slot = next;
+        }
+    }
+    _schedule_vars.node_index[slot] = BLINK_NODE_INDEX_EMPTY;
+}
@@ -21,6 +21,14 @@
 
 //=========================== defines ==========================================
 
+/// Assignments of the uplink cells of the active schedule, at the gateway, indexed by the position of the cell among the uplink cells (see bl_slot_info_t)
+typedef struct {
+    uint16_t len;                                           ///< Number of uplink cells in the active schedule, at most BLINK_N_UPLINK_CELLS_MAX
+    uint64_t node_id[BLINK_N_UPLINK_CELLS_MAX];             ///< Node assigned to each uplink cell, 0 if free
+    uint64_t last_received_asn[BLINK_N_UPLINK_CELLS_MAX];   ///< ASN marking the last time the node was heard from
+    uint16_t owner[BLINK_N_UPLINK_CELLS_MAX];               ///< For the extra cells of a node, position of its own cell + 1, 0 otherwise (see bl_scheduler_gateway_grant_bandwidth)
+} bl_uplink_cells_t;
+
 //=========================== prototypes ==========================================
 
 /**
@@ -30,7 +38,7 @@
  *
  * @param[in] schedule         Schedule to be used.
  */
-void bl_scheduler_init(bl_node_type_t node_type, schedule_t *application_schedule);
+void bl_scheduler_init(bl_node_type_t node_type, const schedule_t *application_schedule);
 
 /**
  * @brief Advances the schedule by one cell/slot.
@@ -50,29 +58,246 @@ bl_slot_info_t bl_scheduler_tick(uint64_t asn);
  */
 bool bl_scheduler_set_schedule(uint8_t schedule_id);
 
+/**
+ * @brief Activates a schedule generated from a descriptor, e.g. the one in the beacon of the gateway
+ *
+ * @param[in] descriptor          number of cells of each type, see generator.h
+ *
+ * @return true if the schedule was successfully generated and set, false otherwise
+ */
+bool bl_scheduler_set_generated_schedule(const bl_schedule_descriptor_t *descriptor);
+
+/**
+ * @brief Whether a schedule can be activated, without activating it
+ *
+ * @param[in] schedule_id         Schedule ID, BLINK_SCHEDULE_ID_GENERATED for a generated one
+ * @param[in] descriptor          number of cells of each type, only used for a generated schedule
+ *
+ * @return true if bl_scheduler_set_schedule or bl_scheduler_set_generated_schedule would succeed
+ */
+bool bl_scheduler_is_schedule_available(uint8_t schedule_id, const bl_schedule_descriptor_t *descriptor);
+
 int16_t bl_scheduler_gateway_assign_next_available_uplink_cell(uint64_t node_id, uint64_t asn);
 
 bool bl_scheduler_node_assign_myself_to_cell(uint16_t cell_index);
 
 void bl_scheduler_node_deassign_myself_from_schedule(void);
 
+/**
+ * @brief Follows a schedule switch announced in the beacons of the gateway
+ *
+ * At @p switch_asn, the node keeps the position of its uplink cell among the uplink
+ * cells, unless it received a cell-move for the next schedule.
+ *
+ * @param[in] schedule_id       id of the next schedule, one of the built-in or application schedules
+ * @param[in] switch_asn        first slot of the next schedule, 0 if no switch is planned
+ *
+ * @return false if the next schedule is not known
+ */
+bool bl_scheduler_node_set_next_schedule(uint8_t schedule_id, uint64_t switch_asn);
+
+/**
+ * @brief Follows the data channels announced in the beacons of the gateway
+ *
+ * @param[in] blacklist         data channels the gateway does not hop on, bit i for channel i
+ * @param[in] next_blacklist    blacklist used from @p switch_asn on
+ * @param[in] switch_asn        first slot of the next blacklist, 0 if no change is planned
+ */
+void bl_scheduler_node_set_channel_blacklist(uint64_t blacklist, uint64_t next_blacklist, uint64_t switch_asn);
+
+/**
+ * @brief Moves the uplink cell of the node, when processing a CELL_MOVE
+ *
+ * @param[in] schedule_id       schedule of the cell: the active one, or the next one from the switch on
+ * @param[in] cell_index        index of the cell in that schedule
+ *
+ * @return false if the cell is not an uplink cell of the active schedule
+ */
+bool bl_scheduler_node_move_myself_to_cell(uint8_t schedule_id, uint16_t cell_index);
+
+/**
+ * @brief Adopts the extra uplink cells granted by the gateway, when processing a BANDWIDTH_GRANT
+ *
+ * @param[in] schedule_id       schedule of the cells, the grant is ignored if it is not the active one
+ * @param[in] cell_indexes      all the extra cells of the node
+ * @param[in] n_cells           number of cells, at most BLINK_N_EXTRA_UPLINK_CELLS_MAX
+ *
+ * @return false if the grant was ignored
+ */
+bool bl_scheduler_node_set_extra_cells(uint8_t schedule_id, const uint16_t *cell_indexes, uint8_t n_cells);
+
+/**
+ * @brief Decides whether to ask for extra uplink cells, or to release them, in each uplink cell of the node
+ *
+ * More cells are asked for when more packets are queued than the node has extra cells,
+ * at most every BLINK_BANDWIDTH_REQUEST_SLOTFRAMES. All of them are released, without
+ * waiting for the gateway, when they were left unused for BLINK_BANDWIDTH_IDLE_SLOTFRAMES.
+ *
+ * @param[in] backlog           packets still queued after this slot
+ * @param[in] has_sent          whether something was sent in this slot
+ * @param[in] asn               current slot
+ *
+ * @return the number of extra cells to put in a BANDWIDTH_REQUEST, or -1 if there is no need to send one
+ */
+int16_t bl_scheduler_node_update_bandwidth(uint8_t backlog, bool has_sent, uint64_t asn);
+
+/**
+ * @brief Whether the current slot, the last one returned by bl_scheduler_tick, is an extra uplink cell of the node
+ */
+bool bl_scheduler_node_in_extra_cell(void);
+
+uint8_t bl_scheduler_node_get_extra_cells_count(void);
+
+/**
+ * @brief Position of the uplink cell of the node among the uplink cells, which designates it in aggregated packets
+ *
+ * @return the position, or -1 if the node has no cell
+ */
+int16_t bl_scheduler_node_get_uplink_position(void);
+
 void bl_scheduler_gateway_decrease_nodes_counter(void);
 
-uint8_t bl_scheduler_gateway_remaining_capacity(void);
+/**
+ * @brief Free the uplink cell assigned to a node, and update the nodes counter
+ *
+ * @param[in] node_id       id of the node
+ *
+ * @return true if the node had a cell
+ */
+bool bl_scheduler_gateway_remove_node(uint64_t node_id);
 
-uint8_t bl_scheduler_gateway_get_nodes_count(void);
+/**
+ * @brief Find the uplink cell assigned to a node, in constant time
+ *
+ * @param[in] node_id       id of the node
+ *
+ * @return index of the cell in the active schedule, or -1 if the node is not joined
+ */
+int16_t bl_scheduler_gateway_find_node(uint64_t node_id);
 
-uint8_t bl_scheduler_gateway_get_nodes(uint64_t *nodes);
+/**
+ * @brief Find the position of the uplink cell assigned to a node among the uplink cells, in constant time
+ *
+ * @param[in] node_id       id of the node
+ *
+ * @return position of its own cell (see bl_uplink_cells_t), or -1 if the node is not joined
+ */
+int16_t bl_scheduler_gateway_find_uplink_position(uint64_t node_id);
 
-schedule_t *bl_scheduler_get_active_schedule_ptr(void);
+/**
+ * @brief Save the asn of the last packet received from a node
+ *
+ * @return false if the node is not joined
+ */
+bool bl_scheduler_gateway_keep_node_alive(uint64_t node_id, uint64_t asn);
+
+/**
+ * @brief Gives extra uplink cells to a node, when processing a BANDWIDTH_REQUEST
+ *
+ * Cells are only added, from the free ones, while more than BLINK_BANDWIDTH_RESERVED_CELLS
+ * stay free for joining nodes and no schedule switch is pending. Asking for 0 cells
+ * releases them all.
+ *
+ * @param[in] node_id           id of the node
+ * @param[in] n_cells           extra cells wanted in total
+ * @param[out] cell_indexes     all the extra cells of the node, room for BLINK_N_EXTRA_UPLINK_CELLS_MAX
+ *
+ * @return number of extra cells of the node, or -1 if it is not joined
+ */
+int16_t bl_scheduler_gateway_grant_bandwidth(uint64_t node_id, uint8_t n_cells, uint16_t *cell_indexes);
+
+const bl_uplink_cells_t *bl_scheduler_gateway_get_uplinks(void);
+
+uint16_t bl_scheduler_gateway_remaining_capacity(void);
+
+uint16_t bl_scheduler_gateway_get_nodes_count(void);
+
+uint16_t bl_scheduler_gateway_get_nodes(uint64_t *nodes);
+
+/**
+ * @brief Plans a switch to another schedule, without the nodes having to join again
+ *
+ * Until @p switch_asn, the switch is announced in the beacons, and the nodes whose
+ * uplink cell does not exist in the next schedule are moved to one that does, with
+ * a CELL_MOVE. Nodes joining in the meantime also get such a cell. Extra cells keep
+ * their position too, those beyond the next schedule are dropped at the switch. To be
+ * called from the timer or radio interrupt, see bl_scheduler_gateway_update_elastic_schedule.
+ *
+ * @param[in] schedule_id       id of one of the built-in or application schedules
+ * @param[in] switch_asn        first slot of the next schedule
+ *
+ * @return false if a switch is already planned, or the schedule is unknown or too small for the joined nodes and their extra cells
+ */
+bool bl_scheduler_gateway_switch_schedule(uint8_t schedule_id, uint64_t switch_asn);
+
+/**
+ * @brief Lets the gateway switch schedules as nodes join and leave, see bl_scheduler_gateway_update_elastic_schedule
+ */
+void bl_scheduler_gateway_set_elastic(bool enabled);
+
+/**
+ * @brief Plans a switch to the smallest schedule that keeps enough uplink cells free, if elastic
+ *
+ * A larger schedule is chosen when fewer than BLINK_ELASTIC_SPARE_CELLS uplink cells
+ * are free, and a smaller one when it would still leave twice as many free. To be
+ * called at the start of each slot, from the timer interrupt: the uplink cells and the
+ * node index are also changed there and from the radio interrupt (joins, keep-alive
+ * expiry, bandwidth grants), never from the main loop.
+ */
+void bl_scheduler_gateway_update_elastic_schedule(uint64_t asn);
+
+/**
+ * @brief Counts the outcome of an uplink slot, for the blacklisting of data channels
+ *
+ * Only the cells of joined nodes are counted: packets received (ri4), or slots in which
+ * nothing, or only a corrupted frame, arrived (rie1, rie2).
+ *
+ * @param[in] uplink_position   position of the cell among the uplink cells
+ * @param[in] channel           channel of the slot
+ * @param[in] received          whether a packet was received
+ */
+void bl_scheduler_gateway_channel_outcome(uint16_t uplink_position, uint8_t channel, bool received);
 
-uint8_t bl_scheduler_get_active_schedule_slot_count(void);
+/**
+ * @brief Plans a change of the data channels, from the outcome of the uplink slots
+ *
+ * Once a data channel would have received BLINK_CHANNEL_MIN_EXPECTED packets at the
+ * reception ratio of the best channels (the upper quartile), it is blacklisted if it
+ * received less than a BLINK_CHANNEL_BAD_RATIO of them, for BLINK_CHANNEL_BAN_SLOTFRAMES. At least
+ * BLINK_CHANNEL_MIN_WHITELISTED channels are kept. Changes are announced in the beacon
+ * like schedule switches. To be called at the start of each slot, from the timer interrupt,
+ * where the beacons are built and the next blacklist is applied.
+ */
+void bl_scheduler_gateway_update_channel_blacklist(uint64_t asn);
+
+const schedule_t *bl_scheduler_get_active_schedule_ptr(void);
 
-cell_t bl_scheduler_node_peek_slot(uint64_t asn);
+uint16_t bl_scheduler_get_active_schedule_slot_count(void);
+
+uint16_t bl_scheduler_get_active_schedule_cell_count(slot_type_t type); // cells of a type in the active schedule
+
+/**
+ * @brief Computes the configuration of a slot, without advancing the schedule
+ */
+bl_slot_info_t bl_scheduler_node_peek_slot(uint64_t asn);
+
+/**
+ * @brief Computes the configuration of the next slots, without advancing the schedule
+ *
+ * Cheap when asn is the next slot to be ticked, as the tick cursor is reused.
+ *
+ * @param[in]  asn          Absolute Slot Number of the first slot
+ * @param[out] slots        configuration of each slot
+ * @param[in]  n_slots      number of slots to compute
+ */
+void bl_scheduler_peek_slots(uint64_t asn, bl_slot_info_t *slots, size_t n_slots);
 
 /**
  * @brief Computes the channel to be used in a given slot.
  *
+ * Beacons hop over the advertising channels, and the other slots over the data
+ * channels left out of the blacklist (see bl_scheduler_get_channel_blacklist).
+ *
  * @param[in] slot_type         Type of slot
  * @param[in] asn               Absolute Slot Number
  * @param[in] channel_offset    Channel offset
@@ -84,4 +309,29 @@ uint8_t bl_scheduler_get_channel(slot_type_t slot_type, uint64_t asn, uint8_t ch
 
 uint8_t bl_scheduler_get_active_schedule_id(void);
 
+/**
+ * @brief Id of the schedule used from bl_scheduler_get_switch_asn on, the active one when no switch is planned
+ */
+uint8_t bl_scheduler_get_next_schedule_id(void);
+
+/**
+ * @brief First slot of the next schedule, 0 when no switch is planned
+ */
+uint64_t bl_scheduler_get_switch_asn(void);
+
+/**
+ * @brief Data channels left out of the hopping sequence, bit i for channel i
+ */
+uint64_t bl_scheduler_get_channel_blacklist(void);
+
+/**
+ * @brief Blacklist used from bl_scheduler_get_channel_switch_asn on, the active one when no change is planned
+ */
+uint64_t bl_scheduler_get_next_channel_blacklist(void);
+
+/**
+ * @brief First slot of the next blacklist, 0 when no change is planned
+ */
+uint64_t bl_scheduler_get_channel_switch_asn(void);
+
 #endif
@@ -0,0 +1,71 @@
+/**
+ * @file
+ * @ingroup     stats
+ *
+ * @brief       MAC and association counters
+ *
+ * @copyright Inria, 2025-now
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "stats.h"
+
+//=========================== variables ========================================
+
+bl_stats_vars_t bl_stats_vars = { 0 };
+
+//=========================== public ===========================================
+
+void bl_stats_reset(void) {
+    memset(&bl_stats_vars.stats, 0, sizeof(bl_stats_t));
+    for (size_t i = 0; i < BLINK_N_UPLINK_CELLS_MAX; i++) {
+        bl_node_stats_t *node = &bl_stats_vars.nodes[i];
+        if (node->node_id != 0) {
+            // keep track of who is joined
+            bl_stats_gateway_node_joined(i, node->node_id);
+        }
+    }
+}
+
+void bl_stats_gateway_node_joined(uint16_t uplink_position, uint64_t node_id) {
+    bl_stats_vars.nodes[uplink_position] = (bl_node_stats_t){
+        .node_id = node_id,
+        .rssi_last = INT8_MIN,
+        .rssi_min = INT8_MAX,
+    };
+}
+
+void bl_stats_gateway_node_left(uint16_t uplink_position) {
+    bl_stats_vars.nodes[uplink_position].node_id = 0;
+}
+
+void bl_stats_gateway_node_moved(uint16_t from_uplink_position, uint16_t to_uplink_position) {
+    bl_stats_vars.nodes[to_uplink_position] = bl_stats_vars.nodes[from_uplink_position];
+    bl_stats_vars.nodes[from_uplink_position].node_id = 0;
+}
+
+bool bl_stats_gateway_get_node(uint64_t node_id, bl_node_stats_t *node_stats) {
+    if (node_id == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < BLINK_N_UPLINK_CELLS_MAX; i++) {
+        if (bl_stats_vars.nodes[i].node_id == node_id) {
+            *node_stats = bl_stats_vars.nodes[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t bl_stats_gateway_get_nodes(bl_node_stats_t *nodes_stats) {
+    size_t count = 0;
+    for (size_t i = 0; i < BLINK_N_UPLINK_CELLS_MAX; i++) {
+        if (bl_stats_vars.nodes[i].node_id != 0) {
+            nodes_stats[count++] = bl_stats_vars.nodes[i];
+        }
+    }
+    return count;
+}
@@ -0,0 +1,173 @@
+#ifndef __STATS_H
+#define __STATS_H
+
+/**
+ * @ingroup     blink
+ * @brief       MAC and association counters
+ *
+ * Counters are plain increments, done where the corresponding event happens,
+ * including in interrupt context. Each counter is only written from a single
+ * context, so no locking is needed; readers get a copy with blink_get_stats.
+ * The exceptions are queue_drops and queue_high_watermark, written by every
+ * producer of the queue, which go through the atomic helpers below.
+ *
+ * Gateways also keep counters for each joined node, indexed by its uplink cell,
+ * so that the worst links of a cell can be found.
+ *
+ * @{
+ * @file
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "models.h"
+
+//=========================== defines ==========================================
+
+typedef enum {
+    BL_STATS_SLOT_BEACON,
+    BL_STATS_SLOT_SHARED_UPLINK,
+    BL_STATS_SLOT_DOWNLINK,
+    BL_STATS_SLOT_UPLINK,
+    BL_STATS_SLOT_TYPES,
+} bl_stats_slot_t;
+
+typedef struct {
+    // mac
+    uint32_t tx[BL_STATS_SLOT_TYPES];   ///< Packets fully transmitted, per slot type (see bl_stats_slot_t)
+    uint32_t rx[BL_STATS_SLOT_TYPES];   ///< Blink packets received, per slot type
+    uint32_t tie1;                      ///< Transmissions aborted because they took too long
+    uint32_t rie1;                      ///< Nothing started to arrive within the rx guard time
+    uint32_t rie2;                      ///< Reception aborted because it took too long
+    uint32_t drift_fixes;               ///< Slot reference adjusted to the gateway
+    uint32_t out_of_sync;               ///< Drift too large, back to scanning
+
+    // association, node
+    uint32_t join_attempts;             ///< Join requests sent
+    uint32_t joins;                     ///< Join responses received, i.e. BLINK_CONNECTED
+    uint32_t backoff_collisions;        ///< Join requests without response, followed by a backoff
+    uint32_t handovers;
+    uint32_t leaves_timeout;            ///< BLINK_PEER_LOST_TIMEOUT
+    uint32_t leaves_bloom;              ///< BLINK_PEER_LOST_BLOOM
+
+    // association, gateway
+    uint32_t nodes_joined;
+    uint32_t nodes_lost;                ///< Nodes not heard from for too long, i.e. BLINK_PEER_LOST
+    uint32_t gateway_full;              ///< Join requests rejected for lack of uplink cells
+
+    // scheduler
+    uint32_t schedule_switches;         ///< Schedule switches, see bl_scheduler_gateway_switch_schedule
+    uint32_t cell_moves;                ///< CELL_MOVE packets sent by the gateway, or received by the node
+    uint32_t cells_lost;                ///< Nodes without a cell after a schedule switch, i.e. BLINK_SCHEDULE_SWITCH
+    uint32_t bandwidth_requests;        ///< BANDWIDTH_REQUEST packets sent by the node, or received by the gateway
+    uint32_t extra_cells_granted;       ///< Extra uplink cells handed out by the gateway, see bl_scheduler_gateway_grant_bandwidth
+    uint32_t channel_blacklist_changes; ///< Changes of the data channels hopped on, see bl_scheduler_gateway_update_channel_blacklist
+
+    // queue
+    uint32_t queue_drops;               ///< Packets not enqueued because the queue was full, or dropped when the node they were for left
+    uint32_t queue_high_watermark;      ///< Most packets waiting in a queue at once
+    uint32_t ttl_drops;                 ///< Packets dropped before being sent because their time-to-live had passed
+    uint32_t oversized_drops;           ///< Packets dropped because they are longer than the max_packet_len of the network
+} bl_stats_t;
+
+typedef struct {
+    uint64_t node_id;                   ///< 0 if the cell is not assigned
+    uint32_t rx;                        ///< Packets received in the uplink cell of the node
+    uint32_t rx_missed;                 ///< Uplink slots of the node in which nothing started to arrive (rie1)
+    uint32_t rx_aborted;                ///< Uplink slots of the node aborted during reception (rie2)
+    int8_t   rssi_last;                 ///< RSSI of the last packet received from the node
+    int8_t   rssi_min;                  ///< Lowest RSSI received from the node
+    uint16_t downlink_queued;           ///< Bulk packets waiting for the node, see bl_queue_gateway_node_length
+    uint32_t downlink_sent;             ///< Bulk packets sent to the node in downlink slots
+    uint32_t downlink_latency_sum;      ///< Slots those packets waited in the queue, in total
+    uint16_t downlink_latency_max;      ///< Most slots one of them waited
+} bl_node_stats_t;
+
+typedef struct {
+    bl_stats_t      stats;
+    bl_node_stats_t nodes[BLINK_N_UPLINK_CELLS_MAX]; ///< Indexed by the position of the uplink cell among the uplink cells, only used by gateways
+} bl_stats_vars_t;
+
+//=========================== variables ========================================
+
+extern bl_stats_vars_t bl_stats_vars;
+
+//=========================== prototypes =======================================
+
+void bl_stats_reset(void);
+void bl_stats_gateway_node_joined(uint16_t uplink_position, uint64_t node_id);
+void bl_stats_gateway_node_left(uint16_t uplink_position);
+void bl_stats_gateway_node_moved(uint16_t from_uplink_position, uint16_t to_uplink_position);
+bool bl_stats_gateway_get_node(uint64_t node_id, bl_node_stats_t *node_stats);
+size_t bl_stats_gateway_get_nodes(bl_node_stats_t *nodes_stats);
+
+//=========================== inline ===========================================
+
+#define BL_STATS_INC(counter) (bl_stats_vars.stats.counter++)
+
+// for the counters written from several contexts
+#define BL_STATS_INC_ATOMIC(counter) (__atomic_add_fetch(&bl_stats_vars.stats.counter, 1, __ATOMIC_RELAXED))
+#define BL_STATS_MAX_ATOMIC(counter, value) do {                                                    \
+    uint32_t _high = __atomic_load_n(&bl_stats_vars.stats.counter, __ATOMIC_RELAXED);               \
+    while ((value) > _high && !__atomic_compare_exchange_n(&bl_stats_vars.stats.counter, &_high, (value), true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { \
+    }                                                                                               \
+} while (0)
+
+static inline bl_stats_slot_t bl_stats_slot(slot_type_t slot_type) {
+    switch (slot_type) {
+        case SLOT_TYPE_BEACON:          return BL_STATS_SLOT_BEACON;
+        case SLOT_TYPE_SHARED_UPLINK:   return BL_STATS_SLOT_SHARED_UPLINK;
+        case SLOT_TYPE_DOWNLINK:        return BL_STATS_SLOT_DOWNLINK;
+        default:                        return BL_STATS_SLOT_UPLINK;
+    }
+}
+
+static inline void bl_stats_gateway_node_rx(uint16_t uplink_position, uint64_t src, int8_t rssi) {
+    if (uplink_position >= BLINK_N_UPLINK_CELLS_MAX) {
+        return;
+    }
+    bl_node_stats_t *node = &bl_stats_vars.nodes[uplink_position];
+    if (node->node_id == 0 || node->node_id != src) {
+        return;
+    }
+    node->rx++;
+    node->rssi_last = rssi;
+    if (rssi < node->rssi_min) {
+        node->rssi_min = rssi;
+    }
+}
+
+static inline void bl_stats_gateway_node_missed(uint16_t uplink_position, bool aborted) {
+    if (uplink_position >= BLINK_N_UPLINK_CELLS_MAX) {
+        return;
+    }
+    bl_node_stats_t *node = &bl_stats_vars.nodes[uplink_position];
+    if (node->node_id == 0) {
+        return;
+    }
+    if (aborted) {
+        node->rx_aborted++;
+    } else {
+        node->rx_missed++;
+    }
+}
+
+static inline void bl_stats_gateway_node_downlink(uint16_t uplink_position, uint64_t dst, uint16_t latency) {
+    if (uplink_position >= BLINK_N_UPLINK_CELLS_MAX) {
+        return;
+    }
+    bl_node_stats_t *node = &bl_stats_vars.nodes[uplink_position];
+    if (node->node_id == 0 || node->node_id != dst) {
+        return;
+    }
+    node->downlink_sent++;
+    node->downlink_latency_sum += latency;
+    if (latency > node->downlink_latency_max) {
+        node->downlink_latency_max = latency;
+    }
+}
+
+#endif // __STATS_H
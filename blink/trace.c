@@ -0,0 +1,77 @@
+/**
+ * @file
+ * @ingroup     trace
+ *
+ * @brief       Slot timeline trace
+ *
+ * @copyright Inria, 2025-now
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "trace.h"
+
+#if BLINK_TRACE_ENABLED
+
+//=========================== variables ========================================
+
+bl_trace_vars_t bl_trace_vars = { 0 };
+
+static const char _hex[] = "0123456789abcdef";
+
+//=========================== public ===========================================
+
+// Must be called from thread mode: records are emitted by interrupts, which always complete before the reader resumes.
+size_t bl_trace_read(bl_trace_record_t *records, size_t max_records, uint32_t *lost) {
+    uint32_t head = __atomic_load_n(&bl_trace_vars.head, __ATOMIC_ACQUIRE);
+    uint32_t tail = bl_trace_vars.tail;
+    uint32_t dropped = 0;
+
+    // records older than the size of the ring were already overwritten
+    if (head - tail > BLINK_TRACE_LEN) {
+        dropped = head - tail - BLINK_TRACE_LEN;
+        tail = head - BLINK_TRACE_LEN;
+    }
+
+    size_t len = 0;
+    while (tail + len != head && len < max_records) {
+        records[len] = bl_trace_vars.records[(tail + len) & (BLINK_TRACE_LEN - 1)];
+        len++;
+    }
+
+    // an interrupt may have overwritten the oldest records while they were being copied
+    uint32_t oldest = __atomic_load_n(&bl_trace_vars.head, __ATOMIC_ACQUIRE) - BLINK_TRACE_LEN;
+    if ((int32_t)(oldest - tail) > 0) {
+        uint32_t overwritten = oldest - tail;
+        if (overwritten > len) {
+            overwritten = len;
+        }
+        memmove(records, records + overwritten, (len - overwritten) * sizeof(bl_trace_record_t));
+        len -= overwritten;
+        dropped += overwritten;
+        tail += overwritten;
+    }
+
+    bl_trace_vars.tail = tail + len;
+    if (lost) {
+        *lost = dropped;
+    }
+    return len;
+}
+
+// Writes "trace " followed by the bytes of the record in hex, as expected by the host decoder.
+size_t bl_trace_format(const bl_trace_record_t *record, char *line) {
+    const uint8_t *bytes = (const uint8_t *)record;
+    size_t len = sizeof(BLINK_TRACE_LINE_PREFIX) - 1;
+    memcpy(line, BLINK_TRACE_LINE_PREFIX, len);
+    for (size_t i = 0; i < sizeof(bl_trace_record_t); i++) {
+        line[len++] = _hex[bytes[i] >> 4];
+        line[len++] = _hex[bytes[i] & 0x0F];
+    }
+    line[len] = '\0';
+    return len;
+}
+
+#endif // BLINK_TRACE_ENABLED
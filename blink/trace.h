@@ -0,0 +1,107 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+
+/**
+ * @ingroup     blink
+ * @brief       Slot timeline trace
+ *
+ * When BLINK_TRACE_ENABLED is set, the MAC writes a compact record to a ring
+ * buffer at every activity and slot state change, so that the time spent in each
+ * part of the slot can be inspected on deployed devices, without a logic analyzer.
+ * When the ring is full, the oldest records are overwritten.
+ *
+ * Records are reserved with an atomic increment, so that they can be emitted from
+ * interrupts of any priority. They are read from thread mode with bl_trace_read,
+ * and printed with bl_trace_format for the host decoder (sim/trace_decode.c). The
+ * ring and these functions are only built when BLINK_TRACE_ENABLED is set.
+ *
+ * @{
+ * @file
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//=========================== defines ==========================================
+
+#ifndef BLINK_TRACE_ENABLED
+#define BLINK_TRACE_ENABLED 0 // whether the MAC emits trace records, costs a few cycles per record
+#endif
+
+#ifndef BLINK_TRACE_LEN
+#define BLINK_TRACE_LEN (256) // must be a power of 2
+#endif
+
+#define BLINK_TRACE_LINE_PREFIX "trace "
+#define BLINK_TRACE_LINE_MAX_LEN (sizeof(BLINK_TRACE_LINE_PREFIX) + 2 * sizeof(bl_trace_record_t)) // including the null terminator
+
+typedef enum {
+    BL_TRACE_STATE = 0,         ///< The slot state changed, see bl_mac_state_t
+
+    // synced slots
+    BL_TRACE_NEW_SLOT,          ///< Start of a slot, arg is the slot type (high byte) and the channel (low byte)
+    BL_TRACE_TI1,
+    BL_TRACE_TI2,
+    BL_TRACE_TIE1,
+    BL_TRACE_TI3,
+    BL_TRACE_RI1,
+    BL_TRACE_RI2,
+    BL_TRACE_RI3,
+    BL_TRACE_RIE1,
+    BL_TRACE_RI4,
+    BL_TRACE_RIE2,
+    BL_TRACE_FIX_DRIFT,         ///< arg is the measured drift in us, as an int16_t
+    BL_TRACE_DESYNC,            ///< Drift too large, back to scanning
+
+    // scan
+    BL_TRACE_SCAN_START,
+    BL_TRACE_SCAN_END,
+    BL_TRACE_BG_SCAN_START,     ///< arg is 1 if the background scan continues from the previous slot
+    BL_TRACE_BG_SCAN_END,
+    BL_TRACE_SCAN_START_FRAME,
+    BL_TRACE_SCAN_END_FRAME,    ///< arg is the length of the received packet
+    BL_TRACE_SYNC,              ///< Synchronized to a gateway, arg is 1 on handover
+    BL_TRACE_DISPATCH_SCHEDULE, ///< First slot timer armed after a sync
+
+    BL_TRACE_ACTIVITY_MAX,
+} bl_trace_activity_t;
+
+typedef struct {
+    uint32_t    ts;         ///< Timestamp, from the MAC timer, in us
+    uint32_t    asn;        ///< Lower bits of the MAC asn counter, already incremented once a slot has started
+    uint8_t     activity;   ///< See bl_trace_activity_t
+    uint8_t     state;      ///< Slot state when the record was emitted
+    uint16_t    arg;        ///< Depends on the activity
+} bl_trace_record_t; // 12 bytes, without padding
+
+typedef struct {
+    uint32_t            head;                       ///< Number of records emitted since boot, wraps around
+    uint32_t            tail;                       ///< Number of records read, or overwritten before being read
+    bl_trace_record_t   records[BLINK_TRACE_LEN];
+} bl_trace_vars_t;
+
+//=========================== variables ========================================
+
+extern bl_trace_vars_t bl_trace_vars;
+
+//=========================== prototypes =======================================
+
+size_t bl_trace_read(bl_trace_record_t *records, size_t max_records, uint32_t *lost);
+size_t bl_trace_format(const bl_trace_record_t *record, char *line);
+
+//=========================== inline ===========================================
+
+static inline void bl_trace_emit(uint32_t ts, uint64_t asn, bl_trace_activity_t activity, uint8_t state, uint16_t arg) {
+    uint32_t index = __atomic_fetch_add(&bl_trace_vars.head, 1, __ATOMIC_RELAXED) & (BLINK_TRACE_LEN - 1);
+    bl_trace_record_t *record = &bl_trace_vars.records[index];
+    record->ts = ts;
+    record->asn = (uint32_t)asn;
+    record->activity = activity;
+    record->state = state;
+    record->arg = arg;
+}
+
+#endif // __TRACE_H
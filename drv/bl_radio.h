@@ -41,6 +41,13 @@ typedef enum {
     BL_RADIO_IEEE802154_250Kbit
 } bl_radio_mode_t;
 
+/// Frame as the radio reads and writes it in memory with EasyDMA (see PACKETPTR)
+typedef struct __attribute__((packed)) {
+    uint8_t header;                              ///< PDU header (depends on the type of PDU - advertising physical channel or Data physical channel)
+    uint8_t length;                              ///< Length of the payload + MIC (if any)
+    uint8_t payload[BL_BLE_PAYLOAD_MAX_LENGTH];  ///< Payload + MIC (if any) (BL_BLE_PAYLOAD_MAX_LENGTH > BL_IEEE802154_PAYLOAD_MAX_LENGTH)
+} bl_radio_pdu_t;
+
 typedef void (*bl_radio_cb_t)(uint8_t *packet, uint8_t length);  ///< get the received packet
 typedef void (*radio_ts_packet_t)(uint32_t ts);  ///< capture timestamp for start/end of packet
 
@@ -126,7 +133,32 @@ void bl_radio_disable(void);
 bool bl_radio_pending_rx_read(void);
 void bl_radio_get_rx_packet(uint8_t *packet, uint8_t *length);
 
+/**
+ * @brief Sets the buffer the next frames are received into, without copy
+ *
+ * Takes effect at the next bl_radio_rx, the buffer must stay untouched until the frame
+ * is read with bl_radio_get_rx_pdu.
+ *
+ * @param[in] pdu   buffer, or NULL for the internal one of the driver
+ */
+void bl_radio_set_rx_pdu(bl_radio_pdu_t *pdu);
+
+/**
+ * @brief Reads the last received frame in place, in the buffer given to bl_radio_set_rx_pdu
+ */
+bl_radio_pdu_t *bl_radio_get_rx_pdu(void);
+
 void bl_radio_tx_prepare(const uint8_t *tx_buffer, uint8_t length);
+
+/**
+ * @brief Ramps up the radio to send the frame in pdu, without copy
+ *
+ * The radio reads the frame from pdu when it is sent, with bl_radio_tx_dispatch, so the
+ * buffer must stay untouched until the end of the frame.
+ *
+ * @param[in] pdu   frame to send, with its length
+ */
+void bl_radio_tx_prepare_pdu(const bl_radio_pdu_t *pdu);
 void bl_radio_tx_dispatch(void);
 
 #endif // __BL_RADIO_H
@@ -47,14 +47,9 @@
 #define RADIO_STATE_TX   0x02
 #define RADIO_STATE_BUSY 0x04
 
-typedef struct __attribute__((packed)) {
-    uint8_t header;                              ///< PDU header (depends on the type of PDU - advertising physical channel or Data physical channel)
-    uint8_t length;                              ///< Length of the payload + MIC (if any)
-    uint8_t payload[BL_BLE_PAYLOAD_MAX_LENGTH];  ///< Payload + MIC (if any) (BL_BLE_PAYLOAD_MAX_LENGTH > BL_IEEE802154_PAYLOAD_MAX_LENGTH)
-} radio_pdu_t;
-
 typedef struct {
-    radio_pdu_t     pdu;       ///< Variable that stores the radio PDU (protocol data unit) that arrives and the radio packets that are about to be sent.
+    bl_radio_pdu_t  pdu;       ///< Variable that stores the radio PDU (protocol data unit) that arrives and the radio packets that are about to be sent.
+    bl_radio_pdu_t  *rx_pdu;   ///< Where frames are received, pdu unless set with bl_radio_set_rx_pdu
     bool            pending_rx_read; ///< Flag to indicate that a PDU has been received, but not yet read by the application.
     radio_ts_packet_t start_pac_cb;  ///< Function pointer, stores the callback to capture the start of the packet.
     radio_ts_packet_t end_pac_cb;      ///< Function pointer, stores the callback to capture the end of the packet.
@@ -81,6 +76,7 @@ static radio_vars_t radio_vars = { 0 };
 //========================== prototypes ========================================
 
 static void _radio_enable(void);
+static void _set_packet_ptr(const bl_radio_pdu_t *pdu);
 
 //=========================== public ===========================================
 
@@ -200,11 +196,8 @@ void bl_radio_init(radio_ts_packet_t start_pac_cb, radio_ts_packet_t end_pac_cb,
     }
 
     // Configure pointer to PDU for EasyDMA
-    if (mode == BL_RADIO_IEEE802154_250Kbit) {
-        NRF_RADIO->PACKETPTR = (uint32_t)((uint8_t *)&radio_vars.pdu + 1);  // Skip header for IEEE 802.15.4
-    } else {
-        NRF_RADIO->PACKETPTR = (uint32_t)&radio_vars.pdu;
-    }
+    radio_vars.rx_pdu = &radio_vars.pdu;
+    _set_packet_ptr(&radio_vars.pdu);
 
     // Assign the callbacks that will be called in the RADIO_IRQHandler
     radio_vars.start_pac_cb = start_pac_cb;
@@ -255,9 +248,18 @@ bool bl_radio_pending_rx_read(void) {
 }
 
 void bl_radio_get_rx_packet(uint8_t *packet, uint8_t *length) {
-    *length = radio_vars.pdu.length;
-    memcpy(packet, radio_vars.pdu.payload, radio_vars.pdu.length);
+    *length = radio_vars.rx_pdu->length;
+    memcpy(packet, radio_vars.rx_pdu->payload, radio_vars.rx_pdu->length);
+    radio_vars.pending_rx_read = false;
+}
+
+void bl_radio_set_rx_pdu(bl_radio_pdu_t *pdu) {
+    radio_vars.rx_pdu = pdu != NULL ? pdu : &radio_vars.pdu;
+}
+
+bl_radio_pdu_t *bl_radio_get_rx_pdu(void) {
     radio_vars.pending_rx_read = false;
+    return radio_vars.rx_pdu;
 }
 
 //--------------------------- send and receive --------------------------------
@@ -269,6 +271,9 @@ void bl_radio_rx(void) {
         return;
     }
 
+    // receive straight into the buffer of the caller
+    _set_packet_ptr(radio_vars.rx_pdu);
+
     // enable the radio shorts and interrupts
     NRF_RADIO->SHORTS = RADIO_SHORTS_COMMON | (RADIO_SHORTS_RXREADY_START_Enabled << RADIO_SHORTS_RXREADY_START_Pos);
     _radio_enable();
@@ -281,6 +286,15 @@ void bl_radio_tx_prepare(const uint8_t *tx_buffer, uint8_t length) {
     // TODO: check for IDLE?
     radio_vars.pdu.length = length;
     memcpy(radio_vars.pdu.payload, tx_buffer, length);
+    _set_packet_ptr(&radio_vars.pdu);
+
+    // ramp up the radio for tx (packet will not be sent yet)
+    NRF_RADIO->TASKS_TXEN = RADIO_TASKS_TXEN_TASKS_TXEN_Trigger << RADIO_TASKS_TXEN_TASKS_TXEN_Pos;
+}
+
+void bl_radio_tx_prepare_pdu(const bl_radio_pdu_t *pdu) {
+    // EasyDMA reads the frame from the buffer of the caller when it is sent
+    _set_packet_ptr(pdu);
 
     // ramp up the radio for tx (packet will not be sent yet)
     NRF_RADIO->TASKS_TXEN = RADIO_TASKS_TXEN_TASKS_TXEN_Trigger << RADIO_TASKS_TXEN_TASKS_TXEN_Pos;
@@ -309,6 +323,14 @@ static void _radio_enable(void) {
     NRF_RADIO->INTENSET = RADIO_INTERRUPTS;
 }
 
+static void _set_packet_ptr(const bl_radio_pdu_t *pdu) {
+    if (radio_vars.mode == BL_RADIO_IEEE802154_250Kbit) {
+        NRF_RADIO->PACKETPTR = (uint32_t)((uint8_t *)pdu + 1);  // Skip header for IEEE 802.15.4
+    } else {
+        NRF_RADIO->PACKETPTR = (uint32_t)pdu;
+    }
+}
+
 //=========================== interrupt handlers ===============================
 
 /**
@@ -0,0 +1,49 @@
+/**
+ * @file
+ * @ingroup     sim
+ *
+ * @brief       Simulated implementation of the "gpio" bsp module
+ *
+ * There is no logic analyzer attached to the host: pins only keep their level.
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <nrf.h>
+#include <stdint.h>
+
+#include "bl_gpio.h"
+
+//=========================== variables ========================================
+
+NRF_GPIO_Type bl_sim_gpio_ports[2] = { 0 };
+
+//=========================== public ===========================================
+
+void bl_gpio_init(const bl_gpio_t *gpio, bl_gpio_mode_t mode) {
+    (void)gpio;
+    (void)mode;
+}
+
+void bl_gpio_init_irq(const bl_gpio_t *gpio, bl_gpio_mode_t mode, bl_gpio_irq_edge_t edge, gpio_cb_t callback, void *ctx) {
+    (void)gpio;
+    (void)mode;
+    (void)edge;
+    (void)callback;
+    (void)ctx;
+}
+
+void bl_gpio_set(const bl_gpio_t *gpio) {
+    bl_nrf_port[gpio->port]->OUT |= (1 << gpio->pin);
+}
+
+void bl_gpio_clear(const bl_gpio_t *gpio) {
+    bl_nrf_port[gpio->port]->OUT &= ~(1 << gpio->pin);
+}
+
+void bl_gpio_toggle(const bl_gpio_t *gpio) {
+    bl_nrf_port[gpio->port]->OUT ^= (1 << gpio->pin);
+}
+
+uint8_t bl_gpio_read(const bl_gpio_t *gpio) {
+    return (bl_nrf_port[gpio->port]->OUT >> gpio->pin) & 1;
+}
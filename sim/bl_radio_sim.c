@@ -0,0 +1,309 @@
+/**
+ * @file
+ * @ingroup     sim
+ *
+ * @brief       Simulated implementation of the "radio" bsp module, and the shared medium
+ *
+ * Follows the state machine of bl_radio_default.c (shorts END -> DISABLE, so the
+ * radio is idle after each frame). Frames propagate with the link budget given
+ * by the engine; overlapping frames on the same channel corrupt each other unless
+ * one is stronger by BL_SIM_RADIO_CAPTURE_DB.
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "bl_radio.h"
+#include "sim.h"
+
+//=========================== defines ==========================================
+
+#define RADIO_STATE_IDLE 0x00
+#define RADIO_STATE_RX   0x01
+#define RADIO_STATE_TX   0x02
+#define RADIO_STATE_BUSY 0x04
+
+#define SIM_RADIO_FRAMES (256) ///< Frames in flight at once, frame ids wrap around this
+
+typedef struct {
+    bl_sim_node_t   *sender;
+    uint8_t         channel;
+    uint8_t         length;
+    uint8_t         pdu[BL_BLE_PAYLOAD_MAX_LENGTH];
+    bool            aborted;            ///< The sender disabled its radio in the middle of the frame
+    bool            in_air;
+} sim_frame_t;
+
+typedef struct {
+    sim_frame_t     frames[SIM_RADIO_FRAMES];
+    uint32_t        next_frame;
+    int32_t         active[BL_SIM_RADIO_MAX_ACTIVE_FRAMES];
+    size_t          active_len;
+} sim_radio_vars_t;
+
+//=========================== variables ========================================
+
+static sim_radio_vars_t _sim_radio_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static void _set_idle(bl_sim_node_t *node);
+static void _set_on(bl_sim_node_t *node, uint8_t state);
+static uint32_t _node_ts(bl_sim_node_t *node);
+static bool _interfered(bl_sim_node_t *receiver, int32_t frame, int8_t rssi);
+
+//=========================== public ===========================================
+
+void bl_radio_init(radio_ts_packet_t start_pac_cb, radio_ts_packet_t end_pac_cb, bl_radio_mode_t mode) {
+    (void)mode; // only BLE 2M is modelled
+    bl_sim_node_t *node = bl_sim_current();
+    _set_idle(node);
+    node->radio.start_pac_cb = start_pac_cb;
+    node->radio.end_pac_cb = end_pac_cb;
+}
+
+void bl_radio_set_frequency(uint8_t freq) {
+    bl_sim_current()->radio.channel = freq;
+}
+
+void bl_radio_set_channel(uint8_t channel) {
+    // the medium works on channels directly, there is no need to go through frequencies
+    bl_sim_current()->radio.channel = channel;
+}
+
+void bl_radio_set_network_address(uint32_t addr) {
+    (void)addr;
+}
+
+void bl_radio_disable(void) {
+    _set_idle(bl_sim_current());
+}
+
+int8_t bl_radio_rssi(void) {
+    return bl_sim_current()->radio.rssi;
+}
+
+bool bl_radio_pending_rx_read(void) {
+    return bl_sim_current()->radio.pending_rx_read;
+}
+
+void bl_radio_get_rx_packet(uint8_t *packet, uint8_t *length) {
+    bl_radio_pdu_t *pdu = bl_radio_get_rx_pdu();
+    *length = pdu->length;
+    memcpy(packet, pdu->payload, pdu->length);
+}
+
+void bl_radio_set_rx_pdu(bl_radio_pdu_t *pdu) {
+    bl_sim_current()->radio.rx_buffer = pdu;
+}
+
+bl_radio_pdu_t *bl_radio_get_rx_pdu(void) {
+    bl_sim_radio_t *radio = &bl_sim_current()->radio;
+    radio->pending_rx_read = false;
+    return radio->rx_buffer != NULL ? radio->rx_buffer : &radio->rx_pdu;
+}
+
+void bl_radio_rx(void) {
+    bl_sim_node_t *node = bl_sim_current();
+    if (node->radio.state != RADIO_STATE_IDLE) {
+        return;
+    }
+    _set_on(node, RADIO_STATE_RX);
+}
+
+void bl_radio_tx_prepare(const uint8_t *tx_buffer, uint8_t length) {
+    bl_sim_radio_t *radio = &bl_sim_current()->radio;
+    radio->tx_pdu.length = length;
+    memcpy(radio->tx_pdu.payload, tx_buffer, length);
+    radio->tx_buffer = &radio->tx_pdu;
+}
+
+void bl_radio_tx_prepare_pdu(const bl_radio_pdu_t *pdu) {
+    bl_sim_current()->radio.tx_buffer = pdu;
+}
+
+void bl_radio_tx_dispatch(void) {
+    bl_sim_node_t *node = bl_sim_current();
+    if (node->radio.state != RADIO_STATE_IDLE) {
+        return;
+    }
+    _set_on(node, RADIO_STATE_TX);
+
+    int32_t frame_id = _sim_radio_vars.next_frame++ % SIM_RADIO_FRAMES;
+    sim_frame_t *frame = &_sim_radio_vars.frames[frame_id];
+    frame->sender = node;
+    frame->channel = node->radio.channel;
+    // like EasyDMA, read the frame when it is sent
+    const bl_radio_pdu_t *pdu = node->radio.tx_buffer != NULL ? node->radio.tx_buffer : &node->radio.tx_pdu;
+    frame->length = pdu->length;
+    memcpy(frame->pdu, pdu->payload, pdu->length);
+    frame->aborted = false;
+    frame->in_air = false;
+    node->radio.frame = frame_id;
+    node->radio_stats.frames_tx++;
+
+    bl_sim_time_t start = bl_sim_now() + BL_SIM_RADIO_ADDRESS_DELAY_US * BL_SIM_NS_PER_US;
+    bl_sim_time_t toa = (frame->length + BL_SIM_RADIO_OVERHEAD_BYTES) * BL_SIM_RADIO_US_PER_BYTE * BL_SIM_NS_PER_US;
+    bl_sim_schedule_frame(node, start, false, frame_id);
+    bl_sim_schedule_frame(node, start + toa, true, frame_id);
+}
+
+// -------- medium, called by the engine --------
+
+void bl_sim_radio_reset(void) {
+    memset(&_sim_radio_vars, 0, sizeof(_sim_radio_vars));
+}
+
+void bl_sim_radio_flush_stats(bl_sim_node_t *node) {
+    if (node->radio.state == RADIO_STATE_IDLE) {
+        return;
+    }
+    bl_sim_time_t on = bl_sim_now() - node->radio.on_since;
+    if (node->radio.state & RADIO_STATE_TX) {
+        node->radio_stats.tx_ns += on;
+    } else {
+        node->radio_stats.rx_ns += on;
+    }
+    node->radio.on_since = bl_sim_now();
+}
+
+void bl_sim_radio_frame_start(int32_t frame_id) {
+    sim_frame_t *frame = &_sim_radio_vars.frames[frame_id];
+    bl_sim_node_t *sender = frame->sender;
+    if (frame->aborted) {
+        return;
+    }
+
+    frame->in_air = true;
+    if (_sim_radio_vars.active_len < BL_SIM_RADIO_MAX_ACTIVE_FRAMES) {
+        _sim_radio_vars.active[_sim_radio_vars.active_len++] = frame_id;
+    }
+
+    // ADDRESS event at the sender
+    sender->radio.state |= RADIO_STATE_BUSY;
+    if (sender->radio.start_pac_cb) {
+        bl_sim_switch(sender);
+        sender->radio.start_pac_cb(_node_ts(sender));
+        bl_sim_after_event(sender);
+    }
+
+    size_t nodes_len;
+    bl_sim_node_t *nodes = bl_sim_nodes(&nodes_len);
+    for (size_t i = 0; i < nodes_len; i++) {
+        bl_sim_node_t *node = &nodes[i];
+        if (node == sender || !(node->radio.state & RADIO_STATE_RX) || node->radio.channel != frame->channel) {
+            continue;
+        }
+        int8_t rssi = bl_sim_link_rssi(sender, node);
+        if (rssi < BL_SIM_RADIO_SENSITIVITY_DBM) {
+            continue;
+        }
+
+        if (node->radio.state & RADIO_STATE_BUSY) {
+            // already locked onto another frame, which this one may corrupt
+            if (rssi + BL_SIM_RADIO_CAPTURE_DB > node->radio.rssi) {
+                node->radio.frame_corrupted = true;
+            }
+            continue;
+        }
+
+        node->radio.state |= RADIO_STATE_BUSY;
+        node->radio.frame = frame_id;
+        node->radio.rssi = rssi;
+        node->radio.frame_corrupted = _interfered(node, frame_id, rssi);
+        if (node->radio.start_pac_cb) {
+            bl_sim_switch(node);
+            node->radio.start_pac_cb(_node_ts(node));
+            bl_sim_after_event(node);
+        }
+    }
+}
+
+void bl_sim_radio_frame_end(int32_t frame_id) {
+    sim_frame_t *frame = &_sim_radio_vars.frames[frame_id];
+    bl_sim_node_t *sender = frame->sender;
+
+    for (size_t i = 0; i < _sim_radio_vars.active_len; i++) {
+        if (_sim_radio_vars.active[i] == frame_id) {
+            _sim_radio_vars.active[i] = _sim_radio_vars.active[--_sim_radio_vars.active_len];
+            break;
+        }
+    }
+    frame->in_air = false;
+
+    if (!frame->aborted) {
+        // END event at the sender, the radio then disables itself
+        sender->radio.frame = -1;
+        _set_idle(sender);
+        if (sender->radio.end_pac_cb) {
+            bl_sim_switch(sender);
+            sender->radio.end_pac_cb(_node_ts(sender));
+            bl_sim_after_event(sender);
+        }
+    }
+
+    size_t nodes_len;
+    bl_sim_node_t *nodes = bl_sim_nodes(&nodes_len);
+    for (size_t i = 0; i < nodes_len; i++) {
+        bl_sim_node_t *node = &nodes[i];
+        if (node->radio.frame != frame_id || node == sender || node->radio.state != (RADIO_STATE_RX | RADIO_STATE_BUSY)) {
+            continue;
+        }
+        bool crc_ok = !frame->aborted && !node->radio.frame_corrupted && !bl_sim_draw_loss(frame->channel);
+        _set_idle(node);
+        if (!crc_ok) {
+            // the driver drops frames with an invalid CRC without calling back
+            node->radio_stats.frames_corrupted++;
+            continue;
+        }
+        node->radio_stats.frames_rx++;
+        // the buffer may be in the state of the instance, which is only in place once switched to
+        bl_sim_switch(node);
+        bl_radio_pdu_t *pdu = node->radio.rx_buffer != NULL ? node->radio.rx_buffer : &node->radio.rx_pdu;
+        pdu->length = frame->length;
+        memcpy(pdu->payload, frame->pdu, frame->length);
+        if (node->radio.end_pac_cb) {
+            node->radio.pending_rx_read = true;
+            node->radio.end_pac_cb(_node_ts(node));
+            bl_sim_after_event(node);
+        }
+    }
+}
+
+//=========================== private ==========================================
+
+static void _set_on(bl_sim_node_t *node, uint8_t state) {
+    node->radio.state = state;
+    node->radio.on_since = bl_sim_now();
+}
+
+static void _set_idle(bl_sim_node_t *node) {
+    bl_sim_radio_flush_stats(node);
+    if ((node->radio.state & RADIO_STATE_TX) && node->radio.frame >= 0) {
+        // disabled before the END event, receivers will see a broken frame
+        _sim_radio_vars.frames[node->radio.frame].aborted = true;
+    }
+    node->radio.state = RADIO_STATE_IDLE;
+    node->radio.frame = -1;
+    node->radio.frame_corrupted = false;
+}
+
+static uint32_t _node_ts(bl_sim_node_t *node) {
+    // the driver timestamps radio events with timer 2
+    return (uint32_t)(bl_sim_local_us(node, bl_sim_now()) - node->timers[2].epoch_us);
+}
+
+static bool _interfered(bl_sim_node_t *receiver, int32_t frame_id, int8_t rssi) {
+    for (size_t i = 0; i < _sim_radio_vars.active_len; i++) {
+        sim_frame_t *other = &_sim_radio_vars.frames[_sim_radio_vars.active[i]];
+        if (_sim_radio_vars.active[i] == frame_id || other->channel != _sim_radio_vars.frames[frame_id].channel || other->sender == receiver) {
+            continue;
+        }
+        if (bl_sim_link_rssi(other->sender, receiver) + BL_SIM_RADIO_CAPTURE_DB > rssi) {
+            return true;
+        }
+    }
+    return false;
+}
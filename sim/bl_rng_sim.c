@@ -0,0 +1,29 @@
+/**
+ * @file
+ * @ingroup     sim
+ *
+ * @brief       Simulated implementation of the "rng" bsp module
+ *
+ * Each instance draws from its own generator, seeded from the simulation seed,
+ * so that runs are reproducible.
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdint.h>
+
+#include "bl_rng.h"
+#include "sim.h"
+
+//=========================== public ===========================================
+
+void bl_rng_init(void) {}
+
+void bl_rng_read(uint8_t *value) {
+    *value = (uint8_t)bl_sim_rng_next(&bl_sim_current()->rng_state);
+}
+
+void bl_rng_read_range(uint8_t *value, uint8_t min, uint8_t max) {
+    do {
+        bl_rng_read(value);
+    } while (!(*value >= min && *value < max));
+}
@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @ingroup     sim
+ *
+ * @brief       Simulated implementation of the "timer hf" bsp module
+ *
+ * Mirrors bl_timer_hf.c: each device is a free-running 32-bit microsecond counter
+ * driven by the drifting clock of the running instance, and each channel is a
+ * compare register. As on the hardware, a compare value that is already in the
+ * past only matches after the counter wraps.
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include "bl_timer_hf.h"
+#include "sim.h"
+
+//=========================== prototypes =======================================
+
+static uint64_t _counter(bl_sim_node_t *node, timer_hf_t timer);
+static void _arm(timer_hf_t timer, uint8_t channel, uint32_t us, bool one_shot, timer_hf_cb_t cb);
+
+//=========================== public ===========================================
+
+void bl_timer_hf_init(timer_hf_t timer) {
+    assert(timer < BL_SIM_TIMER_DEVS);
+    bl_sim_node_t *node = bl_sim_current();
+
+    // TASKS_CLEAR: the counter restarts from zero, pending compares are lost
+    node->timers[timer].epoch_us = bl_sim_local_us(node, bl_sim_now());
+    for (uint8_t channel = 0; channel < BL_SIM_TIMER_CHANNELS; channel++) {
+        node->timers[timer].channels[channel].armed = false;
+        node->timers[timer].channels[channel].generation++;
+    }
+}
+
+uint32_t bl_timer_hf_now(timer_hf_t timer) {
+    return (uint32_t)_counter(bl_sim_current(), timer);
+}
+
+void bl_timer_hf_set_periodic_us(timer_hf_t timer, uint8_t channel, uint32_t us, timer_hf_cb_t cb) {
+    _arm(timer, channel, us, false, cb);
+}
+
+void bl_timer_hf_adjust_periodic_us(timer_hf_t timer, uint8_t channel, int32_t adjust_us) {
+    bl_sim_node_t *node = bl_sim_current();
+    bl_sim_timer_channel_t *ch = &node->timers[timer].channels[channel];
+
+    // only the current "tick" is moved, the period is kept
+    ch->deadline += adjust_us;
+    if (ch->armed) {
+        if (ch->deadline <= _counter(node, timer)) {
+            ch->deadline += 1ULL << 32;
+        }
+        ch->generation++;
+        bl_sim_schedule_timer(node, timer, channel);
+    }
+}
+
+void bl_timer_hf_set_oneshot_us(timer_hf_t timer, uint8_t channel, uint32_t us, timer_hf_cb_t cb) {
+    _arm(timer, channel, us, true, cb);
+}
+
+void bl_timer_hf_set_oneshot_with_ref_us(timer_hf_t timer, uint8_t channel, uint32_t base_us, uint32_t us, timer_hf_cb_t cb) {
+    // same arithmetic as the driver, including how the elapsed time since base_us is accounted for
+    uint32_t now = bl_timer_hf_now(timer);
+    _arm(timer, channel, us + (now - base_us), true, cb);
+}
+
+void bl_timer_hf_set_oneshot_with_ref_diff_us(timer_hf_t timer, uint8_t channel, uint32_t base_us, uint32_t us, timer_hf_cb_t cb) {
+    uint32_t now = bl_timer_hf_now(timer);
+    _arm(timer, channel, us - (now - base_us), true, cb);
+}
+
+void bl_timer_hf_set_oneshot_ms(timer_hf_t timer, uint8_t channel, uint32_t ms, timer_hf_cb_t cb) {
+    bl_timer_hf_set_oneshot_us(timer, channel, ms * 1000UL, cb);
+}
+
+void bl_timer_hf_set_oneshot_s(timer_hf_t timer, uint8_t channel, uint32_t s, timer_hf_cb_t cb) {
+    bl_timer_hf_set_oneshot_us(timer, channel, s * 1000UL * 1000UL, cb);
+}
+
+void bl_timer_hf_cancel(timer_hf_t timer, uint8_t channel) {
+    bl_sim_timer_channel_t *ch = &bl_sim_current()->timers[timer].channels[channel];
+    ch->armed = false;
+    ch->callback = NULL;
+    ch->period_us = 0;
+    ch->generation++;
+}
+
+// Busy-waiting cannot be simulated from inside an event handler, virtual time only moves between events
+void bl_timer_hf_delay_us(timer_hf_t timer, uint32_t us) {
+    (void)timer;
+    (void)us;
+}
+
+void bl_timer_hf_delay_ms(timer_hf_t timer, uint32_t ms) {
+    bl_timer_hf_delay_us(timer, ms * 1000UL);
+}
+
+void bl_timer_hf_delay_s(timer_hf_t timer, uint32_t s) {
+    bl_timer_hf_delay_us(timer, s * 1000UL * 1000UL);
+}
+
+//=========================== private ==========================================
+
+static uint64_t _counter(bl_sim_node_t *node, timer_hf_t timer) {
+    return bl_sim_local_us(node, bl_sim_now()) - node->timers[timer].epoch_us;
+}
+
+static void _arm(timer_hf_t timer, uint8_t channel, uint32_t us, bool one_shot, timer_hf_cb_t cb) {
+    assert(timer < BL_SIM_TIMER_DEVS && channel < BL_SIM_TIMER_CHANNELS);
+    bl_sim_node_t *node = bl_sim_current();
+    bl_sim_timer_channel_t *ch = &node->timers[timer].channels[channel];
+
+    uint64_t now = _counter(node, timer);
+    ch->callback = cb;
+    ch->period_us = us;
+    ch->one_shot = one_shot;
+    ch->armed = true;
+    ch->generation++;
+    ch->deadline = now + us;
+    if (us == 0) {
+        // the counter has moved past CC by the time it is written
+        ch->deadline += 1ULL << 32;
+    }
+    bl_sim_schedule_timer(node, timer, channel);
+}
@@ -0,0 +1,58 @@
+#ifndef __NRF_H
+#define __NRF_H
+
+/**
+ * @defgroup    sim_nrf     Host stand-in for the nRF device header
+ * @ingroup     sim
+ * @brief       Just enough of the nRF MDK for the blink stack to build on a Linux host
+ *
+ * The FICR is modelled per simulated instance, so that bl_device_id() returns
+ * the identifier of the instance currently running.
+ *
+ * @{
+ * @file
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+
+//=========================== defines ==========================================
+
+typedef struct {
+    uint32_t DEVICEID[2];
+    uint32_t DEVICEADDR[2];
+} NRF_FICR_Type;
+
+typedef struct {
+    uint32_t OUT;
+    uint32_t OUTSET;
+    uint32_t OUTCLR;
+    uint32_t DIRSET;
+} NRF_GPIO_Type;
+
+#define GPIOTE_CONFIG_POLARITY_LoToHi (1UL)
+#define GPIOTE_CONFIG_POLARITY_HiToLo (2UL)
+#define GPIOTE_CONFIG_POLARITY_Toggle (3UL)
+
+#define NRF_FICR    (bl_sim_ficr())
+#define NRF_P0      (&bl_sim_gpio_ports[0])
+#define NRF_P1      (&bl_sim_gpio_ports[1])
+
+// there are no interrupts on the host, the event engine serializes all handlers
+#define __SEV()             ((void)0)
+#define __WFE()             ((void)0)
+#define __NOP()             ((void)0)
+#define __disable_irq()     ((void)0)
+#define __enable_irq()      ((void)0)
+#define __DMB()             __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+//=========================== variables ========================================
+
+extern NRF_GPIO_Type bl_sim_gpio_ports[2];
+
+//=========================== prototypes =======================================
+
+NRF_FICR_Type *bl_sim_ficr(void);
+
+#endif // __NRF_H
@@ -0,0 +1,13 @@
+#ifndef __NRF_PERIPHERALS_H
+#define __NRF_PERIPHERALS_H
+
+/**
+ * @file
+ * @ingroup     sim_nrf
+ *
+ * @brief       Host stand-in for the nRF peripherals header (intentionally empty)
+ *
+ * @copyright Inria, 2025-now
+ */
+
+#endif // __NRF_PERIPHERALS_H
@@ -0,0 +1,123 @@
+/**
+ * @file
+ * @ingroup     sim
+ *
+ * @brief       Command line front-end of the blink simulator
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "scenario.h"
+#include "sim.h"
+#include "trace.h"
+
+//=========================== prototypes =======================================
+
+static void _usage(const char *argv0);
+static void _print_trace(size_t index);
+
+//=========================== main =============================================
+
+int main(int argc, char **argv) {
+    bl_sim_scenario_t scenario;
+    bl_sim_scenario_defaults(&scenario);
+    enum { OUTPUT_TEXT, OUTPUT_CSV, OUTPUT_JSON } output = OUTPUT_TEXT;
+    long trace_index = -1;
+
+    static const struct option options[] = {
+        BL_SIM_SCENARIO_OPTIONS,
+        { "csv",        no_argument,       NULL, 'c' },
+        { "json",       no_argument,       NULL, 'j' },
+        { "trace",      required_argument, NULL, 't' },
+        { "help",       no_argument,       NULL, 'h' },
+        { 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, BL_SIM_SCENARIO_OPTSTRING "cjt:h", options, NULL)) != -1) {
+        int parsed = bl_sim_scenario_parse_option(&scenario, opt, optarg);
+        if (parsed < 0) {
+            fprintf(stderr, "invalid value '%s'\n", optarg);
+            return EXIT_FAILURE;
+        } else if (parsed > 0) {
+            continue;
+        }
+        switch (opt) {
+            case 'c': output = OUTPUT_CSV; break;
+            case 'j': output = OUTPUT_JSON; break;
+            case 't':
+                trace_index = strtol(optarg, NULL, 10);
+                if (!BLINK_TRACE_ENABLED) {
+                    fprintf(stderr, "--trace needs a build with BLINK_TRACE_ENABLED, see README.md\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'h':
+                _usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                _usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    bl_sim_metrics_t metrics;
+    if (bl_sim_scenario_run(&scenario, &metrics) != 0) {
+        fprintf(stderr, "invalid scenario\n");
+        return EXIT_FAILURE;
+    }
+
+    switch (output) {
+        case OUTPUT_TEXT:
+            bl_sim_metrics_print(stdout, &scenario, &metrics);
+            break;
+        case OUTPUT_CSV:
+            bl_sim_metrics_print_csv_header(stdout);
+            bl_sim_metrics_print_csv(stdout, &scenario, &metrics);
+            break;
+        case OUTPUT_JSON:
+            bl_sim_metrics_print_json(stdout, &scenario, &metrics);
+            break;
+    }
+    if (trace_index >= 0) {
+        _print_trace(trace_index);
+    }
+    return EXIT_SUCCESS;
+}
+
+//=========================== private ==========================================
+
+static void _usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [options]\n", argv0);
+    bl_sim_scenario_print_usage(stderr);
+    fprintf(stderr,
+            "  -c, --csv                       print a CSV header and row\n"
+            "  -j, --json                      print a JSON object\n"
+            "  -t, --trace INDEX               print the slot trace of an instance (gateways first), for blink_trace\n");
+}
+
+static void _print_trace(size_t index) {
+#if BLINK_TRACE_ENABLED
+    size_t nodes_len;
+    bl_sim_node_t *nodes = bl_sim_nodes(&nodes_len);
+    if (index >= nodes_len) {
+        fprintf(stderr, "no instance %zu\n", index);
+        return;
+    }
+    bl_sim_switch(&nodes[index]);
+
+    static bl_trace_record_t records[BLINK_TRACE_LEN];
+    uint32_t lost;
+    size_t len = bl_trace_read(records, BLINK_TRACE_LEN, &lost);
+    for (size_t i = 0; i < len; i++) {
+        char line[BLINK_TRACE_LINE_MAX_LEN];
+        bl_trace_format(&records[i], line);
+        puts(line);
+    }
+#else
+    (void)index;
+#endif
+}
@@ -0,0 +1,739 @@
+/**
+ * @file
+ * @ingroup     sim_scenario
+ *
+ * @brief       Gateways and nodes running the example apps, and the metrics collected from them
+ *
+ * Gateways behave like app/03app_gateway and nodes like app/03app_node, except that
+ * traffic is periodic and each payload carries its sender and sending time, so that
+ * delivery and latency can be measured end to end.
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "blink.h"
+#include "packet.h"
+#include "generator.h"
+#include "sim.h"
+#include "scenario.h"
+#include "association.h" // after sim_tunables.h, for its parameters
+
+//=========================== defines ==========================================
+
+#define SIM_PAYLOAD_LEN     (2 + 8) ///< sender index, then sending time in ns
+#define SIM_CONTROL_LEN     (SIM_PAYLOAD_LEN + 1) ///< control packets are one byte longer, to tell them apart
+
+typedef struct {
+    bool            synced;         ///< Synchronized to a gateway at least once
+    bool            joined;         ///< Joined at least once
+    bl_sim_time_t   sync_ns;        ///< First synchronization, relative to boot
+    bool            connected;
+    bl_sim_time_t   join_ns;        ///< First BLINK_CONNECTED, relative to boot
+    int32_t         member_of;      ///< Gateway that lists this node as joined, -1 if none
+    size_t          control_next;   ///< Gateways only, node that gets the next control packet
+} scenario_node_t;
+
+typedef struct {
+    double          *values_ms;
+    size_t          len;
+    size_t          cap;
+} scenario_latencies_t;
+
+typedef struct {
+    const bl_sim_scenario_t *scenario;
+    bl_sim_metrics_t        *metrics;
+    scenario_node_t         *nodes;         ///< Indexed like the engine instances
+    uint64_t                *device_ids;
+    bl_sim_time_t           end_ns;
+    bl_sim_time_t           cutoff_ns;      ///< Packets sent after this are not accounted, they may still be in flight
+    scenario_latencies_t    uplink_latencies;
+    scenario_latencies_t    downlink_latencies;
+    scenario_latencies_t    control_latencies;
+    uint64_t                rng_state;
+} scenario_vars_t;
+
+//=========================== variables ========================================
+
+extern const schedule_t schedule_minuscule, schedule_tiny, schedule_huge;
+
+bl_sim_tunables_t bl_sim_tunables = BL_SIM_TUNABLES_DEFAULT;
+
+static schedule_t _generated_schedule; // shared by all the gateways
+
+static scenario_vars_t _scenario_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static const schedule_t *_schedule_from_scenario(const bl_sim_scenario_t *scenario);
+static int32_t _index_of(uint64_t device_id);
+static void _gateway_boot(bl_sim_node_t *node);
+static void _node_boot(bl_sim_node_t *node);
+static void _gateway_event(bl_event_t event, bl_event_data_t event_data);
+static void _node_event(bl_event_t event, bl_event_data_t event_data);
+static void _gateway_tx(bl_sim_node_t *node);
+static void _gateway_control_tx(bl_sim_node_t *node);
+static void _node_tx(bl_sim_node_t *node);
+static void _main_loop(bl_sim_node_t *node);
+static void _build_payload(uint8_t *payload, uint16_t sender);
+static bool _parse_payload(const blink_packet_t *packet, uint16_t *sender, bl_sim_time_t *sent_ns);
+static bool _is_streamer(size_t index);
+static void _add_latency(scenario_latencies_t *latencies, double latency_ms);
+static double _percentile(double *values, size_t len, double p);
+static int _compare_double(const void *a, const void *b);
+
+//=========================== public ===========================================
+
+void bl_sim_scenario_defaults(bl_sim_scenario_t *scenario) {
+    *scenario = (bl_sim_scenario_t){
+        .seed = 1,
+        .n_gateways = 1,
+        .n_nodes = 100,
+        .schedule_id = 1, // schedule_huge
+        .duration_s = 60,
+        .boot_spread_s = 5,
+        .drift_ppm = 20,
+        .area_m = 20,
+        .loss_rate = 0,
+        .uplink_period_ms = 1000,
+        .downlink_period_ms = 1000,
+        .streamer_period_ms = 50,
+        .max_packet_len = 238, // BLINK_NETWORK_MAX_PACKET_LEN
+        .tunables = BL_SIM_TUNABLES_DEFAULT,
+    };
+}
+
+int bl_sim_scenario_run(const bl_sim_scenario_t *scenario, bl_sim_metrics_t *metrics) {
+    size_t n_instances = scenario->n_gateways + scenario->n_nodes;
+    if (n_instances > BL_SIM_MAX_NODES || scenario->n_gateways == 0 || _schedule_from_scenario(scenario) == NULL) {
+        return -1;
+    }
+    if (!bl_sim_tunables_valid(&scenario->tunables)) {
+        return -1;
+    }
+    bl_sim_tunables = scenario->tunables;
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    memset(metrics, 0, sizeof(bl_sim_metrics_t));
+    free(_scenario_vars.nodes);
+    free(_scenario_vars.device_ids);
+    free(_scenario_vars.uplink_latencies.values_ms);
+    free(_scenario_vars.downlink_latencies.values_ms);
+    free(_scenario_vars.control_latencies.values_ms);
+    memset(&_scenario_vars, 0, sizeof(_scenario_vars));
+    _scenario_vars.scenario = scenario;
+    _scenario_vars.metrics = metrics;
+    _scenario_vars.nodes = calloc(n_instances, sizeof(scenario_node_t));
+    _scenario_vars.device_ids = calloc(n_instances, sizeof(uint64_t));
+    _scenario_vars.rng_state = scenario->seed * 0x2545f4914f6cdd1dULL;
+    _scenario_vars.end_ns = (bl_sim_time_t)(scenario->duration_s * BL_SIM_NS_PER_S);
+    bl_sim_time_t margin = _scenario_vars.end_ns / 4 < 2 * BL_SIM_NS_PER_S ? _scenario_vars.end_ns / 4 : 2 * BL_SIM_NS_PER_S;
+    _scenario_vars.cutoff_ns = _scenario_vars.end_ns - margin;
+
+    bl_sim_config_t config = {
+        .seed = scenario->seed,
+        .area_m = scenario->area_m,
+        .path_loss_exponent = 2.5,
+        .shadowing_db = 4,
+        .loss_rate = scenario->loss_rate,
+        .interference_channel = scenario->interference_channel,
+        .interference_channel_last = scenario->interference_channel_last,
+        .interference_rate = scenario->interference_rate,
+        .main_loop = _main_loop,
+    };
+    bl_sim_init(&config);
+
+    for (size_t i = 0; i < n_instances; i++) {
+        bool is_gateway = i < scenario->n_gateways;
+        uint64_t device_id;
+        do {
+            device_id = bl_sim_rng_next(&_scenario_vars.rng_state);
+        } while (device_id == 0 || device_id == BLINK_BROADCAST_ADDRESS || _index_of(device_id) >= 0);
+        _scenario_vars.device_ids[i] = device_id;
+        _scenario_vars.nodes[i].member_of = -1;
+
+        double drift_ppm = (2 * bl_sim_rng_uniform(&_scenario_vars.rng_state) - 1) * scenario->drift_ppm;
+        // gateways start within the first 100 ms, so that their slots are not perfectly aligned
+        double boot_spread_s = is_gateway ? 0.1 : scenario->boot_spread_s;
+        bl_sim_time_t boot_ns = (bl_sim_time_t)(bl_sim_rng_uniform(&_scenario_vars.rng_state) * boot_spread_s * BL_SIM_NS_PER_S);
+        bl_sim_node_add(is_gateway ? BLINK_GATEWAY : BLINK_NODE, device_id, drift_ppm, boot_ns, is_gateway ? _gateway_boot : _node_boot);
+    }
+
+    metrics->events = bl_sim_run(_scenario_vars.end_ns);
+
+    // join latencies, and radio usage
+    size_t nodes_len;
+    bl_sim_node_t *nodes = bl_sim_nodes(&nodes_len);
+    double *join_ms = calloc(n_instances, sizeof(double));
+    double *sync_ms = calloc(n_instances, sizeof(double));
+    size_t n_synced = 0;
+    double node_duty = 0, gateway_duty = 0;
+    double node_current = 0, gateway_current = 0;
+    for (size_t i = 0; i < nodes_len; i++) {
+        bl_sim_time_t alive = _scenario_vars.end_ns - nodes[i].boot_ns;
+        double duty = alive > 0 ? (double)(nodes[i].radio_stats.rx_ns + nodes[i].radio_stats.tx_ns) / alive : 0;
+        bl_sim_switch(&nodes[i]);
+        double current = blink_get_average_current_ua();
+        bl_stats_t stats;
+        blink_get_stats(&stats);
+        metrics->oversized_drops += stats.oversized_drops;
+        if (nodes[i].node_type == BLINK_GATEWAY) {
+            gateway_duty += duty;
+            gateway_current += current;
+            metrics->schedule_switches += stats.schedule_switches;
+            metrics->extra_cells_granted += stats.extra_cells_granted;
+            metrics->max_packet_len = blink_get_max_packet_len();
+            metrics->queue_drops += stats.queue_drops;
+            metrics->ttl_drops += stats.ttl_drops;
+            if (stats.queue_high_watermark > metrics->queue_high_watermark) {
+                metrics->queue_high_watermark = stats.queue_high_watermark;
+            }
+            metrics->channel_blacklist_changes += stats.channel_blacklist_changes;
+            metrics->blacklisted_channels += (double)__builtin_popcountll(blink_get_channel_blacklist()) / scenario->n_gateways;
+            continue;
+        }
+        node_duty += duty;
+        node_current += current;
+        scenario_node_t *node = &_scenario_vars.nodes[i];
+        if (node->synced) {
+            sync_ms[n_synced++] = (double)node->sync_ns / BL_SIM_NS_PER_MS;
+        }
+        if (node->joined) {
+            join_ms[metrics->n_joined++] = (double)node->join_ns / BL_SIM_NS_PER_MS;
+        }
+        if (node->connected) {
+            metrics->n_connected++;
+        }
+    }
+    metrics->n_nodes = scenario->n_nodes;
+    metrics->join_ms_p50 = _percentile(join_ms, metrics->n_joined, 0.50);
+    metrics->join_ms_p90 = _percentile(join_ms, metrics->n_joined, 0.90);
+    metrics->join_ms_p99 = _percentile(join_ms, metrics->n_joined, 0.99);
+    metrics->join_ms_max = _percentile(join_ms, metrics->n_joined, 1.00);
+    metrics->sync_ms_p50 = _percentile(sync_ms, n_synced, 0.50);
+    metrics->sync_ms_p90 = _percentile(sync_ms, n_synced, 0.90);
+    metrics->sync_ms_max = _percentile(sync_ms, n_synced, 1.00);
+    metrics->node_radio_duty = scenario->n_nodes ? node_duty / scenario->n_nodes : 0;
+    metrics->gateway_radio_duty = gateway_duty / scenario->n_gateways;
+    metrics->node_current_ua = scenario->n_nodes ? node_current / scenario->n_nodes : 0;
+    metrics->gateway_current_ua = gateway_current / scenario->n_gateways;
+    free(join_ms);
+    free(sync_ms);
+
+    metrics->uplink_pdr = metrics->uplink_sent ? (double)metrics->uplink_received / metrics->uplink_sent : 0;
+    metrics->downlink_pdr = metrics->downlink_sent ? (double)metrics->downlink_received / metrics->downlink_sent : 0;
+    metrics->streamer_pdr = metrics->streamer_sent ? (double)metrics->streamer_received / metrics->streamer_sent : 0;
+    metrics->control_pdr = metrics->control_sent ? (double)metrics->control_received / metrics->control_sent : 0;
+    scenario_latencies_t *uplink = &_scenario_vars.uplink_latencies;
+    scenario_latencies_t *downlink = &_scenario_vars.downlink_latencies;
+    scenario_latencies_t *control = &_scenario_vars.control_latencies;
+    metrics->uplink_latency_ms_p50 = _percentile(uplink->values_ms, uplink->len, 0.50);
+    metrics->uplink_latency_ms_p99 = _percentile(uplink->values_ms, uplink->len, 0.99);
+    metrics->downlink_latency_ms_p50 = _percentile(downlink->values_ms, downlink->len, 0.50);
+    metrics->downlink_latency_ms_p99 = _percentile(downlink->values_ms, downlink->len, 0.99);
+    metrics->control_latency_ms_p50 = _percentile(control->values_ms, control->len, 0.50);
+    metrics->control_latency_ms_p99 = _percentile(control->values_ms, control->len, 0.99);
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    metrics->wall_s = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+    return 0;
+}
+
+bool bl_sim_tunables_valid(const bl_sim_tunables_t *tunables) {
+    uint16_t m_bits = tunables->bloom_m_bits;
+    return tunables->backoff_n_min <= tunables->backoff_n_max && tunables->backoff_n_max <= 16
+        && m_bits >= 8 && m_bits <= BL_SIM_BLOOM_M_BITS_MAX && (m_bits & (m_bits - 1)) == 0
+        && tunables->bloom_k_hashes > 0 && tunables->max_slotframes_no_rx_leave > 0;
+}
+
+uint8_t bl_sim_scenario_schedule_id(const char *name) {
+    if (strcmp(name, "huge") == 0) {
+        return schedule_huge.id;
+    } else if (strcmp(name, "tiny") == 0) {
+        return schedule_tiny.id;
+    } else if (strcmp(name, "minuscule") == 0) {
+        return schedule_minuscule.id;
+    }
+    return 0;
+}
+
+int bl_sim_scenario_parse_option(bl_sim_scenario_t *scenario, int opt, const char *arg) {
+    bl_sim_tunables_t *tunables = &scenario->tunables;
+    switch (opt) {
+        case 'g': scenario->n_gateways = strtoul(arg, NULL, 0); break;
+        case 'n': scenario->n_nodes = strtoul(arg, NULL, 0); break;
+        case 's': {
+            unsigned n_uplink, n_downlink, n_shared_uplink, n_beacons = 3;
+            if (sscanf(arg, "gen:%u,%u,%u,%u", &n_uplink, &n_downlink, &n_shared_uplink, &n_beacons) >= 3) {
+                scenario->schedule_id = BLINK_SCHEDULE_ID_GENERATED;
+                scenario->schedule_descriptor = (bl_schedule_descriptor_t){
+                    .n_beacons = n_beacons,
+                    .n_shared_uplink = n_shared_uplink,
+                    .n_downlink = n_downlink,
+                    .n_uplink = n_uplink,
+                };
+                break;
+            }
+            scenario->schedule_id = bl_sim_scenario_schedule_id(arg);
+            if (scenario->schedule_id == 0) {
+                return -1;
+            }
+            break;
+        }
+        case 'd': scenario->duration_s = strtod(arg, NULL); break;
+        case 'S': scenario->seed = strtoull(arg, NULL, 0); break;
+        case 'b': scenario->boot_spread_s = strtod(arg, NULL); break;
+        case 'p': scenario->drift_ppm = strtod(arg, NULL); break;
+        case 'a': scenario->area_m = strtod(arg, NULL); break;
+        case 'l': scenario->loss_rate = strtod(arg, NULL); break;
+        case 'u': scenario->uplink_period_ms = strtoul(arg, NULL, 0); break;
+        case 'D': scenario->downlink_period_ms = strtoul(arg, NULL, 0); break;
+        case BL_SIM_OPT_DOWNLINK_TTL: scenario->downlink_ttl = strtoul(arg, NULL, 0); break;
+        case BL_SIM_OPT_CONTROL: scenario->control_period_ms = strtoul(arg, NULL, 0); break;
+        case BL_SIM_OPT_AGGREGATE: scenario->aggregate = true; break;
+        case BL_SIM_OPT_BACKOFF_N_MIN: tunables->backoff_n_min = strtoul(arg, NULL, 0); break;
+        case BL_SIM_OPT_BACKOFF_N_MAX: tunables->backoff_n_max = strtoul(arg, NULL, 0); break;
+        case BL_SIM_OPT_HYSTERESIS: tunables->handover_rssi_hysteresis = strtol(arg, NULL, 0); break;
+        case BL_SIM_OPT_BLOOM_M_BITS: tunables->bloom_m_bits = strtoul(arg, NULL, 0); break;
+        case BL_SIM_OPT_BLOOM_K_HASHES: tunables->bloom_k_hashes = strtoul(arg, NULL, 0); break;
+        case BL_SIM_OPT_NO_RX_LEAVE: tunables->max_slotframes_no_rx_leave = strtoul(arg, NULL, 0); break;
+        case BL_SIM_OPT_ELASTIC: scenario->elastic = true; break;
+        case BL_SIM_OPT_STREAMERS: scenario->n_streamers = strtoul(arg, NULL, 0); break;
+        case BL_SIM_OPT_STREAMER_UPLINK:
+            scenario->streamer_period_ms = strtoul(arg, NULL, 0);
+            if (scenario->streamer_period_ms == 0) {
+                return -1;
+            }
+            break;
+        case BL_SIM_OPT_MAX_PACKET_LEN: {
+            unsigned long max_packet_len = strtoul(arg, NULL, 0);
+            if (max_packet_len == 0 || max_packet_len > 255) {
+                return -1;
+            }
+            scenario->max_packet_len = max_packet_len;
+            break;
+        }
+        case BL_SIM_OPT_INTERFERENCE: {
+            unsigned channel, last;
+            double rate;
+            if (sscanf(arg, "%u-%u:%lf", &channel, &last, &rate) != 3) {
+                if (sscanf(arg, "%u:%lf", &channel, &rate) != 2) {
+                    return -1;
+                }
+                last = channel;
+            }
+            if (channel == 0 || last < channel || last > 39 || rate < 0 || rate > 1) {
+                return -1;
+            }
+            scenario->interference_channel = channel;
+            scenario->interference_channel_last = last;
+            scenario->interference_rate = rate;
+            break;
+        }
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+void bl_sim_scenario_print_usage(FILE *out) {
+    fprintf(out,
+            "  -g, --gateways N                number of gateways (1)\n"
+            "  -n, --nodes N                   number of nodes (100)\n"
+            "  -s, --schedule NAME             gateway schedule: huge, tiny or minuscule (huge),\n"
+            "                                  or gen:U,D,S[,B] to generate one with U uplink, D downlink,\n"
+            "                                  S shared uplink and B beacon (3) cells\n"
+            "  -d, --duration S                simulated time, in seconds (60)\n"
+            "  -S, --seed N                    random seed (1)\n"
+            "  -b, --boot-spread S             nodes power on within this time, in seconds (5)\n"
+            "  -p, --ppm PPM                   maximum crystal drift (20)\n"
+            "  -a, --area M                    side of the deployment square, in meters (20)\n"
+            "  -l, --loss P                    extra frame loss probability (0)\n"
+            "  -u, --uplink MS                 uplink period of each node, 0 to disable (1000)\n"
+            "  -D, --downlink MS               downlink period of each gateway, 0 to disable (1000)\n"
+            "      --downlink-ttl SLOTS        downlink packets not sent within this many slots are dropped, 0 for never (0)\n"
+            "      --control MS                period of the control packets from each gateway, to its nodes in turn, 0 to disable (0)\n"
+            "      --aggregate                 gateways pack the downlink payloads of their nodes into aggregated frames\n"
+            "      --backoff-n-min N           BLINK_BACKOFF_N_MIN (5)\n"
+            "      --backoff-n-max N           BLINK_BACKOFF_N_MAX (9)\n"
+            "      --handover-hysteresis DB    BLINK_HANDOVER_RSSI_HYSTERESIS (9)\n"
+            "      --bloom-m-bits N            BLINK_BLOOM_M_BITS, a power of 2 up to 1024 (1024)\n"
+            "      --bloom-k-hashes N          BLINK_BLOOM_K_HASHES (2)\n"
+            "      --slotframes-no-rx-leave N  BLINK_MAX_SLOTFRAMES_NO_RX_LEAVE (5)\n"
+            "      --elastic                   gateways switch between the built-in schedules with the number of nodes\n"
+            "      --streamers N               number of nodes sending at the streamer uplink period instead (0)\n"
+            "      --streamer-uplink MS        uplink period of the streamers (50)\n"
+            "      --max-packet-len N          largest frame of the networks, the slots are sized for it (238)\n"
+            "      --interference CH[-CH]:P    frames on channel CH (1 to 39), or on a range of channels, are also lost with probability P\n");
+}
+
+void bl_sim_metrics_print(FILE *out, const bl_sim_scenario_t *scenario, const bl_sim_metrics_t *metrics) {
+    if (scenario->schedule_id == BLINK_SCHEDULE_ID_GENERATED) {
+        const bl_schedule_descriptor_t *descriptor = &scenario->schedule_descriptor;
+        fprintf(out, "schedule gen:%u,%u,%u,%u, ", descriptor->n_uplink, descriptor->n_downlink, descriptor->n_shared_uplink, descriptor->n_beacons);
+    } else {
+        fprintf(out, "schedule %u, ", scenario->schedule_id);
+    }
+    fprintf(out, "%zu gateway(s), %zu nodes, %.1f s simulated, seed %llu\n",
+            scenario->n_gateways, scenario->n_nodes, scenario->duration_s, (unsigned long long)scenario->seed);
+    fprintf(out, "  joined      %zu/%zu (%zu connected at the end)\n", metrics->n_joined, metrics->n_nodes, metrics->n_connected);
+    fprintf(out, "  join        p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+            metrics->join_ms_p50, metrics->join_ms_p90, metrics->join_ms_p99, metrics->join_ms_max);
+    fprintf(out, "  sync        p50 %.1f ms, p90 %.1f ms, max %.1f ms\n", metrics->sync_ms_p50, metrics->sync_ms_p90, metrics->sync_ms_max);
+    fprintf(out, "  uplink      %u/%u delivered (PDR %.3f), latency p50 %.1f ms, p99 %.1f ms\n",
+            metrics->uplink_received, metrics->uplink_sent, metrics->uplink_pdr, metrics->uplink_latency_ms_p50, metrics->uplink_latency_ms_p99);
+    fprintf(out, "  downlink    %u/%u delivered (PDR %.3f), latency p50 %.1f ms, p99 %.1f ms\n",
+            metrics->downlink_received, metrics->downlink_sent, metrics->downlink_pdr, metrics->downlink_latency_ms_p50, metrics->downlink_latency_ms_p99);
+    if (scenario->control_period_ms > 0) {
+        fprintf(out, "  control     %u/%u delivered (PDR %.3f), latency p50 %.1f ms, p99 %.1f ms\n",
+                metrics->control_received, metrics->control_sent, metrics->control_pdr, metrics->control_latency_ms_p50, metrics->control_latency_ms_p99);
+    }
+    fprintf(out, "  queue       up to %u packets waiting at a gateway, %u dropped when full, %u expired\n",
+            metrics->queue_high_watermark, metrics->queue_drops, metrics->ttl_drops);
+    fprintf(out, "  radio on    nodes %.2f %%, gateways %.2f %%\n", 100 * metrics->node_radio_duty, 100 * metrics->gateway_radio_duty);
+    fprintf(out, "  current     nodes %.0f uA, gateways %.0f uA (estimated, nRF52840)\n", metrics->node_current_ua, metrics->gateway_current_ua);
+    fprintf(out, "  disconnects %u (%u handovers, %u false leaves), %u nodes left, %u gateway full\n",
+            metrics->disconnects, metrics->handovers, metrics->false_leaves, metrics->nodes_left, metrics->gateway_full);
+    if (scenario->elastic) {
+        fprintf(out, "  elastic     %u schedule switches\n", metrics->schedule_switches);
+    }
+    if (scenario->n_streamers > 0) {
+        fprintf(out, "  streamers   %u/%u delivered (PDR %.3f), %u extra cells granted\n",
+                metrics->streamer_received, metrics->streamer_sent, metrics->streamer_pdr, metrics->extra_cells_granted);
+    }
+    if (scenario->max_packet_len != 238) {
+        fprintf(out, "  slots       frames up to %u bytes, %u oversized packets dropped\n", metrics->max_packet_len, metrics->oversized_drops);
+    }
+    if (scenario->interference_channel != 0) {
+        fprintf(out, "  interference channels %u-%u, loss %.2f\n", scenario->interference_channel, scenario->interference_channel_last, scenario->interference_rate);
+    }
+    if (scenario->interference_channel != 0 || metrics->channel_blacklist_changes > 0) {
+        fprintf(out, "  channels    %u blacklist changes, %.1f data channels blacklisted at the end\n", metrics->channel_blacklist_changes, metrics->blacklisted_channels);
+    }
+    fprintf(out, "  engine      %llu events in %.2f s\n", (unsigned long long)metrics->events, metrics->wall_s);
+}
+
+void bl_sim_metrics_print_csv_header(FILE *out) {
+    fprintf(out, "seed,schedule,gateways,nodes,duration_s,backoff_n_min,backoff_n_max,handover_rssi_hysteresis,bloom_m_bits,bloom_k_hashes,max_slotframes_no_rx_leave,joined,connected,join_ms_p50,join_ms_p90,join_ms_p99,join_ms_max,sync_ms_p50,sync_ms_p90,sync_ms_max,"
+                 "uplink_sent,uplink_received,uplink_pdr,uplink_latency_ms_p50,uplink_latency_ms_p99,"
+                 "downlink_sent,downlink_received,downlink_pdr,downlink_latency_ms_p50,downlink_latency_ms_p99,"
+                 "control_sent,control_received,control_pdr,control_latency_ms_p50,control_latency_ms_p99,node_radio_duty,gateway_radio_duty,node_current_ua,gateway_current_ua,"
+                 "disconnects,handovers,false_leaves,nodes_left,gateway_full,elastic,schedule_switches,streamers,streamer_sent,streamer_received,streamer_pdr,extra_cells_granted,max_packet_len,oversized_drops,queue_high_watermark,queue_drops,ttl_drops,interference_channel,interference_channel_last,interference_rate,channel_blacklist_changes,blacklisted_channels,events,wall_s\n");
+}
+
+void bl_sim_metrics_print_csv(FILE *out, const bl_sim_scenario_t *scenario, const bl_sim_metrics_t *metrics) {
+    const bl_sim_tunables_t *tunables = &scenario->tunables;
+    fprintf(out, "%llu,%u,%zu,%zu,%.3f,%u,%u,%d,%u,%u,%u,%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%u,%u,%.5f,%.3f,%.3f,%u,%u,%.5f,%.3f,%.3f,%u,%u,%.5f,%.3f,%.3f,%.5f,%.5f,%.1f,%.1f,%u,%u,%u,%u,%u,%u,%u,%zu,%u,%u,%.5f,%u,%u,%u,%u,%u,%u,%u,%u,%.3f,%u,%.2f,%llu,%.3f\n",
+            (unsigned long long)scenario->seed, scenario->schedule_id, scenario->n_gateways, scenario->n_nodes, scenario->duration_s,
+            tunables->backoff_n_min, tunables->backoff_n_max, tunables->handover_rssi_hysteresis, tunables->bloom_m_bits, tunables->bloom_k_hashes, tunables->max_slotframes_no_rx_leave,
+            metrics->n_joined, metrics->n_connected, metrics->join_ms_p50, metrics->join_ms_p90, metrics->join_ms_p99, metrics->join_ms_max,
+            metrics->sync_ms_p50, metrics->sync_ms_p90, metrics->sync_ms_max,
+            metrics->uplink_sent, metrics->uplink_received, metrics->uplink_pdr, metrics->uplink_latency_ms_p50, metrics->uplink_latency_ms_p99,
+            metrics->downlink_sent, metrics->downlink_received, metrics->downlink_pdr, metrics->downlink_latency_ms_p50, metrics->downlink_latency_ms_p99,
+            metrics->control_sent, metrics->control_received, metrics->control_pdr, metrics->control_latency_ms_p50, metrics->control_latency_ms_p99,
+            metrics->node_radio_duty, metrics->gateway_radio_duty,
+            metrics->node_current_ua, metrics->gateway_current_ua,
+            metrics->disconnects, metrics->handovers, metrics->false_leaves, metrics->nodes_left, metrics->gateway_full,
+            scenario->elastic, metrics->schedule_switches,
+            scenario->n_streamers, metrics->streamer_sent, metrics->streamer_received, metrics->streamer_pdr, metrics->extra_cells_granted,
+            metrics->max_packet_len, metrics->oversized_drops, metrics->queue_high_watermark, metrics->queue_drops, metrics->ttl_drops,
+            scenario->interference_channel, scenario->interference_channel_last, scenario->interference_rate,
+            metrics->channel_blacklist_changes, metrics->blacklisted_channels,
+            (unsigned long long)metrics->events, metrics->wall_s);
+}
+
+void bl_sim_metrics_print_json(FILE *out, const bl_sim_scenario_t *scenario, const bl_sim_metrics_t *metrics) {
+    const bl_sim_tunables_t *tunables = &scenario->tunables;
+    fprintf(out, "{\"seed\": %llu, \"schedule\": %u, \"gateways\": %zu, \"nodes\": %zu, \"duration_s\": %.3f, ",
+            (unsigned long long)scenario->seed, scenario->schedule_id, scenario->n_gateways, scenario->n_nodes, scenario->duration_s);
+    fprintf(out, "\"tunables\": {\"backoff_n_min\": %u, \"backoff_n_max\": %u, \"handover_rssi_hysteresis\": %d, \"bloom_m_bits\": %u, \"bloom_k_hashes\": %u, \"max_slotframes_no_rx_leave\": %u}, ",
+            tunables->backoff_n_min, tunables->backoff_n_max, tunables->handover_rssi_hysteresis, tunables->bloom_m_bits, tunables->bloom_k_hashes, tunables->max_slotframes_no_rx_leave);
+    fprintf(out, "\"joined\": %zu, \"connected\": %zu, \"join_ms\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}, ",
+            metrics->n_joined, metrics->n_connected, metrics->join_ms_p50, metrics->join_ms_p90, metrics->join_ms_p99, metrics->join_ms_max);
+    fprintf(out, "\"sync_ms\": {\"p50\": %.3f, \"p90\": %.3f, \"max\": %.3f}, ", metrics->sync_ms_p50, metrics->sync_ms_p90, metrics->sync_ms_max);
+    fprintf(out, "\"uplink\": {\"sent\": %u, \"received\": %u, \"pdr\": %.5f, \"latency_ms_p50\": %.3f, \"latency_ms_p99\": %.3f}, ",
+            metrics->uplink_sent, metrics->uplink_received, metrics->uplink_pdr, metrics->uplink_latency_ms_p50, metrics->uplink_latency_ms_p99);
+    fprintf(out, "\"downlink\": {\"sent\": %u, \"received\": %u, \"pdr\": %.5f, \"latency_ms_p50\": %.3f, \"latency_ms_p99\": %.3f}, ",
+            metrics->downlink_sent, metrics->downlink_received, metrics->downlink_pdr, metrics->downlink_latency_ms_p50, metrics->downlink_latency_ms_p99);
+    fprintf(out, "\"control\": {\"sent\": %u, \"received\": %u, \"pdr\": %.5f, \"latency_ms_p50\": %.3f, \"latency_ms_p99\": %.3f}, ",
+            metrics->control_sent, metrics->control_received, metrics->control_pdr, metrics->control_latency_ms_p50, metrics->control_latency_ms_p99);
+    fprintf(out, "\"radio_duty\": {\"node\": %.5f, \"gateway\": %.5f}, ", metrics->node_radio_duty, metrics->gateway_radio_duty);
+    fprintf(out, "\"current_ua\": {\"node\": %.1f, \"gateway\": %.1f}, ", metrics->node_current_ua, metrics->gateway_current_ua);
+    fprintf(out, "\"disconnects\": %u, \"handovers\": %u, \"false_leaves\": %u, \"nodes_left\": %u, \"gateway_full\": %u, ",
+            metrics->disconnects, metrics->handovers, metrics->false_leaves, metrics->nodes_left, metrics->gateway_full);
+    fprintf(out, "\"elastic\": %s, \"schedule_switches\": %u, ", scenario->elastic ? "true" : "false", metrics->schedule_switches);
+    fprintf(out, "\"streamers\": {\"nodes\": %zu, \"sent\": %u, \"received\": %u, \"pdr\": %.5f}, \"extra_cells_granted\": %u, ",
+            scenario->n_streamers, metrics->streamer_sent, metrics->streamer_received, metrics->streamer_pdr, metrics->extra_cells_granted);
+    fprintf(out, "\"max_packet_len\": %u, \"oversized_drops\": %u, ", metrics->max_packet_len, metrics->oversized_drops);
+    fprintf(out, "\"queue\": {\"high_watermark\": %u, \"drops\": %u, \"ttl_drops\": %u}, ", metrics->queue_high_watermark, metrics->queue_drops, metrics->ttl_drops);
+    fprintf(out, "\"interference\": {\"channel\": %u, \"channel_last\": %u, \"rate\": %.3f}, ",
+            scenario->interference_channel, scenario->interference_channel_last, scenario->interference_rate);
+    fprintf(out, "\"channel_blacklist_changes\": %u, \"blacklisted_channels\": %.2f, ", metrics->channel_blacklist_changes, metrics->blacklisted_channels);
+    fprintf(out, "\"events\": %llu, \"wall_s\": %.3f}\n", (unsigned long long)metrics->events, metrics->wall_s);
+}
+
+//=========================== callbacks ========================================
+
+static void _gateway_event(bl_event_t event, bl_event_data_t event_data) {
+    bl_sim_node_t *gateway = bl_sim_current();
+    bl_sim_metrics_t *metrics = _scenario_vars.metrics;
+
+    switch (event) {
+        case BLINK_NEW_PACKET: {
+            uint16_t sender;
+            bl_sim_time_t sent_ns;
+            if (_parse_payload(&event_data.data.new_packet, &sender, &sent_ns) && sent_ns <= _scenario_vars.cutoff_ns) {
+                metrics->uplink_received++;
+                if (_is_streamer(sender)) {
+                    metrics->streamer_received++;
+                }
+                _add_latency(&_scenario_vars.uplink_latencies, (double)(bl_sim_now() - sent_ns) / BL_SIM_NS_PER_MS);
+            }
+            break;
+        }
+        case BLINK_NODE_JOINED: {
+            int32_t index = _index_of(event_data.data.node_info.node_id);
+            if (index >= 0) {
+                _scenario_vars.nodes[index].member_of = gateway->index;
+            }
+            break;
+        }
+        case BLINK_NODE_LEFT: {
+            metrics->nodes_left++;
+            int32_t index = _index_of(event_data.data.node_info.node_id);
+            if (index >= 0 && _scenario_vars.nodes[index].member_of == gateway->index) {
+                _scenario_vars.nodes[index].member_of = -1;
+            }
+            break;
+        }
+        case BLINK_ERROR:
+            if (event_data.tag == BLINK_GATEWAY_FULL) {
+                metrics->gateway_full++;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void _node_event(bl_event_t event, bl_event_data_t event_data) {
+    bl_sim_node_t *node = bl_sim_current();
+    scenario_node_t *sc_node = &_scenario_vars.nodes[node->index];
+    bl_sim_metrics_t *metrics = _scenario_vars.metrics;
+
+    switch (event) {
+        case BLINK_NEW_PACKET: {
+            uint16_t sender;
+            bl_sim_time_t sent_ns;
+            if (_parse_payload(&event_data.data.new_packet, &sender, &sent_ns) && sent_ns <= _scenario_vars.cutoff_ns) {
+                double latency_ms = (double)(bl_sim_now() - sent_ns) / BL_SIM_NS_PER_MS;
+                if (event_data.data.new_packet.payload_len == SIM_CONTROL_LEN) {
+                    metrics->control_received++;
+                    _add_latency(&_scenario_vars.control_latencies, latency_ms);
+                } else {
+                    metrics->downlink_received++;
+                    _add_latency(&_scenario_vars.downlink_latencies, latency_ms);
+                }
+            }
+            break;
+        }
+        case BLINK_CONNECTED:
+            sc_node->connected = true;
+            if (!sc_node->joined) {
+                sc_node->joined = true;
+                sc_node->join_ns = bl_sim_now() - node->boot_ns;
+            }
+            break;
+        case BLINK_DISCONNECTED: {
+            sc_node->connected = false;
+            metrics->disconnects++;
+            if (event_data.tag == BLINK_HANDOVER) {
+                metrics->handovers++;
+            } else if (event_data.tag == BLINK_PEER_LOST_TIMEOUT || event_data.tag == BLINK_PEER_LOST_BLOOM) {
+                int32_t gateway = _index_of(event_data.data.gateway_info.gateway_id);
+                if (gateway >= 0 && sc_node->member_of == gateway) {
+                    // the gateway still counts this node as joined
+                    metrics->false_leaves++;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+//=========================== private ==========================================
+
+static void _gateway_boot(bl_sim_node_t *node) {
+    blink_gateway_set_max_packet_len(_scenario_vars.scenario->max_packet_len);
+    blink_init(BLINK_GATEWAY, _schedule_from_scenario(_scenario_vars.scenario), _gateway_event);
+    blink_gateway_set_elastic_schedule(_scenario_vars.scenario->elastic);
+    if (_scenario_vars.scenario->downlink_period_ms > 0) {
+        bl_sim_time_t phase = (bl_sim_time_t)(bl_sim_rng_uniform(&_scenario_vars.rng_state) * _scenario_vars.scenario->downlink_period_ms * BL_SIM_NS_PER_MS);
+        bl_sim_schedule_call(node, bl_sim_now() + phase, _gateway_tx);
+    }
+    if (_scenario_vars.scenario->control_period_ms > 0) {
+        bl_sim_time_t phase = (bl_sim_time_t)(bl_sim_rng_uniform(&_scenario_vars.rng_state) * _scenario_vars.scenario->control_period_ms * BL_SIM_NS_PER_MS);
+        bl_sim_schedule_call(node, bl_sim_now() + phase, _gateway_control_tx);
+    }
+}
+
+static void _node_boot(bl_sim_node_t *node) {
+    blink_init(BLINK_NODE, &schedule_minuscule, _node_event);
+    if (_scenario_vars.scenario->uplink_period_ms > 0) {
+        bl_sim_time_t phase = (bl_sim_time_t)(bl_sim_rng_uniform(&_scenario_vars.rng_state) * _scenario_vars.scenario->uplink_period_ms * BL_SIM_NS_PER_MS);
+        bl_sim_schedule_call(node, bl_sim_now() + phase, _node_tx);
+    }
+}
+
+static void _gateway_tx(bl_sim_node_t *node) {
+    uint64_t nodes[BLINK_N_UPLINK_CELLS_MAX] = { 0 };
+    uint8_t packet[BLINK_PACKET_MAX_SIZE] = { 0 };
+    uint8_t payload[SIM_PAYLOAD_LEN];
+    static uint8_t payloads[BLINK_N_UPLINK_CELLS_MAX * SIM_PAYLOAD_LEN];
+
+    size_t nodes_len = blink_gateway_get_nodes(nodes);
+    if (_scenario_vars.scenario->aggregate) {
+        // all of them in as few frames as possible
+        for (size_t i = 0; i < nodes_len; i++) {
+            _build_payload(&payloads[i * SIM_PAYLOAD_LEN], node->index);
+        }
+        blink_gateway_tx_aggregated(nodes, payloads, SIM_PAYLOAD_LEN, nodes_len);
+        if (bl_sim_now() <= _scenario_vars.cutoff_ns) {
+            _scenario_vars.metrics->downlink_sent += nodes_len;
+        }
+        nodes_len = 0;
+    }
+    for (size_t i = 0; i < nodes_len; i++) {
+        _build_payload(payload, node->index);
+        uint8_t packet_len = bl_build_packet_data(packet, nodes[i], payload, SIM_PAYLOAD_LEN);
+        blink_tx_priority(packet, packet_len, BLINK_PRIORITY_BULK, _scenario_vars.scenario->downlink_ttl);
+        if (bl_sim_now() <= _scenario_vars.cutoff_ns) {
+            _scenario_vars.metrics->downlink_sent++;
+        }
+    }
+    bl_sim_schedule_call(node, bl_sim_now() + _scenario_vars.scenario->downlink_period_ms * BL_SIM_NS_PER_MS, _gateway_tx);
+}
+
+// to one node at a time, in turn
+static void _gateway_control_tx(bl_sim_node_t *node) {
+    uint64_t nodes[BLINK_N_UPLINK_CELLS_MAX] = { 0 };
+    uint8_t packet[BLINK_PACKET_MAX_SIZE] = { 0 };
+    uint8_t payload[SIM_CONTROL_LEN] = { 0 };
+    scenario_node_t *sc_gateway = &_scenario_vars.nodes[node->index];
+
+    size_t nodes_len = blink_gateway_get_nodes(nodes);
+    if (nodes_len > 0) {
+        sc_gateway->control_next %= nodes_len;
+        _build_payload(payload, node->index);
+        uint8_t packet_len = bl_build_packet_data(packet, nodes[sc_gateway->control_next++], payload, SIM_CONTROL_LEN);
+        blink_tx_priority(packet, packet_len, BLINK_PRIORITY_CONTROL, 0);
+        if (bl_sim_now() <= _scenario_vars.cutoff_ns) {
+            _scenario_vars.metrics->control_sent++;
+        }
+    }
+    bl_sim_schedule_call(node, bl_sim_now() + _scenario_vars.scenario->control_period_ms * BL_SIM_NS_PER_MS, _gateway_control_tx);
+}
+
+static void _node_tx(bl_sim_node_t *node) {
+    if (blink_node_is_connected()) {
+        uint8_t payload[SIM_PAYLOAD_LEN];
+        _build_payload(payload, node->index);
+        blink_node_tx_payload(payload, SIM_PAYLOAD_LEN);
+        if (bl_sim_now() <= _scenario_vars.cutoff_ns) {
+            _scenario_vars.metrics->uplink_sent++;
+            if (_is_streamer(node->index)) {
+                _scenario_vars.metrics->streamer_sent++;
+            }
+        }
+    }
+    uint32_t period_ms = _is_streamer(node->index) ? _scenario_vars.scenario->streamer_period_ms : _scenario_vars.scenario->uplink_period_ms;
+    bl_sim_schedule_call(node, bl_sim_now() + period_ms * BL_SIM_NS_PER_MS, _node_tx);
+}
+
+static void _main_loop(bl_sim_node_t *node) {
+    scenario_node_t *sc_node = &_scenario_vars.nodes[node->index];
+    if (node->node_type == BLINK_NODE && !sc_node->synced && bl_assoc_get_state() >= JOIN_STATE_SYNCED) {
+        // the end of a scan, there is no event for it
+        sc_node->synced = true;
+        sc_node->sync_ns = bl_sim_now() - node->boot_ns;
+    }
+    blink_event_loop();
+}
+
+static const schedule_t *_schedule_from_scenario(const bl_sim_scenario_t *scenario) {
+    if (scenario->schedule_id == BLINK_SCHEDULE_ID_GENERATED) {
+        if (!bl_generator_build_schedule(&scenario->schedule_descriptor, &_generated_schedule)) {
+            return NULL;
+        }
+        return &_generated_schedule;
+    }
+    const schedule_t *schedules[] = { &schedule_huge, &schedule_tiny, &schedule_minuscule };
+    for (size_t i = 0; i < sizeof(schedules) / sizeof(schedules[0]); i++) {
+        if (schedules[i]->id == scenario->schedule_id) {
+            return schedules[i];
+        }
+    }
+    return NULL;
+}
+
+static int32_t _index_of(uint64_t device_id) {
+    // linear, only used on joins, leaves and disconnects
+    size_t n_instances = _scenario_vars.scenario->n_gateways + _scenario_vars.scenario->n_nodes;
+    for (size_t i = 0; i < n_instances; i++) {
+        if (_scenario_vars.device_ids[i] == device_id) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+static void _build_payload(uint8_t *payload, uint16_t sender) {
+    int64_t now = bl_sim_now();
+    memcpy(payload, &sender, sizeof(sender));
+    memcpy(payload + sizeof(sender), &now, sizeof(now));
+}
+
+static bool _parse_payload(const blink_packet_t *packet, uint16_t *sender, bl_sim_time_t *sent_ns) {
+    if (packet->payload_len != SIM_PAYLOAD_LEN && packet->payload_len != SIM_CONTROL_LEN) {
+        return false;
+    }
+    memcpy(sender, packet->payload, sizeof(uint16_t));
+    memcpy(sent_ns, packet->payload + sizeof(uint16_t), sizeof(int64_t));
+    return true;
+}
+
+// the first nodes, right after the gateways
+static bool _is_streamer(size_t index) {
+    size_t n_gateways = _scenario_vars.scenario->n_gateways;
+    return index >= n_gateways && index - n_gateways < _scenario_vars.scenario->n_streamers;
+}
+
+static void _add_latency(scenario_latencies_t *latencies, double latency_ms) {
+    if (latencies->len == latencies->cap) {
+        latencies->cap = latencies->cap ? latencies->cap * 2 : 1024;
+        latencies->values_ms = realloc(latencies->values_ms, latencies->cap * sizeof(double));
+    }
+    latencies->values_ms[latencies->len++] = latency_ms;
+}
+
+static double _percentile(double *values, size_t len, double p) {
+    if (len == 0) {
+        return 0;
+    }
+    qsort(values, len, sizeof(double), _compare_double);
+    size_t i = (size_t)(p * (len - 1) + 0.5);
+    return values[i];
+}
+
+static int _compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
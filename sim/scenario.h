@@ -0,0 +1,176 @@
+#ifndef __SCENARIO_H
+#define __SCENARIO_H
+
+/**
+ * @defgroup    sim_scenario    Simulation scenarios
+ * @ingroup     sim
+ * @brief       Gateways and nodes running the example apps, and the metrics collected from them
+ *
+ * @{
+ * @file
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "packet.h"
+#include "sim_tunables.h"
+
+//=========================== defines ==========================================
+
+/// Command line options shared by the simulator tools, for getopt_long
+#define BL_SIM_SCENARIO_OPTSTRING "g:n:s:d:S:b:p:a:l:u:D:"
+#define BL_SIM_SCENARIO_OPTIONS                                         \
+    { "gateways",                   required_argument, NULL, 'g' },     \
+    { "nodes",                      required_argument, NULL, 'n' },     \
+    { "schedule",                   required_argument, NULL, 's' },     \
+    { "duration",                   required_argument, NULL, 'd' },     \
+    { "seed",                       required_argument, NULL, 'S' },     \
+    { "boot-spread",                required_argument, NULL, 'b' },     \
+    { "ppm",                        required_argument, NULL, 'p' },     \
+    { "area",                       required_argument, NULL, 'a' },     \
+    { "loss",                       required_argument, NULL, 'l' },     \
+    { "uplink",                     required_argument, NULL, 'u' },     \
+    { "downlink",                   required_argument, NULL, 'D' },     \
+    { "downlink-ttl",               required_argument, NULL, BL_SIM_OPT_DOWNLINK_TTL },   \
+    { "control",                    required_argument, NULL, BL_SIM_OPT_CONTROL },        \
+    { "aggregate",                  no_argument,       NULL, BL_SIM_OPT_AGGREGATE },      \
+    { "backoff-n-min",              required_argument, NULL, BL_SIM_OPT_BACKOFF_N_MIN },   \
+    { "backoff-n-max",              required_argument, NULL, BL_SIM_OPT_BACKOFF_N_MAX },   \
+    { "handover-hysteresis",        required_argument, NULL, BL_SIM_OPT_HYSTERESIS },      \
+    { "bloom-m-bits",               required_argument, NULL, BL_SIM_OPT_BLOOM_M_BITS },    \
+    { "bloom-k-hashes",             required_argument, NULL, BL_SIM_OPT_BLOOM_K_HASHES },  \
+    { "slotframes-no-rx-leave",     required_argument, NULL, BL_SIM_OPT_NO_RX_LEAVE },     \
+    { "elastic",                    no_argument,       NULL, BL_SIM_OPT_ELASTIC },        \
+    { "streamers",                  required_argument, NULL, BL_SIM_OPT_STREAMERS },      \
+    { "streamer-uplink",            required_argument, NULL, BL_SIM_OPT_STREAMER_UPLINK }, \
+    { "max-packet-len",             required_argument, NULL, BL_SIM_OPT_MAX_PACKET_LEN }, \
+    { "interference",               required_argument, NULL, BL_SIM_OPT_INTERFERENCE }
+
+/// Long-only options, for the protocol parameters and the other scenario settings
+typedef enum {
+    BL_SIM_OPT_BACKOFF_N_MIN = 0x100,
+    BL_SIM_OPT_BACKOFF_N_MAX,
+    BL_SIM_OPT_HYSTERESIS,
+    BL_SIM_OPT_BLOOM_M_BITS,
+    BL_SIM_OPT_BLOOM_K_HASHES,
+    BL_SIM_OPT_NO_RX_LEAVE,
+    BL_SIM_OPT_ELASTIC,
+    BL_SIM_OPT_STREAMERS,
+    BL_SIM_OPT_STREAMER_UPLINK,
+    BL_SIM_OPT_MAX_PACKET_LEN,
+    BL_SIM_OPT_INTERFERENCE,
+    BL_SIM_OPT_DOWNLINK_TTL,
+    BL_SIM_OPT_CONTROL,
+    BL_SIM_OPT_AGGREGATE,
+} bl_sim_option_t;
+
+typedef struct {
+    uint64_t    seed;
+    size_t      n_gateways;
+    size_t      n_nodes;
+    uint8_t     schedule_id;            ///< Schedule used by the gateways, see all_schedules.c
+    bl_schedule_descriptor_t schedule_descriptor; ///< Used when schedule_id is BLINK_SCHEDULE_ID_GENERATED, see generator.h
+    bool        elastic;                ///< Gateways switch between the built-in schedules as nodes join and leave
+    double      duration_s;             ///< Virtual time to simulate
+    double      boot_spread_s;          ///< Nodes power on uniformly within this time
+    double      drift_ppm;              ///< Crystals drift uniformly within +/- this value
+    double      area_m;                 ///< Side of the square the instances are placed in
+    double      loss_rate;              ///< Extra frame loss probability, on top of propagation and collisions
+    uint8_t     interference_channel;   ///< First channel where frames are also lost with interference_rate, 0 for none
+    uint8_t     interference_channel_last; ///< Last one, the same as interference_channel for a single channel
+    double      interference_rate;
+    uint32_t    uplink_period_ms;       ///< Each connected node sends one packet per period, 0 to disable
+    uint32_t    downlink_period_ms;     ///< The gateways send one packet per period to each of their nodes, 0 to disable
+    uint32_t    downlink_ttl;           ///< Slots after which a downlink packet still queued is dropped, 0 for never
+    uint32_t    control_period_ms;      ///< The gateways also send one control packet per period, to their nodes in turn, 0 to disable
+    bool        aggregate;              ///< The downlink packets of a period are packed into aggregated frames, see blink_gateway_tx_aggregated
+    size_t      n_streamers;            ///< The first nodes send every streamer_period_ms instead, and need extra uplink cells
+    uint32_t    streamer_period_ms;
+    uint8_t     max_packet_len;         ///< Largest frame of the networks, see blink_gateway_set_max_packet_len
+    bl_sim_tunables_t tunables;         ///< Protocol parameters, shared by all instances
+} bl_sim_scenario_t;
+
+typedef struct {
+    size_t      n_nodes;
+    size_t      n_joined;               ///< Nodes that joined at least once
+    size_t      n_connected;            ///< Nodes connected when the simulation ended
+    double      join_ms_p50;            ///< Time from power on to the first BLINK_CONNECTED, over nodes that joined
+    double      join_ms_p90;
+    double      join_ms_p99;
+    double      join_ms_max;
+    double      sync_ms_p50;            ///< Time from power on to the first synchronization to a gateway, at the end of a scan
+    double      sync_ms_p90;
+    double      sync_ms_max;
+    uint32_t    uplink_sent;
+    uint32_t    uplink_received;
+    double      uplink_pdr;
+    double      uplink_latency_ms_p50;
+    double      uplink_latency_ms_p99;
+    uint32_t    downlink_sent;
+    uint32_t    downlink_received;
+    double      downlink_pdr;
+    double      downlink_latency_ms_p50;
+    double      downlink_latency_ms_p99;
+    uint32_t    control_sent;           ///< Control packets, queued ahead of the downlink ones, see blink_tx_priority
+    uint32_t    control_received;
+    double      control_pdr;
+    double      control_latency_ms_p50;
+    double      control_latency_ms_p99;
+    double      node_radio_duty;        ///< Average fraction of time the radio of a node is on
+    double      gateway_radio_duty;
+    double      node_current_ua;        ///< Average current of a node, from blink_get_average_current_ua (nRF52840 profile)
+    double      gateway_current_ua;
+    uint32_t    disconnects;            ///< BLINK_DISCONNECTED events at the nodes, including handovers
+    uint32_t    handovers;
+    uint32_t    false_leaves;           ///< Nodes leaving because of a timeout or bloom miss while their gateway still had them
+    uint32_t    nodes_left;             ///< BLINK_NODE_LEFT events at the gateways
+    uint32_t    gateway_full;           ///< Join requests rejected for lack of uplink cells
+    uint32_t    schedule_switches;      ///< Schedule switches applied by the gateways, with --elastic
+    uint32_t    streamer_sent;          ///< Part of uplink_sent sent by the streamers
+    uint32_t    streamer_received;
+    double      streamer_pdr;
+    uint32_t    extra_cells_granted;    ///< Extra uplink cells handed out by the gateways, see bl_scheduler_gateway_grant_bandwidth
+    uint8_t     max_packet_len;         ///< Largest frame advertised by the gateways, at least large enough for their control frames
+    uint32_t    oversized_drops;        ///< Packets dropped from the queues because they are longer than max_packet_len
+    uint32_t    queue_drops;            ///< Packets not enqueued because the queue was full, at the gateways
+    uint32_t    queue_high_watermark;   ///< Most packets waiting in the queue of a gateway at once
+    uint32_t    ttl_drops;              ///< Packets dropped from the queues of the gateways because their ttl ran out
+    uint32_t    channel_blacklist_changes; ///< Changes of the data channels applied by the gateways, see bl_scheduler_gateway_update_channel_blacklist
+    double      blacklisted_channels;   ///< Data channels blacklisted at the end, on average over the gateways
+    uint64_t    events;                 ///< Events processed by the engine
+    double      wall_s;                 ///< Wall-clock time of the run
+} bl_sim_metrics_t;
+
+//=========================== prototypes =======================================
+
+void bl_sim_scenario_defaults(bl_sim_scenario_t *scenario);
+
+/**
+ * @brief Runs one simulation from scratch
+ *
+ * @return 0 on success, -1 if the scenario is invalid
+ */
+int bl_sim_scenario_run(const bl_sim_scenario_t *scenario, bl_sim_metrics_t *metrics);
+
+uint8_t bl_sim_scenario_schedule_id(const char *name);
+bool bl_sim_tunables_valid(const bl_sim_tunables_t *tunables);
+
+/**
+ * @brief Applies one of the BL_SIM_SCENARIO_OPTIONS
+ *
+ * @return 1 if @p opt was applied, 0 if it is not a scenario option, -1 if @p arg is invalid
+ */
+int bl_sim_scenario_parse_option(bl_sim_scenario_t *scenario, int opt, const char *arg);
+void bl_sim_scenario_print_usage(FILE *out);
+
+void bl_sim_metrics_print(FILE *out, const bl_sim_scenario_t *scenario, const bl_sim_metrics_t *metrics);
+void bl_sim_metrics_print_csv_header(FILE *out);
+void bl_sim_metrics_print_csv(FILE *out, const bl_sim_scenario_t *scenario, const bl_sim_metrics_t *metrics);
+void bl_sim_metrics_print_json(FILE *out, const bl_sim_scenario_t *scenario, const bl_sim_metrics_t *metrics);
+
+#endif // __SCENARIO_H
@@ -0,0 +1,373 @@
+/**
+ * @file
+ * @ingroup     sim
+ *
+ * @brief       Virtual-time event engine of the blink simulator
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sim.h"
+
+//=========================== defines ==========================================
+
+typedef enum {
+    SIM_EVENT_CALL,
+    SIM_EVENT_TIMER,
+    SIM_EVENT_FRAME_START,
+    SIM_EVENT_FRAME_END,
+} sim_event_type_t;
+
+typedef struct {
+    bl_sim_time_t       t;
+    uint64_t            seq;            ///< Keeps events scheduled for the same time in FIFO order
+    sim_event_type_t    type;
+    uint16_t            node;
+    uint8_t             timer;
+    uint8_t             channel;
+    uint32_t            arg;            ///< Timer generation, or frame id
+    bl_sim_cb_t         cb;
+} sim_event_t;
+
+typedef struct {
+    bl_sim_config_t     config;
+    bl_sim_time_t       now;
+    uint64_t            seq;
+    uint64_t            rng_state;
+
+    sim_event_t         *events;        ///< Binary min-heap ordered by (t, seq)
+    size_t              events_len;
+    size_t              events_cap;
+
+    bl_sim_node_t       nodes[BL_SIM_MAX_NODES];
+    size_t              nodes_len;
+    bl_sim_node_t       *current;
+
+    int8_t              *rssi;          ///< nodes_len x nodes_len link budget, computed lazily
+    size_t              rssi_len;
+
+    uint8_t             *pristine;      ///< Blink globals as laid out by the linker, before any code ran
+} sim_vars_t;
+
+//=========================== variables ========================================
+
+extern uint8_t __start_blink_state[];
+extern uint8_t __stop_blink_state[];
+
+static sim_vars_t _sim_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static void _push(sim_event_t event);
+static sim_event_t _pop(void);
+static bool _before(const sim_event_t *a, const sim_event_t *b);
+static void _compute_rssi(void);
+static void _dispatch_timer(sim_event_t *event);
+
+//=========================== public ===========================================
+
+void bl_sim_init(const bl_sim_config_t *config) {
+    size_t state_size = bl_sim_state_size();
+    if (_sim_vars.pristine == NULL) {
+        _sim_vars.pristine = malloc(state_size);
+        memcpy(_sim_vars.pristine, __start_blink_state, state_size);
+    }
+    memcpy(__start_blink_state, _sim_vars.pristine, state_size);
+
+    for (size_t i = 0; i < _sim_vars.nodes_len; i++) {
+        free(_sim_vars.nodes[i].state);
+    }
+    free(_sim_vars.rssi);
+    free(_sim_vars.events);
+
+    uint8_t *pristine = _sim_vars.pristine;
+    memset(&_sim_vars, 0, sizeof(_sim_vars));
+    _sim_vars.pristine = pristine;
+    _sim_vars.config = *config;
+    _sim_vars.rng_state = config->seed;
+
+    bl_sim_radio_reset();
+}
+
+bl_sim_node_t *bl_sim_node_add(bl_node_type_t node_type, uint64_t device_id, double drift_ppm, bl_sim_time_t boot_ns, bl_sim_cb_t boot) {
+    if (_sim_vars.nodes_len == BL_SIM_MAX_NODES) {
+        return NULL;
+    }
+
+    bl_sim_node_t *node = &_sim_vars.nodes[_sim_vars.nodes_len];
+    memset(node, 0, sizeof(bl_sim_node_t));
+    node->index = _sim_vars.nodes_len++;
+    node->node_type = node_type;
+    node->ficr.DEVICEID[0] = (uint32_t)device_id;
+    node->ficr.DEVICEID[1] = (uint32_t)(device_id >> 32);
+    node->ficr.DEVICEADDR[0] = (uint32_t)device_id;
+    node->ficr.DEVICEADDR[1] = (uint32_t)(device_id >> 32) & 0xffff;
+    node->drift_ppb = (int32_t)lround(drift_ppm * 1000.0);
+    node->boot_ns = boot_ns;
+    node->x = bl_sim_rng_uniform(&_sim_vars.rng_state) * _sim_vars.config.area_m;
+    node->y = bl_sim_rng_uniform(&_sim_vars.rng_state) * _sim_vars.config.area_m;
+    node->rng_state = _sim_vars.config.seed ^ (0x9e3779b97f4a7c15ULL * (node->index + 1));
+    node->radio.frame = -1;
+
+    size_t state_size = bl_sim_state_size();
+    node->state = malloc(state_size);
+    memcpy(node->state, _sim_vars.pristine, state_size);
+
+    bl_sim_schedule_call(node, boot_ns, boot);
+    return node;
+}
+
+void bl_sim_schedule_call(bl_sim_node_t *node, bl_sim_time_t t, bl_sim_cb_t cb) {
+    _push((sim_event_t){ .t = t, .type = SIM_EVENT_CALL, .node = node->index, .cb = cb });
+}
+
+uint64_t bl_sim_run(bl_sim_time_t until) {
+    if (_sim_vars.rssi_len != _sim_vars.nodes_len) {
+        _compute_rssi();
+    }
+
+    uint64_t n_events = 0;
+    while (_sim_vars.events_len > 0 && _sim_vars.events[0].t <= until) {
+        sim_event_t event = _pop();
+        _sim_vars.now = event.t;
+        n_events++;
+
+        switch (event.type) {
+            case SIM_EVENT_CALL: {
+                bl_sim_node_t *node = &_sim_vars.nodes[event.node];
+                bl_sim_switch(node);
+                node->booted = true;
+                event.cb(node);
+                bl_sim_after_event(node);
+                break;
+            }
+            case SIM_EVENT_TIMER:
+                _dispatch_timer(&event);
+                break;
+            case SIM_EVENT_FRAME_START:
+                bl_sim_radio_frame_start(event.arg);
+                break;
+            case SIM_EVENT_FRAME_END:
+                bl_sim_radio_frame_end(event.arg);
+                break;
+        }
+    }
+    _sim_vars.now = until;
+
+    for (size_t i = 0; i < _sim_vars.nodes_len; i++) {
+        bl_sim_radio_flush_stats(&_sim_vars.nodes[i]);
+    }
+    return n_events;
+}
+
+void bl_sim_switch(bl_sim_node_t *node) {
+    if (node == _sim_vars.current) {
+        return;
+    }
+    size_t state_size = bl_sim_state_size();
+    if (_sim_vars.current != NULL) {
+        memcpy(_sim_vars.current->state, __start_blink_state, state_size);
+    }
+    memcpy(__start_blink_state, node->state, state_size);
+    _sim_vars.current = node;
+}
+
+bl_sim_node_t *bl_sim_current(void) {
+    return _sim_vars.current;
+}
+
+bl_sim_node_t *bl_sim_nodes(size_t *nodes_len) {
+    *nodes_len = _sim_vars.nodes_len;
+    return _sim_vars.nodes;
+}
+
+bl_sim_time_t bl_sim_now(void) {
+    return _sim_vars.now;
+}
+
+size_t bl_sim_state_size(void) {
+    return __stop_blink_state - __start_blink_state;
+}
+
+// splitmix64
+uint64_t bl_sim_rng_next(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+double bl_sim_rng_uniform(uint64_t *state) {
+    return (bl_sim_rng_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+NRF_FICR_Type *bl_sim_ficr(void) {
+    return &_sim_vars.current->ficr;
+}
+
+// -------- internal api --------
+
+uint64_t bl_sim_local_us(const bl_sim_node_t *node, bl_sim_time_t t) {
+    int64_t elapsed = t - node->boot_ns;
+    // floor division, so that a negative drift never yields a local time in the future
+    int64_t drift_ns = ((__int128)elapsed * node->drift_ppb) / BL_SIM_NS_PER_S;
+    if (((__int128)elapsed * node->drift_ppb) % BL_SIM_NS_PER_S < 0) {
+        drift_ns--;
+    }
+    return (uint64_t)(elapsed + drift_ns) / BL_SIM_NS_PER_US;
+}
+
+bl_sim_time_t bl_sim_global_ns(const bl_sim_node_t *node, uint64_t local_us) {
+    // first global time at which the local clock reads local_us
+    int64_t target_ns = (int64_t)local_us * BL_SIM_NS_PER_US;
+    int64_t elapsed = ((__int128)target_ns * BL_SIM_NS_PER_S) / (BL_SIM_NS_PER_S + node->drift_ppb);
+    while (bl_sim_local_us(node, node->boot_ns + elapsed) < local_us) {
+        elapsed++;
+    }
+    while (elapsed > 0 && bl_sim_local_us(node, node->boot_ns + elapsed - 1) >= local_us) {
+        elapsed--;
+    }
+    return node->boot_ns + elapsed;
+}
+
+void bl_sim_schedule_timer(bl_sim_node_t *node, uint8_t timer, uint8_t channel) {
+    bl_sim_timer_channel_t *ch = &node->timers[timer].channels[channel];
+    bl_sim_time_t t = bl_sim_global_ns(node, node->timers[timer].epoch_us + ch->deadline);
+    if (t < _sim_vars.now) {
+        t = _sim_vars.now;
+    }
+    _push((sim_event_t){ .t = t, .type = SIM_EVENT_TIMER, .node = node->index, .timer = timer, .channel = channel, .arg = ch->generation });
+}
+
+void bl_sim_schedule_frame(bl_sim_node_t *sender, bl_sim_time_t t, bool is_end, int32_t frame) {
+    _push((sim_event_t){ .t = t, .type = is_end ? SIM_EVENT_FRAME_END : SIM_EVENT_FRAME_START, .node = sender->index, .arg = frame });
+}
+
+int8_t bl_sim_link_rssi(const bl_sim_node_t *from, const bl_sim_node_t *to) {
+    return _sim_vars.rssi[from->index * _sim_vars.rssi_len + to->index];
+}
+
+bool bl_sim_draw_loss(uint8_t channel) {
+    if (_sim_vars.config.interference_channel != 0 && channel >= _sim_vars.config.interference_channel && channel <= _sim_vars.config.interference_channel_last
+        && bl_sim_rng_uniform(&_sim_vars.rng_state) < _sim_vars.config.interference_rate) {
+        return true;
+    }
+    return _sim_vars.config.loss_rate > 0 && bl_sim_rng_uniform(&_sim_vars.rng_state) < _sim_vars.config.loss_rate;
+}
+
+void bl_sim_after_event(bl_sim_node_t *node) {
+    if (_sim_vars.config.main_loop != NULL && node->booted) {
+        _sim_vars.config.main_loop(node);
+    }
+}
+
+//=========================== private ==========================================
+
+static void _dispatch_timer(sim_event_t *event) {
+    bl_sim_node_t *node = &_sim_vars.nodes[event->node];
+    bl_sim_timer_channel_t *ch = &node->timers[event->timer].channels[event->channel];
+    if (!ch->armed || ch->generation != event->arg) {
+        // cancelled or re-armed since this event was scheduled
+        return;
+    }
+
+    bl_sim_switch(node);
+    timer_hf_cb_t callback = ch->callback;
+    if (ch->one_shot) {
+        ch->armed = false;
+    } else {
+        // like the driver, move the compare value before calling back, so the callback can adjust it
+        ch->deadline += ch->period_us;
+        bl_sim_schedule_timer(node, event->timer, event->channel);
+    }
+    if (callback != NULL) {
+        callback();
+    }
+    bl_sim_after_event(node);
+}
+
+static void _compute_rssi(void) {
+    size_t n = _sim_vars.nodes_len;
+    free(_sim_vars.rssi);
+    _sim_vars.rssi = malloc(n * n);
+    _sim_vars.rssi_len = n;
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = i; j < n; j++) {
+            double dx = _sim_vars.nodes[i].x - _sim_vars.nodes[j].x;
+            double dy = _sim_vars.nodes[i].y - _sim_vars.nodes[j].y;
+            double d = sqrt(dx * dx + dy * dy);
+            if (d < 0.5) {
+                d = 0.5;
+            }
+            // log-distance path loss with 40 dB at 1 m, and a symmetric static shadowing term (Box-Muller)
+            double u1 = bl_sim_rng_uniform(&_sim_vars.rng_state);
+            double u2 = bl_sim_rng_uniform(&_sim_vars.rng_state);
+            double shadowing = sqrt(-2.0 * log(u1 + 1e-12)) * cos(2.0 * M_PI * u2) * _sim_vars.config.shadowing_db;
+            double rssi = -(40.0 + 10.0 * _sim_vars.config.path_loss_exponent * log10(d)) + shadowing;
+            if (rssi > -1) {
+                rssi = -1;
+            } else if (rssi < INT8_MIN) {
+                rssi = INT8_MIN;
+            }
+            _sim_vars.rssi[i * n + j] = (int8_t)lround(rssi);
+            _sim_vars.rssi[j * n + i] = (int8_t)lround(rssi);
+        }
+    }
+}
+
+static bool _before(const sim_event_t *a, const sim_event_t *b) {
+    return a->t < b->t || (a->t == b->t && a->seq < b->seq);
+}
+
+static void _push(sim_event_t event) {
+    if (_sim_vars.events_len == _sim_vars.events_cap) {
+        _sim_vars.events_cap = _sim_vars.events_cap ? _sim_vars.events_cap * 2 : 1024;
+        _sim_vars.events = realloc(_sim_vars.events, _sim_vars.events_cap * sizeof(sim_event_t));
+    }
+    event.seq = _sim_vars.seq++;
+
+    // sift up
+    size_t i = _sim_vars.events_len++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!_before(&event, &_sim_vars.events[parent])) {
+            break;
+        }
+        _sim_vars.events[i] = _sim_vars.events[parent];
+        i = parent;
+    }
+    _sim_vars.events[i] = event;
+}
+
+static sim_event_t _pop(void) {
+    sim_event_t top = _sim_vars.events[0];
+    sim_event_t last = _sim_vars.events[--_sim_vars.events_len];
+
+    // sift down
+    size_t i = 0;
+    size_t n = _sim_vars.events_len;
+    while (true) {
+        size_t child = 2 * i + 1;
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && _before(&_sim_vars.events[child + 1], &_sim_vars.events[child])) {
+            child++;
+        }
+        if (!_before(&_sim_vars.events[child], &last)) {
+            break;
+        }
+        _sim_vars.events[i] = _sim_vars.events[child];
+        i = child;
+    }
+    if (n > 0) {
+        _sim_vars.events[i] = last;
+    }
+    return top;
+}
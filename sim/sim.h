@@ -0,0 +1,177 @@
+#ifndef __SIM_H
+#define __SIM_H
+
+/**
+ * @defgroup    sim     Blink simulator
+ * @brief       Discrete-event simulator running many blink instances on a Linux host
+ *
+ * The blink stack is compiled unchanged against simulated implementations of
+ * bl_radio.h, bl_timer_hf.h, bl_rng.h and bl_device.h. All its global variables
+ * are linked into a single `blink_state` section (see blink_state.ld), which is
+ * swapped in and out whenever the engine hands control to another instance.
+ *
+ * @{
+ * @file
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <nrf.h>
+
+#include "models.h"
+#include "bl_radio.h"
+#include "bl_timer_hf.h"
+
+//=========================== defines ==========================================
+
+#define BL_SIM_MAX_NODES                (1024)
+#define BL_SIM_TIMER_DEVS               (5)     ///< TIMER0..TIMER4, as on the nRF52840
+#define BL_SIM_TIMER_CHANNELS           (6)
+
+#define BL_SIM_RADIO_ADDRESS_DELAY_US   (78)    ///< From TASKS_START to the ADDRESS event, same as time_cpu_periph in fix_drift
+#define BL_SIM_RADIO_US_PER_BYTE        (4)     ///< BLE 2M
+#define BL_SIM_RADIO_OVERHEAD_BYTES     (2 + 3) ///< S0 + LENGTH before the payload, CRC after it
+#define BL_SIM_RADIO_SENSITIVITY_DBM    (-92)
+#define BL_SIM_RADIO_CAPTURE_DB         (6)     ///< A frame survives interference that is at least this much weaker
+#define BL_SIM_RADIO_MAX_ACTIVE_FRAMES  (64)
+
+#define BL_SIM_NS_PER_US                (1000LL)
+#define BL_SIM_NS_PER_MS                (1000LL * 1000LL)
+#define BL_SIM_NS_PER_S                 (1000LL * 1000LL * 1000LL)
+
+typedef int64_t bl_sim_time_t;  ///< Global virtual time, in nanoseconds
+
+typedef struct bl_sim_node bl_sim_node_t;
+
+typedef void (*bl_sim_cb_t)(bl_sim_node_t *node);
+
+typedef struct {
+    uint64_t        seed;                   ///< Seed for placement, shadowing, losses and per-instance RNGs
+    double          area_m;                 ///< Instances are placed uniformly in a square of this side
+    double          path_loss_exponent;     ///< Log-distance path loss exponent
+    double          shadowing_db;           ///< Standard deviation of the static per-link shadowing
+    double          loss_rate;              ///< Probability of losing a frame on top of the propagation model
+    uint8_t         interference_channel;   ///< First channel jammed by an external source, 0 for none
+    uint8_t         interference_channel_last; ///< Last channel jammed, the same as interference_channel for a single one
+    double          interference_rate;      ///< Probability of losing a frame on interference_channel, on top of loss_rate
+    bl_sim_cb_t     main_loop;              ///< Called after each event delivered to an instance, like the while(1) of an app
+} bl_sim_config_t;
+
+typedef struct {
+    timer_hf_cb_t   callback;
+    uint64_t        deadline;               ///< Counter value at which the channel fires (64-bit, never wraps)
+    uint32_t        period_us;
+    bool            one_shot;
+    bool            armed;
+    uint32_t        generation;             ///< Bumped on every re-arm and cancel, stale events are dropped
+} bl_sim_timer_channel_t;
+
+typedef struct {
+    uint64_t                epoch_us;       ///< Local time at which the counter was cleared by bl_timer_hf_init
+    bl_sim_timer_channel_t  channels[BL_SIM_TIMER_CHANNELS];
+} bl_sim_timer_t;
+
+typedef struct {
+    radio_ts_packet_t   start_pac_cb;
+    radio_ts_packet_t   end_pac_cb;
+    uint8_t             state;              ///< Same encoding as radio_vars.state in bl_radio_default.c
+    uint8_t             channel;
+    bl_radio_pdu_t      tx_pdu;
+    const bl_radio_pdu_t *tx_buffer;        ///< Set with bl_radio_tx_prepare_pdu, in the state of the instance, read when the frame is sent
+    bl_radio_pdu_t      rx_pdu;
+    bl_radio_pdu_t      *rx_buffer;         ///< Set with bl_radio_set_rx_pdu, in the state of the instance, NULL for rx_pdu
+    bool                pending_rx_read;
+    int8_t              rssi;
+    int32_t             frame;              ///< Frame being sent or received, -1 if none
+    bool                frame_corrupted;
+    bl_sim_time_t       on_since;           ///< When the radio last left the idle state
+} bl_sim_radio_t;
+
+typedef struct {
+    bl_sim_time_t       rx_ns;              ///< Time spent listening or receiving
+    bl_sim_time_t       tx_ns;              ///< Time spent transmitting
+    uint32_t            frames_tx;
+    uint32_t            frames_rx;          ///< Frames received with a valid CRC
+    uint32_t            frames_corrupted;   ///< Frames lost to collisions or to the loss model
+} bl_sim_radio_stats_t;
+
+struct bl_sim_node {
+    uint16_t                index;
+    bl_node_type_t          node_type;
+    NRF_FICR_Type           ficr;           ///< Holds the device id returned by bl_device_id()
+    int32_t                 drift_ppb;      ///< Crystal drift, in parts per billion
+    bl_sim_time_t           boot_ns;        ///< Global time at which the instance was powered on
+    double                  x;
+    double                  y;
+    bool                    booted;
+    bl_sim_timer_t          timers[BL_SIM_TIMER_DEVS];
+    bl_sim_radio_t          radio;
+    bl_sim_radio_stats_t    radio_stats;
+    uint64_t                rng_state;
+    uint8_t                 *state;         ///< Blink globals of this instance while it is not running
+};
+
+//=========================== prototypes =======================================
+
+/**
+ * @brief Resets the engine, removing all instances and restoring pristine blink globals
+ *
+ * @param[in] config    Simulation parameters, copied
+ */
+void bl_sim_init(const bl_sim_config_t *config);
+
+/**
+ * @brief Creates a new instance, placed at a random position
+ *
+ * @param[in] node_type     Whether the instance is a gateway or a node
+ * @param[in] device_id     Value returned by bl_device_id() on this instance
+ * @param[in] drift_ppm     Crystal drift, in ppm
+ * @param[in] boot_ns       Global time at which @p boot is called
+ * @param[in] boot          Called on the instance at boot time, typically calls blink_init
+ *
+ * @return the instance, or NULL if BL_SIM_MAX_NODES is reached
+ */
+bl_sim_node_t *bl_sim_node_add(bl_node_type_t node_type, uint64_t device_id, double drift_ppm, bl_sim_time_t boot_ns, bl_sim_cb_t boot);
+
+/**
+ * @brief Calls @p cb in the context of @p node at global time @p t
+ */
+void bl_sim_schedule_call(bl_sim_node_t *node, bl_sim_time_t t, bl_sim_cb_t cb);
+
+/**
+ * @brief Processes events until virtual time reaches @p until
+ *
+ * @return number of events processed
+ */
+uint64_t bl_sim_run(bl_sim_time_t until);
+
+/**
+ * @brief Makes @p node the running instance, so that blink functions can be called on it directly
+ */
+void bl_sim_switch(bl_sim_node_t *node);
+
+bl_sim_node_t *bl_sim_current(void);
+bl_sim_node_t *bl_sim_nodes(size_t *nodes_len);
+bl_sim_time_t bl_sim_now(void);
+size_t bl_sim_state_size(void);
+uint64_t bl_sim_rng_next(uint64_t *state);
+double bl_sim_rng_uniform(uint64_t *state);
+
+// -------- internal api, used by the simulated drivers --------
+
+uint64_t bl_sim_local_us(const bl_sim_node_t *node, bl_sim_time_t t);
+bl_sim_time_t bl_sim_global_ns(const bl_sim_node_t *node, uint64_t local_us);
+void bl_sim_schedule_timer(bl_sim_node_t *node, uint8_t timer, uint8_t channel);
+void bl_sim_schedule_frame(bl_sim_node_t *sender, bl_sim_time_t t, bool is_end, int32_t frame);
+int8_t bl_sim_link_rssi(const bl_sim_node_t *from, const bl_sim_node_t *to);
+bool bl_sim_draw_loss(uint8_t channel);
+void bl_sim_after_event(bl_sim_node_t *node);
+
+void bl_sim_radio_frame_start(int32_t frame);
+void bl_sim_radio_frame_end(int32_t frame);
+void bl_sim_radio_reset(void);
+void bl_sim_radio_flush_stats(bl_sim_node_t *node);
+
+#endif // __SIM_H
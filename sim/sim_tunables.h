@@ -0,0 +1,57 @@
+#ifndef __SIM_TUNABLES_H
+#define __SIM_TUNABLES_H
+
+/**
+ * @defgroup    sim_tunables    Runtime protocol parameters
+ * @ingroup     sim
+ * @brief       Turns compile-time protocol parameters of the library into variables
+ *
+ * This header is force-included when building the library for the simulator, so
+ * that one binary can run a sweep over several values of each parameter. On the
+ * target, the defaults from the library headers apply.
+ *
+ * @{
+ * @file
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+
+//=========================== defines ==========================================
+
+typedef struct {
+    uint8_t     backoff_n_min;
+    uint8_t     backoff_n_max;
+    int8_t      handover_rssi_hysteresis;
+    uint16_t    bloom_m_bits;               ///< Power of 2, at most BL_SIM_BLOOM_M_BITS_MAX
+    uint8_t     bloom_k_hashes;
+    uint8_t     max_slotframes_no_rx_leave;
+} bl_sim_tunables_t;
+
+#define BL_SIM_BLOOM_M_BITS_MAX (1024) ///< Largest filter that fits in a beacon, given the power of 2 constraint
+
+#define BL_SIM_TUNABLES_DEFAULT {           \
+    .backoff_n_min = 5,                     \
+    .backoff_n_max = 9,                     \
+    .handover_rssi_hysteresis = 9,          \
+    .bloom_m_bits = 1024,                   \
+    .bloom_k_hashes = 2,                    \
+    .max_slotframes_no_rx_leave = 5,        \
+}
+
+//=========================== variables ========================================
+
+extern bl_sim_tunables_t bl_sim_tunables;
+
+//=========================== overrides ========================================
+
+#define BLINK_BACKOFF_N_MIN                 (bl_sim_tunables.backoff_n_min)
+#define BLINK_BACKOFF_N_MAX                 (bl_sim_tunables.backoff_n_max)
+#define BLINK_HANDOVER_RSSI_HYSTERESIS      (bl_sim_tunables.handover_rssi_hysteresis)
+#define BLINK_BLOOM_M_BITS                  (bl_sim_tunables.bloom_m_bits)
+#define BLINK_BLOOM_M_BYTES_MAX             (BL_SIM_BLOOM_M_BITS_MAX / 8)
+#define BLINK_BLOOM_K_HASHES                (bl_sim_tunables.bloom_k_hashes)
+#define BLINK_MAX_SLOTFRAMES_NO_RX_LEAVE    (bl_sim_tunables.max_slotframes_no_rx_leave)
+
+#endif // __SIM_TUNABLES_H
@@ -0,0 +1,367 @@
+/**
+ * @file
+ * @ingroup     sim
+ *
+ * @brief       Parallel Monte Carlo sweep over the protocol parameters
+ *
+ * Runs every combination of the given parameter values, each with several seeds,
+ * and prints one CSV or JSON row per run, in a deterministic order.
+ *
+ * The blink globals live at a fixed address (see blink_state.ld), so simulations
+ * cannot share a process: each worker is a forked process. Runs are split in one
+ * contiguous range per worker, in shared memory; a worker takes runs from the front
+ * of its own range, and once it is empty steals the back half of the largest one.
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "scenario.h"
+
+//=========================== defines ==========================================
+
+#define SWEEP_MAX_VALUES    (32)    ///< Values per parameter
+#define SWEEP_MAX_JOBS      (256)
+
+typedef enum {
+    SWEEP_AXIS_BACKOFF_N_MIN,
+    SWEEP_AXIS_BACKOFF_N_MAX,
+    SWEEP_AXIS_HYSTERESIS,
+    SWEEP_AXIS_BLOOM_M_BITS,
+    SWEEP_AXIS_BLOOM_K_HASHES,
+    SWEEP_AXIS_NO_RX_LEAVE,
+    SWEEP_AXIS_COUNT,
+} sweep_axis_id_t;
+
+typedef struct {
+    int32_t     values[SWEEP_MAX_VALUES];
+    size_t      len;
+} sweep_axis_t;
+
+typedef struct {
+    bl_sim_metrics_t    metrics;
+    int32_t             status;     ///< Return value of bl_sim_scenario_run
+} sweep_result_t;
+
+/// Shared between the workers
+typedef struct {
+    _Atomic uint64_t    ranges[SWEEP_MAX_JOBS];     ///< Runs left to each worker, begin in the high word and end in the low word
+    _Atomic uint32_t    done;
+    sweep_result_t      results[];
+} sweep_shared_t;
+
+typedef struct {
+    bl_sim_scenario_t   base;
+    sweep_axis_t        axes[SWEEP_AXIS_COUNT];
+    bl_sim_tunables_t   *configs;                   ///< Valid combinations of the axes
+    size_t              configs_len;
+    uint32_t            seeds;                      ///< Runs per configuration
+    size_t              runs;
+    size_t              jobs;
+    sweep_shared_t      *shared;
+} sweep_vars_t;
+
+//=========================== variables ========================================
+
+static sweep_vars_t _sweep_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static void _usage(const char *argv0);
+static bool _parse_axis(sweep_axis_t *axis, const char *arg);
+static void _build_configs(void);
+static void _scenario_of_run(size_t run, bl_sim_scenario_t *scenario);
+static void _worker(size_t me);
+static int64_t _take(size_t me);
+static int64_t _steal(size_t me);
+static uint64_t _pack(uint32_t begin, uint32_t end);
+
+//=========================== main =============================================
+
+int main(int argc, char **argv) {
+    bl_sim_scenario_defaults(&_sweep_vars.base);
+    _sweep_vars.base.n_nodes = 50;
+    _sweep_vars.base.duration_s = 30;
+    _sweep_vars.seeds = 1;
+    _sweep_vars.jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    bool json = false;
+
+    static const struct option options[] = {
+        BL_SIM_SCENARIO_OPTIONS,
+        { "seeds",      required_argument, NULL, 'r' },
+        { "jobs",       required_argument, NULL, 'j' },
+        { "json",       no_argument,       NULL, 'J' },
+        { "help",       no_argument,       NULL, 'h' },
+        { 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, BL_SIM_SCENARIO_OPTSTRING "r:j:Jh", options, NULL)) != -1) {
+        if (opt >= BL_SIM_OPT_BACKOFF_N_MIN && opt <= BL_SIM_OPT_NO_RX_LEAVE) {
+            // protocol parameters take a list of values
+            if (!_parse_axis(&_sweep_vars.axes[opt - BL_SIM_OPT_BACKOFF_N_MIN], optarg)) {
+                fprintf(stderr, "invalid list of values '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+        int parsed = bl_sim_scenario_parse_option(&_sweep_vars.base, opt, optarg);
+        if (parsed < 0) {
+            fprintf(stderr, "invalid value '%s'\n", optarg);
+            return EXIT_FAILURE;
+        } else if (parsed > 0) {
+            continue;
+        }
+        switch (opt) {
+            case 'r': _sweep_vars.seeds = strtoul(optarg, NULL, 0); break;
+            case 'j': _sweep_vars.jobs = strtoul(optarg, NULL, 0); break;
+            case 'J': json = true; break;
+            case 'h':
+                _usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                _usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    _build_configs();
+    _sweep_vars.runs = _sweep_vars.configs_len * _sweep_vars.seeds;
+    if (_sweep_vars.runs == 0 || _sweep_vars.runs > UINT32_MAX) {
+        fprintf(stderr, "nothing to run\n");
+        return EXIT_FAILURE;
+    }
+    if (_sweep_vars.jobs == 0) {
+        _sweep_vars.jobs = 1;
+    } else if (_sweep_vars.jobs > SWEEP_MAX_JOBS) {
+        _sweep_vars.jobs = SWEEP_MAX_JOBS;
+    }
+    if (_sweep_vars.jobs > _sweep_vars.runs) {
+        _sweep_vars.jobs = _sweep_vars.runs;
+    }
+
+    size_t shared_size = sizeof(sweep_shared_t) + _sweep_vars.runs * sizeof(sweep_result_t);
+    _sweep_vars.shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (_sweep_vars.shared == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < _sweep_vars.jobs; i++) {
+        uint32_t begin = _sweep_vars.runs * i / _sweep_vars.jobs;
+        uint32_t end = _sweep_vars.runs * (i + 1) / _sweep_vars.jobs;
+        atomic_init(&_sweep_vars.shared->ranges[i], _pack(begin, end));
+    }
+
+    fprintf(stderr, "%zu configurations x %u seeds = %zu runs on %zu workers\n",
+            _sweep_vars.configs_len, _sweep_vars.seeds, _sweep_vars.runs, _sweep_vars.jobs);
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    fflush(NULL);
+    size_t alive = 0;
+    for (size_t i = 0; i < _sweep_vars.jobs; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _worker(i);
+            _exit(EXIT_SUCCESS);
+        } else if (pid < 0) {
+            perror("fork");
+            break;
+        }
+        alive++;
+    }
+
+    uint32_t reported = 0;
+    while (alive > 0) {
+        int status;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid > 0) {
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+                fprintf(stderr, "worker %d failed\n", pid);
+            }
+            alive--;
+            continue;
+        }
+        uint32_t done = atomic_load(&_sweep_vars.shared->done);
+        if (done != reported && isatty(STDERR_FILENO)) {
+            fprintf(stderr, "\r%u/%zu", done, _sweep_vars.runs);
+            reported = done;
+        }
+        usleep(100 * 1000);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall_s = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+    uint32_t done = atomic_load(&_sweep_vars.shared->done);
+    fprintf(stderr, "\r%u/%zu runs in %.1f s (%.2f runs/s)\n", done, _sweep_vars.runs, wall_s, done / wall_s);
+
+    if (!json) {
+        bl_sim_metrics_print_csv_header(stdout);
+    }
+    for (size_t run = 0; run < _sweep_vars.runs; run++) {
+        sweep_result_t *result = &_sweep_vars.shared->results[run];
+        if (result->status != 0) {
+            continue;
+        }
+        bl_sim_scenario_t scenario;
+        _scenario_of_run(run, &scenario);
+        if (json) {
+            bl_sim_metrics_print_json(stdout, &scenario, &result->metrics);
+        } else {
+            bl_sim_metrics_print_csv(stdout, &scenario, &result->metrics);
+        }
+    }
+
+    munmap(_sweep_vars.shared, shared_size);
+    free(_sweep_vars.configs);
+    return done == _sweep_vars.runs ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//=========================== private ==========================================
+
+static void _usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [options]\n", argv0);
+    bl_sim_scenario_print_usage(stderr);
+    fprintf(stderr,
+            "  -r, --seeds N                   runs per configuration, with seeds S, S+1, ... (1)\n"
+            "  -j, --jobs N                    worker processes (number of CPUs)\n"
+            "  -J, --json                      print one JSON object per run instead of CSV\n"
+            "\n"
+            "Protocol parameters accept a comma-separated list of values, e.g. --bloom-m-bits 256,512,1024,\n"
+            "and every valid combination is simulated. Scenario defaults are 50 nodes for 30 s.\n");
+}
+
+static bool _parse_axis(sweep_axis_t *axis, const char *arg) {
+    axis->len = 0;
+    const char *cursor = arg;
+    while (*cursor != '\0') {
+        if (axis->len == SWEEP_MAX_VALUES) {
+            return false;
+        }
+        char *end;
+        axis->values[axis->len++] = strtol(cursor, &end, 0);
+        if (end == cursor || (*end != ',' && *end != '\0')) {
+            return false;
+        }
+        cursor = *end == ',' ? end + 1 : end;
+    }
+    return axis->len > 0;
+}
+
+static void _build_configs(void) {
+    const bl_sim_tunables_t *defaults = &_sweep_vars.base.tunables;
+    int32_t default_values[SWEEP_AXIS_COUNT] = {
+        defaults->backoff_n_min,
+        defaults->backoff_n_max,
+        defaults->handover_rssi_hysteresis,
+        defaults->bloom_m_bits,
+        defaults->bloom_k_hashes,
+        defaults->max_slotframes_no_rx_leave,
+    };
+    size_t combinations = 1;
+    for (size_t a = 0; a < SWEEP_AXIS_COUNT; a++) {
+        if (_sweep_vars.axes[a].len == 0) {
+            _sweep_vars.axes[a].values[0] = default_values[a];
+            _sweep_vars.axes[a].len = 1;
+        }
+        combinations *= _sweep_vars.axes[a].len;
+    }
+
+    _sweep_vars.configs = calloc(combinations, sizeof(bl_sim_tunables_t));
+    for (size_t c = 0; c < combinations; c++) {
+        // mixed-radix decoding, the last axis varies fastest
+        size_t rest = c;
+        int32_t v[SWEEP_AXIS_COUNT];
+        for (int a = SWEEP_AXIS_COUNT - 1; a >= 0; a--) {
+            v[a] = _sweep_vars.axes[a].values[rest % _sweep_vars.axes[a].len];
+            rest /= _sweep_vars.axes[a].len;
+        }
+        bl_sim_tunables_t tunables = {
+            .backoff_n_min = v[SWEEP_AXIS_BACKOFF_N_MIN],
+            .backoff_n_max = v[SWEEP_AXIS_BACKOFF_N_MAX],
+            .handover_rssi_hysteresis = v[SWEEP_AXIS_HYSTERESIS],
+            .bloom_m_bits = v[SWEEP_AXIS_BLOOM_M_BITS],
+            .bloom_k_hashes = v[SWEEP_AXIS_BLOOM_K_HASHES],
+            .max_slotframes_no_rx_leave = v[SWEEP_AXIS_NO_RX_LEAVE],
+        };
+        if (bl_sim_tunables_valid(&tunables)) {
+            _sweep_vars.configs[_sweep_vars.configs_len++] = tunables;
+        }
+    }
+}
+
+static void _scenario_of_run(size_t run, bl_sim_scenario_t *scenario) {
+    *scenario = _sweep_vars.base;
+    scenario->tunables = _sweep_vars.configs[run / _sweep_vars.seeds];
+    // the same seeds for every configuration, so that they are compared on the same deployments
+    scenario->seed = _sweep_vars.base.seed + run % _sweep_vars.seeds;
+}
+
+static void _worker(size_t me) {
+    int64_t run;
+    while ((run = _take(me)) >= 0 || (run = _steal(me)) >= 0) {
+        bl_sim_scenario_t scenario;
+        _scenario_of_run(run, &scenario);
+        sweep_result_t *result = &_sweep_vars.shared->results[run];
+        result->status = bl_sim_scenario_run(&scenario, &result->metrics);
+        atomic_fetch_add(&_sweep_vars.shared->done, 1);
+    }
+}
+
+static int64_t _take(size_t me) {
+    _Atomic uint64_t *range = &_sweep_vars.shared->ranges[me];
+    uint64_t current = atomic_load(range);
+    while (true) {
+        uint32_t begin = current >> 32, end = (uint32_t)current;
+        if (begin >= end) {
+            return -1;
+        }
+        if (atomic_compare_exchange_weak(range, &current, _pack(begin + 1, end))) {
+            return begin;
+        }
+    }
+}
+
+static int64_t _steal(size_t me) {
+    while (true) {
+        // pick the worker with the most runs left
+        size_t victim = me;
+        uint64_t victim_range = 0;
+        uint32_t most = 0;
+        for (size_t i = 0; i < _sweep_vars.jobs; i++) {
+            uint64_t range = atomic_load(&_sweep_vars.shared->ranges[i]);
+            uint32_t begin = range >> 32, end = (uint32_t)range;
+            if (i != me && end > begin && end - begin > most) {
+                victim = i;
+                victim_range = range;
+                most = end - begin;
+            }
+        }
+        if (victim == me) {
+            return -1;
+        }
+
+        // take the back half, rounded up, and keep its first run
+        uint32_t begin = victim_range >> 32, end = (uint32_t)victim_range;
+        uint32_t middle = begin + (end - begin) / 2;
+        if (atomic_compare_exchange_strong(&_sweep_vars.shared->ranges[victim], &victim_range, _pack(begin, middle))) {
+            atomic_store(&_sweep_vars.shared->ranges[me], _pack(middle + 1, end));
+            return middle;
+        }
+        // the victim moved on in the meantime, look again
+    }
+}
+
+static uint64_t _pack(uint32_t begin, uint32_t end) {
+    return ((uint64_t)begin << 32) | end;
+}
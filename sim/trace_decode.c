@@ -0,0 +1,260 @@
+/**
+ * @file
+ * @ingroup     sim
+ *
+ * @brief       Renders the slot timeline trace of a device, see blink/trace.h
+ *
+ * Reads the lines printed with bl_trace_format, from a UART log or from
+ * `blink_sim --trace`, ignores everything else, and prints each slot with the
+ * activities and state changes within it, followed by the time spent in each
+ * state.
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "trace.h"
+
+//=========================== defines ==========================================
+
+#define TRACE_N_STATES  (256)
+
+typedef struct {
+    bool        summary_only;
+    bool        has_previous;
+    bl_trace_record_t previous;
+    uint32_t    slot_start_ts;
+    bool        in_slot;
+    uint64_t    state_us[TRACE_N_STATES];
+    uint64_t    total_us;
+    uint32_t    activity_count[BL_TRACE_ACTIVITY_MAX];
+    uint32_t    n_records;
+    uint32_t    n_slots;
+} trace_decode_vars_t;
+
+//=========================== variables ========================================
+
+static const char *_activity_names[BL_TRACE_ACTIVITY_MAX] = {
+    [BL_TRACE_STATE]                = "state",
+    [BL_TRACE_NEW_SLOT]             = "new_slot",
+    [BL_TRACE_TI1]                  = "ti1",
+    [BL_TRACE_TI2]                  = "ti2",
+    [BL_TRACE_TIE1]                 = "tie1",
+    [BL_TRACE_TI3]                  = "ti3",
+    [BL_TRACE_RI1]                  = "ri1",
+    [BL_TRACE_RI2]                  = "ri2",
+    [BL_TRACE_RI3]                  = "ri3",
+    [BL_TRACE_RIE1]                 = "rie1",
+    [BL_TRACE_RI4]                  = "ri4",
+    [BL_TRACE_RIE2]                 = "rie2",
+    [BL_TRACE_FIX_DRIFT]            = "fix_drift",
+    [BL_TRACE_DESYNC]               = "desync",
+    [BL_TRACE_SCAN_START]           = "scan_start",
+    [BL_TRACE_SCAN_END]             = "scan_end",
+    [BL_TRACE_BG_SCAN_START]        = "bg_scan_start",
+    [BL_TRACE_BG_SCAN_END]          = "bg_scan_end",
+    [BL_TRACE_SCAN_START_FRAME]     = "scan_start_frame",
+    [BL_TRACE_SCAN_END_FRAME]       = "scan_end_frame",
+    [BL_TRACE_SYNC]                 = "sync",
+    [BL_TRACE_DISPATCH_SCHEDULE]    = "dispatch_schedule",
+};
+
+static trace_decode_vars_t _vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static bool _parse_line(const char *line, bl_trace_record_t *record);
+static void _handle_record(const bl_trace_record_t *record);
+static void _print_summary(void);
+static const char *_state_name(uint8_t state);
+static const char *_activity_name(uint8_t activity);
+static void _usage(const char *argv0);
+
+//=========================== main =============================================
+
+int main(int argc, char **argv) {
+    static const struct option options[] = {
+        { "summary",    no_argument,    NULL, 's' },
+        { "help",       no_argument,    NULL, 'h' },
+        { 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "sh", options, NULL)) != -1) {
+        switch (opt) {
+            case 's': _vars.summary_only = true; break;
+            case 'h':
+                _usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                _usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    FILE *input = stdin;
+    if (optind < argc) {
+        input = fopen(argv[optind], "r");
+        if (input == NULL) {
+            perror(argv[optind]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), input) != NULL) {
+        bl_trace_record_t record;
+        if (_parse_line(line, &record)) {
+            _handle_record(&record);
+        }
+    }
+    if (input != stdin) {
+        fclose(input);
+    }
+
+    _print_summary();
+    return EXIT_SUCCESS;
+}
+
+//=========================== private ==========================================
+
+static bool _parse_line(const char *line, bl_trace_record_t *record) {
+    // the prefix may come after a timestamp added by the serial terminal
+    const char *hex = strstr(line, BLINK_TRACE_LINE_PREFIX);
+    if (hex == NULL) {
+        return false;
+    }
+    hex += strlen(BLINK_TRACE_LINE_PREFIX);
+
+    uint8_t bytes[sizeof(bl_trace_record_t)];
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        unsigned value;
+        if (sscanf(hex + 2 * i, "%2x", &value) != 1) {
+            return false;
+        }
+        bytes[i] = value;
+    }
+
+    // the target is little-endian, decode explicitly so that the host does not matter
+    record->ts = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    record->asn = bytes[4] | (bytes[5] << 8) | (bytes[6] << 16) | ((uint32_t)bytes[7] << 24);
+    record->activity = bytes[8];
+    record->state = bytes[9];
+    record->arg = bytes[10] | (bytes[11] << 8);
+    return true;
+}
+
+static void _handle_record(const bl_trace_record_t *record) {
+    _vars.n_records++;
+    if (record->activity < BL_TRACE_ACTIVITY_MAX) {
+        _vars.activity_count[record->activity]++;
+    }
+
+    // the time since the previous record was spent in the state it left the MAC in
+    if (_vars.has_previous) {
+        uint32_t elapsed = record->ts - _vars.previous.ts;
+        _vars.state_us[_vars.previous.state] += elapsed;
+        _vars.total_us += elapsed;
+    }
+    _vars.previous = *record;
+    _vars.has_previous = true;
+
+    bool starts_group = record->activity == BL_TRACE_NEW_SLOT || record->activity == BL_TRACE_SCAN_START;
+    if (starts_group) {
+        _vars.slot_start_ts = record->ts;
+        _vars.in_slot = true;
+        if (record->activity == BL_TRACE_NEW_SLOT) {
+            _vars.n_slots++;
+        }
+    }
+
+    if (_vars.summary_only) {
+        return;
+    }
+
+    if (record->activity == BL_TRACE_NEW_SLOT) {
+        // the asn counter is incremented as the slot starts
+        printf("\nasn %-10u type %c  channel %2u  ts %u\n", record->asn - 1, record->arg >> 8, record->arg & 0xFF, record->ts);
+        return;
+    }
+    if (record->activity == BL_TRACE_SCAN_START) {
+        printf("\nscan  ts %u\n", record->ts);
+        return;
+    }
+
+    if (_vars.in_slot) {
+        printf("  +%6u us  ", record->ts - _vars.slot_start_ts);
+    } else {
+        printf("  ts %u  ", record->ts);
+    }
+    switch (record->activity) {
+        case BL_TRACE_STATE:
+            printf("  -> %s\n", _state_name(record->state));
+            break;
+        case BL_TRACE_FIX_DRIFT:
+            printf("%s %+d us\n", _activity_name(record->activity), (int16_t)record->arg);
+            break;
+        case BL_TRACE_SCAN_END_FRAME:
+            printf("%s (%u bytes)\n", _activity_name(record->activity), record->arg);
+            break;
+        case BL_TRACE_SYNC:
+            printf("%s%s\n", _activity_name(record->activity), record->arg ? " (handover)" : "");
+            break;
+        default:
+            printf("%s\n", _activity_name(record->activity));
+            break;
+    }
+}
+
+static void _print_summary(void) {
+    printf("\n%u records, %u slots, %.3f ms traced\n", _vars.n_records, _vars.n_slots, _vars.total_us / 1000.0);
+    if (_vars.total_us == 0) {
+        return;
+    }
+    printf("\n%-16s %12s %8s\n", "state", "us", "%");
+    for (size_t i = 0; i < TRACE_N_STATES; i++) {
+        if (_vars.state_us[i] == 0) {
+            continue;
+        }
+        printf("%-16s %12llu %7.2f%%\n", _state_name(i), (unsigned long long)_vars.state_us[i], 100.0 * _vars.state_us[i] / _vars.total_us);
+    }
+    printf("\n%-18s %8s\n", "activity", "count");
+    for (size_t i = 1; i < BL_TRACE_ACTIVITY_MAX; i++) {
+        if (_vars.activity_count[i] == 0) {
+            continue;
+        }
+        printf("%-18s %8u\n", _activity_name(i), _vars.activity_count[i]);
+    }
+}
+
+static const char *_state_name(uint8_t state) {
+    // must match bl_mac_state_t in blink/mac.c
+    switch (state) {
+        case 0: return "SLEEP";
+        case 21: return "TX_OFFSET";
+        case 22: return "TX_DATA";
+        case 31: return "RX_OFFSET";
+        case 32: return "RX_DATA_LISTEN";
+        case 33: return "RX_DATA";
+        default: return "?";
+    }
+}
+
+static const char *_activity_name(uint8_t activity) {
+    if (activity >= BL_TRACE_ACTIVITY_MAX || _activity_names[activity] == NULL) {
+        return "?";
+    }
+    return _activity_names[activity];
+}
+
+static void _usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [options] [file]\n"
+            "  -s, --summary   only print the time spent per state and the activity counts\n",
+            argv0);
+}